@@ -0,0 +1,64 @@
+#include <mn/IO.h>
+#include <mn/Fabric.h>
+#include <mn/Co_Task.h>
+#include <mn/Socket.h>
+#include <mn/Defer.h>
+#include <mn/Assert.h>
+
+mn::Co_Task<void>
+serve_client(mn::Socket client)
+{
+	auto data = mn::str_new();
+	mn_defer({
+		mn::str_free(data);
+		mn::socket_close(client);
+	});
+
+	while (true)
+	{
+		// the coroutine is suspended until the client sends something, no worker is blocked on it
+		co_await mn::co_socket_readable(client);
+
+		mn::str_resize(data, 1024);
+		auto [read_bytes, err] = mn::socket_read(client, mn::block_from(data), mn::NO_TIMEOUT);
+		if (err || read_bytes == 0)
+		{
+			mn::print("client disconnected\n");
+			break;
+		}
+
+		mn::str_resize(data, read_bytes);
+		co_await mn::co_socket_writable(client);
+		auto write_bytes = mn::socket_write(client, mn::block_from(data));
+		mn_assert_msg(write_bytes == read_bytes, "socket_write failed");
+	}
+}
+
+mn::Co_Task<void>
+serve(mn::Fabric f, mn::Socket socket)
+{
+	while (socket_listen(socket))
+	{
+		co_await mn::co_socket_readable(socket);
+		if (auto client_socket = mn::socket_accept(socket, mn::NO_TIMEOUT))
+			mn::co_go(f, serve_client(client_socket));
+	}
+}
+
+int
+main()
+{
+	auto f = mn::fabric_new({});
+	mn_defer(mn::fabric_free(f));
+
+	auto socket = mn::socket_open(mn::SOCKET_FAMILY_IPV4, mn::SOCKET_TYPE_TCP);
+	mn_assert_msg(socket, "socket_open failed");
+	mn_defer(mn::socket_close(socket));
+
+	bool status = mn::socket_bind(socket, "4000");
+	mn_assert_msg(status, "socket_bind failed");
+	mn_defer(mn::socket_disconnect(socket));
+
+	mn::co_wait(f, serve(f, socket));
+	return 0;
+}
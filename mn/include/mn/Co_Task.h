@@ -0,0 +1,621 @@
+#pragma once
+
+#include "mn/Fabric.h"
+#include "mn/Thread.h"
+#include "mn/Socket.h"
+#include "mn/IPC.h"
+
+// coroutines need C++20, this header is empty when it's included from older standards
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+
+#include <coroutine>
+#include <type_traits>
+#include <utility>
+
+#define MN_COROUTINES_SUPPORTED 1
+
+namespace mn
+{
+	template<typename T>
+	struct Co_Task;
+
+	// the common part of all the coroutine promises, it holds the fabric the coroutine runs on and the
+	// coroutine waiting for it to finish
+	struct Co_Promise_Base
+	{
+		Fabric fabric = nullptr;
+		std::coroutine_handle<> continuation;
+		// detached coroutines have no owner so they destroy themselves once they finish
+		bool detached = false;
+
+		// resumes the waiting coroutine directly (symmetric transfer) without going through the fabric
+		struct Final_Awaiter
+		{
+			bool
+			await_ready() noexcept
+			{
+				return false;
+			}
+
+			template<typename TPromise>
+			std::coroutine_handle<>
+			await_suspend(std::coroutine_handle<TPromise> handle) noexcept
+			{
+				auto& promise = handle.promise();
+				auto continuation = promise.continuation;
+				if (promise.detached)
+					handle.destroy();
+
+				if (continuation)
+					return continuation;
+				return std::noop_coroutine();
+			}
+
+			void
+			await_resume() noexcept
+			{}
+		};
+
+		// coroutines are lazy, they start when they're awaited or scheduled using co_go
+		std::suspend_always
+		initial_suspend() noexcept
+		{
+			return {};
+		}
+
+		Final_Awaiter
+		final_suspend() noexcept
+		{
+			return {};
+		}
+
+		void
+		unhandled_exception()
+		{
+			panic("unhandled exception in coroutine");
+		}
+	};
+
+	template<typename T>
+	struct Co_Promise: Co_Promise_Base
+	{
+		T value;
+
+		Co_Task<T>
+		get_return_object();
+
+		template<typename R>
+		void
+		return_value(R&& v)
+		{
+			value = std::forward<R>(v);
+		}
+	};
+
+	template<>
+	struct Co_Promise<void>: Co_Promise_Base
+	{
+		Co_Task<void>
+		get_return_object();
+
+		void
+		return_void()
+		{}
+	};
+
+	// returns the fabric which the given coroutine should be resumed on, it's the fabric of the coroutine
+	// if it's one of ours, the local fabric otherwise
+	template<typename TPromise>
+	inline static Fabric
+	_co_fabric(std::coroutine_handle<TPromise> handle)
+	{
+		Fabric res = nullptr;
+		if constexpr (std::is_base_of_v<Co_Promise_Base, TPromise>)
+			res = handle.promise().fabric;
+		if (res == nullptr)
+			res = fabric_local();
+		if (res == nullptr)
+			panic("can't find any fabric to resume the coroutine on");
+		return res;
+	}
+
+	// a coroutine which runs on a fabric, co_await it from another coroutine to run it and get its result,
+	// or schedule it using co_go
+	template<typename T>
+	struct Co_Task
+	{
+		using promise_type = Co_Promise<T>;
+
+		std::coroutine_handle<promise_type> handle;
+
+		struct Awaiter
+		{
+			std::coroutine_handle<promise_type> handle;
+
+			bool
+			await_ready() noexcept
+			{
+				return handle.done();
+			}
+
+			template<typename TPromise>
+			std::coroutine_handle<>
+			await_suspend(std::coroutine_handle<TPromise> parent) noexcept
+			{
+				// the child runs on the same fabric as its parent
+				auto& promise = handle.promise();
+				promise.fabric = _co_fabric(parent);
+				promise.continuation = parent;
+				return handle;
+			}
+
+			T
+			await_resume()
+			{
+				if constexpr (std::is_void_v<T> == false)
+					return std::move(handle.promise().value);
+			}
+		};
+
+		Co_Task()
+			:handle(nullptr)
+		{}
+
+		explicit Co_Task(std::coroutine_handle<promise_type> h)
+			:handle(h)
+		{}
+
+		Co_Task(const Co_Task&) = delete;
+
+		Co_Task(Co_Task&& other)
+			:handle(other.handle)
+		{
+			other.handle = nullptr;
+		}
+
+		Co_Task&
+		operator=(const Co_Task&) = delete;
+
+		Co_Task&
+		operator=(Co_Task&& other)
+		{
+			if (this != &other)
+			{
+				if (handle)
+					handle.destroy();
+				handle = other.handle;
+				other.handle = nullptr;
+			}
+			return *this;
+		}
+
+		~Co_Task()
+		{
+			if (handle)
+				handle.destroy();
+		}
+
+		Awaiter
+		operator co_await() noexcept
+		{
+			return Awaiter{handle};
+		}
+	};
+
+	template<typename T>
+	inline Co_Task<T>
+	Co_Promise<T>::get_return_object()
+	{
+		return Co_Task<T>{std::coroutine_handle<Co_Promise<T>>::from_promise(*this)};
+	}
+
+	inline Co_Task<void>
+	Co_Promise<void>::get_return_object()
+	{
+		return Co_Task<void>{std::coroutine_handle<Co_Promise<void>>::from_promise(*this)};
+	}
+
+	// schedules the given coroutine into the given fabric, the coroutine is detached and it will free itself
+	// once it finishes, its result (if any) is discarded, it returns false if the fabric rejected the coroutine (see
+	// FABRIC_OVERLOAD_POLICY_REJECT) in which case it's freed without running
+	template<typename T>
+	inline static bool
+	co_go(Fabric f, Co_Task<T>&& task)
+	{
+		auto handle = task.handle;
+		task.handle = nullptr;
+
+		auto& promise = handle.promise();
+		promise.fabric = f;
+		promise.detached = true;
+		if (go(f, [handle] { handle.resume(); }))
+			return true;
+
+		handle.destroy();
+		return false;
+	}
+
+	template<typename T>
+	inline static Co_Task<void>
+	_co_wait_wrapper(Co_Task<T> task, T* result, Waitgroup wg)
+	{
+		*result = co_await task;
+		waitgroup_done(wg);
+	}
+
+	inline static Co_Task<void>
+	_co_wait_wrapper(Co_Task<void> task, Waitgroup wg)
+	{
+		co_await task;
+		waitgroup_done(wg);
+	}
+
+	// runs the given coroutine on the given fabric and blocks the calling thread until it finishes and returns
+	// its result, it's the bridge between regular code and coroutines (e.g. in main)
+	// it panics if the fabric rejects the coroutine since there's no result to return, use co_go on fabrics with the
+	// FABRIC_OVERLOAD_POLICY_REJECT policy to handle the rejection
+	template<typename T>
+	inline static T
+	co_wait(Fabric f, Co_Task<T>&& task)
+	{
+		Waitgroup wg = waitgroup_new();
+		mn_defer(waitgroup_free(wg));
+		waitgroup_add(wg, 1);
+
+		if constexpr (std::is_void_v<T>)
+		{
+			if (co_go(f, _co_wait_wrapper(std::move(task), wg)) == false)
+				panic("the fabric rejected the coroutine");
+			waitgroup_wait(wg);
+		}
+		else
+		{
+			T result{};
+			if (co_go(f, _co_wait_wrapper(std::move(task), &result, wg)) == false)
+				panic("the fabric rejected the coroutine");
+			waitgroup_wait(wg);
+			return result;
+		}
+	}
+
+	// suspends the coroutine until the given ready function returns true, the fabric workers check it
+	// periodically using fabric_do_when and then resume the coroutine as a regular fabric task, it's meant for the
+	// conditions which nobody signals, the awaitables below sleep on their primitives instead
+	template<typename TReady>
+	struct Co_Poll_Awaiter
+	{
+		TReady ready;
+
+		bool
+		await_ready()
+		{
+			return ready();
+		}
+
+		template<typename TPromise>
+		void
+		await_suspend(std::coroutine_handle<TPromise> handle)
+		{
+			fabric_do_when(_co_fabric(handle), ready, [handle] { handle.resume(); });
+		}
+
+		void
+		await_resume()
+		{}
+	};
+
+	// returns an awaitable which suspends the coroutine until the given ready function returns true
+	template<typename TReady>
+	inline static Co_Poll_Awaiter<std::decay_t<TReady>>
+	co_until(TReady&& ready)
+	{
+		return Co_Poll_Awaiter<std::decay_t<TReady>>{std::forward<TReady>(ready)};
+	}
+
+	// an operation which a coroutine waits on, it's tried without blocking, and the waiters are registered on the
+	// primitive which signals them when the operation might be possible (it mirrors Chan_Select_Case)
+	struct Co_Wait_Op
+	{
+		void* object;
+		void* value;
+		bool (*try_op)(void* object, void* value);
+		void (*waiter_add)(void* object, Worker_Waiter* waiter);
+		void (*waiter_remove)(void* object, Worker_Waiter* waiter);
+	};
+
+	// the common part of the awaitables which sleep on a mn primitive, the suspended coroutine registers an armed
+	// waiter on the primitive and the signal schedules it back into its fabric instead of the workers polling it
+	// the coroutine might be resumed on another worker as soon as the waiter is armed, so nothing touches the awaiter
+	// after that until the waiter's job runs, and the awaiters are never copied since the primitives point to them
+	struct Co_Wait_Awaiter_Base
+	{
+		Co_Wait_Op op;
+		Worker_Waiter waiter;
+		Fabric fabric;
+		std::coroutine_handle<> handle;
+
+		// registers the armed waiter, it returns false if the operation is done instead and the coroutine can go on
+		bool
+		_sleep()
+		{
+			while (true)
+			{
+				// register before trying again so that we don't miss the signals in between
+				_worker_waiter_reset(&waiter);
+				op.waiter_add(op.object, &waiter);
+				if (op.try_op(op.object, op.value))
+				{
+					op.waiter_remove(op.object, &waiter);
+					return false;
+				}
+
+				Fabric_Task task{};
+				task.task = fabric_task_make([this] { _wake(); });
+				if (_worker_waiter_arm(&waiter, fabric, task))
+					return true;
+
+				// it was signaled before we armed it, so the operation might be possible now
+				op.waiter_remove(op.object, &waiter);
+			}
+		}
+
+		// runs on the fabric once the waiter is signaled, the signaler holds the primitive's lock while it touches the
+		// waiter so removing it waits for the signaler to leave
+		void
+		_wake()
+		{
+			op.waiter_remove(op.object, &waiter);
+			if (_sleep() == false)
+				handle.resume();
+		}
+
+		template<typename TPromise>
+		bool
+		_suspend(std::coroutine_handle<TPromise> h)
+		{
+			fabric = _co_fabric(h);
+			handle = h;
+			return _sleep();
+		}
+	};
+
+	// awaitable which suspends the coroutine until it recieves a value from the given channel
+	template<typename T>
+	struct Co_Chan_Recv_Awaiter: Co_Wait_Awaiter_Base
+	{
+		Chan<T> chan;
+		Recv_Result<T> result;
+		bool suspended;
+
+		bool
+		await_ready()
+		{
+			// the case points into the awaiter so it's made once the awaiter is in its final place
+			auto c = chan_select_recv(chan, &result);
+			op = Co_Wait_Op{c.chan, c.value, c.try_op, c.waiter_add, c.waiter_remove};
+			suspended = false;
+			return _chan_recv_try(chan, result);
+		}
+
+		template<typename TPromise>
+		bool
+		await_suspend(std::coroutine_handle<TPromise> h)
+		{
+			// the channel is kept alive while the coroutine is suspended on it
+			chan_ref(chan);
+			suspended = true;
+			if (_suspend(h))
+				return true;
+			suspended = false;
+			chan_unref(chan);
+			return false;
+		}
+
+		Recv_Result<T>
+		await_resume()
+		{
+			if (suspended)
+				chan_unref(chan);
+			return std::move(result);
+		}
+	};
+
+	// returns an awaitable which recieves a value from the given channel, it has the same result as chan_recv
+	template<typename T>
+	inline static Co_Chan_Recv_Awaiter<T>
+	co_chan_recv(Chan<T> self)
+	{
+		return Co_Chan_Recv_Awaiter<T>{{}, self, {}, false};
+	}
+
+	// awaitable which suspends the coroutine until it sends the value to the given channel
+	template<typename T>
+	struct Co_Chan_Send_Awaiter: Co_Wait_Awaiter_Base
+	{
+		Chan<T> chan;
+		T value;
+		bool suspended;
+
+		bool
+		await_ready()
+		{
+			auto c = chan_select_send(chan, &value);
+			op = Co_Wait_Op{c.chan, c.value, c.try_op, c.waiter_add, c.waiter_remove};
+			suspended = false;
+			return _chan_send_try(chan, value);
+		}
+
+		template<typename TPromise>
+		bool
+		await_suspend(std::coroutine_handle<TPromise> h)
+		{
+			chan_ref(chan);
+			suspended = true;
+			if (_suspend(h))
+				return true;
+			suspended = false;
+			chan_unref(chan);
+			return false;
+		}
+
+		void
+		await_resume()
+		{
+			if (suspended)
+				chan_unref(chan);
+		}
+	};
+
+	// returns an awaitable which sends the given value to the given channel, it panics if the channel is closed
+	template<typename T>
+	inline static Co_Chan_Send_Awaiter<T>
+	co_chan_send(Chan<T> self, const T& v)
+	{
+		return Co_Chan_Send_Awaiter<T>{{}, self, v, false};
+	}
+
+	inline static bool
+	_co_waitgroup_try(void* wg, void*)
+	{
+		return waitgroup_count((Waitgroup)wg) == 0;
+	}
+
+	inline static void
+	_co_waitgroup_waiter_add(void* wg, Worker_Waiter* waiter)
+	{
+		_worker_signal_waiter_add(_waitgroup_signal((Waitgroup)wg), waiter);
+	}
+
+	inline static void
+	_co_waitgroup_waiter_remove(void* wg, Worker_Waiter* waiter)
+	{
+		_worker_signal_waiter_remove(_waitgroup_signal((Waitgroup)wg), waiter);
+	}
+
+	// awaitable which suspends the coroutine until the given waitgroup reaches zero, it sleeps on the waitgroup's
+	// signal which is notified by the last waitgroup_done
+	struct Co_Waitgroup_Awaiter: Co_Wait_Awaiter_Base
+	{
+		Waitgroup wg;
+
+		bool
+		await_ready()
+		{
+			op = Co_Wait_Op{wg, nullptr, _co_waitgroup_try, _co_waitgroup_waiter_add, _co_waitgroup_waiter_remove};
+			return _co_waitgroup_try(wg, nullptr);
+		}
+
+		template<typename TPromise>
+		bool
+		await_suspend(std::coroutine_handle<TPromise> h)
+		{
+			return _suspend(h);
+		}
+
+		void
+		await_resume()
+		{}
+	};
+
+	// returns an awaitable which suspends the coroutine until the given waitgroup reaches zero
+	inline static Co_Waitgroup_Awaiter
+	co_waitgroup_wait(Waitgroup self)
+	{
+		return Co_Waitgroup_Awaiter{{}, self};
+	}
+
+	// awaitable which suspends the coroutine for the given number of milliseconds, the coroutine is scheduled back
+	// by the fabric's timer wheel
+	struct Co_Sleep_Awaiter
+	{
+		uint64_t milliseconds;
+
+		bool
+		await_ready()
+		{
+			return milliseconds == 0;
+		}
+
+		template<typename TPromise>
+		void
+		await_suspend(std::coroutine_handle<TPromise> h)
+		{
+			fabric_do_after(_co_fabric(h), milliseconds, [h] { h.resume(); });
+		}
+
+		void
+		await_resume()
+		{}
+	};
+
+	// returns an awaitable which suspends the coroutine for the given number of milliseconds
+	inline static Co_Sleep_Awaiter
+	co_sleep(uint64_t milliseconds)
+	{
+		return Co_Sleep_Awaiter{milliseconds};
+	}
+
+	// awaitable which suspends the coroutine until the given os handle is ready for the given io, the fabric's io thread
+	// waits on the handle and schedules the coroutine back (see fabric_task_do_when_io)
+	template<typename TReady>
+	struct Co_IO_Awaiter
+	{
+		int64_t handle;
+		FABRIC_IO io;
+		// checks the handle without blocking so that the coroutine isn't suspended if it's ready already
+		TReady ready;
+
+		bool
+		await_ready()
+		{
+			return ready();
+		}
+
+		template<typename TPromise>
+		void
+		await_suspend(std::coroutine_handle<TPromise> h)
+		{
+			fabric_do_when_io(_co_fabric(h), handle, io, [h] { h.resume(); });
+		}
+
+		void
+		await_resume()
+		{}
+	};
+
+	template<typename TReady>
+	inline static Co_IO_Awaiter<std::decay_t<TReady>>
+	_co_io(int64_t handle, FABRIC_IO io, TReady&& ready)
+	{
+		return Co_IO_Awaiter<std::decay_t<TReady>>{handle, io, std::forward<TReady>(ready)};
+	}
+
+	// returns an awaitable which suspends the coroutine until the given socket can be read from without blocking
+	inline static auto
+	co_socket_readable(Socket self)
+	{
+		return _co_io(self->handle, FABRIC_IO_READ, [self] { return socket_can_read(self); });
+	}
+
+	// returns an awaitable which suspends the coroutine until the given socket can be written to without blocking
+	inline static auto
+	co_socket_writable(Socket self)
+	{
+		return _co_io(self->handle, FABRIC_IO_WRITE, [self] { return socket_can_write(self); });
+	}
+
+	// returns an awaitable which suspends the coroutine until the given sputnik instance can be read from
+	// without blocking
+	inline static auto
+	co_sputnik_readable(ipc::Sputnik self)
+	{
+	#if OS_WINDOWS
+		auto handle = int64_t(intptr_t(self->winos_named_pipe));
+	#else
+		auto handle = int64_t(self->linux_domain_socket);
+	#endif
+		return _co_io(handle, FABRIC_IO_READ, [self] { return ipc::sputnik_can_read(self); });
+	}
+}
+
+#endif
@@ -3,7 +3,9 @@
 #include "mn/Exports.h"
 #include "mn/Base.h"
 #include "mn/Task.h"
+#include "mn/Buf.h"
 #include "mn/Ring.h"
+#include "mn/MPMC_Ring.h"
 #include "mn/Thread.h"
 #include "mn/Defer.h"
 #include "mn/OS.h"
@@ -12,6 +14,7 @@
 
 #include <atomic>
 #include <chrono>
+#include <type_traits>
 
 namespace mn
 {
@@ -24,11 +27,25 @@ namespace mn
 		FABRIC_TASK_FLAG_COMPUTE = 1,
 	};
 
+	// represents the priority of the task submitted to fabric, higher priority tasks are scheduled first
+	// but lower priority tasks still get a share of the workers so that they don't starve
+	enum FABRIC_TASK_PRIORITY
+	{
+		// default priority
+		FABRIC_TASK_PRIORITY_NORMAL,
+		// latency critical tasks (e.g. request handling)
+		FABRIC_TASK_PRIORITY_HIGH,
+		// throughput tasks which can be delayed (e.g. compaction, cleanup)
+		FABRIC_TASK_PRIORITY_BACKGROUND,
+		FABRIC_TASK_PRIORITY_COUNT,
+	};
+
 	// represents a single task in the fabric's worker task queue
 	struct Fabric_Task
 	{
 		Task<void()> task;
 		FABRIC_TASK_FLAGS flags;
+		FABRIC_TASK_PRIORITY priority;
 	};
 
 	// frees the given fabric task
@@ -45,6 +62,22 @@ namespace mn
 		fabric_task_free(self);
 	}
 
+	// returns the allocator of the task closures which don't fit in the task's inline storage (see MN_TASK_INLINE_SIZE),
+	// it keeps a pool of size classed blocks per thread so that submitting a big closure doesn't go through malloc,
+	// and the blocks which are freed by other threads (the workers which ran the tasks) are returned to the thread
+	// which allocated them through a lock-free list
+	MN_EXPORT Allocator
+	fabric_task_allocator();
+
+	// creates a task from the given callable like Task::make but the out of line closures are allocated from
+	// fabric_task_allocator
+	template<typename TFunc>
+	inline static Task<void()>
+	fabric_task_make(TFunc&& fn)
+	{
+		return Task<void()>::make_with_allocator(fabric_task_allocator(), std::forward<TFunc>(fn));
+	}
+
 	// Worker
 	// represents a fabric worker which is a thread with a job queue attached to it
 	typedef struct IWorker* Worker;
@@ -78,7 +111,7 @@ namespace mn
 	worker_do(Worker self, TFunc&& f)
 	{
 		Fabric_Task entry{};
-		entry.task = Task<void()>::make(std::forward<TFunc>(f));
+		entry.task = fabric_task_make(std::forward<TFunc>(f));
 		worker_task_do(self, entry);
 	}
 
@@ -98,12 +131,75 @@ namespace mn
 	MN_EXPORT void
 	worker_block_clear();
 
+	// returns whether the calling code is running on a fabric fiber, which means that it can be suspended
+	MN_EXPORT bool
+	worker_on_fiber();
+
+	// a one shot wake up which a blocked task sleeps on until another task signals it, it's what the mn primitives
+	// (channels, waitgroups, signals, futures) use to wake up their waiters without polling them, threads sleep on
+	// its futex word and fabric fibers are suspended until the signal puts them back on their worker's ready list
+	struct Worker_Waiter
+	{
+		// set to 1 once the waiter is signaled, the threads sleep on it
+		std::atomic<int32_t> atomic_signaled;
+		// the fiber (or thread) which is sleeping on the waiter, it's taken by either the signal or the timeout
+		std::atomic<void*> atomic_sleeper;
+		// set by _worker_waiter_arm, the job is scheduled into the fabric when the waiter is signaled instead of waking
+		// a sleeper up, it's how the coroutines wait on the mn primitives
+		struct IFabric* fabric;
+		Fabric_Task* job;
+	};
+
+	// resets the given waiter so that it can be waited on again, it should only be called while nobody can signal it
+	inline static void
+	_worker_waiter_reset(Worker_Waiter* self)
+	{
+		self->atomic_signaled.store(0);
+		self->atomic_sleeper.store(nullptr);
+		self->fabric = nullptr;
+		self->job = nullptr;
+	}
+
+	// signals the given waiter and wakes up its sleeper, signaling it more than once does nothing
+	// the waiter might go out of scope as soon as its sleeper wakes up, so signalers should hold a lock which the
+	// sleeper takes before it leaves (like the channels' mutex) unless the sleeper is a fiber without a deadline
+	MN_EXPORT void
+	_worker_waiter_signal(Worker_Waiter* self);
+
+	// sleeps on the given waiter until it's signaled or until the given deadline (time_in_millis) passes, it returns
+	// whether the waiter was signaled, the calling fiber is suspended instead of blocking the worker thread
+	MN_EXPORT bool
+	_worker_waiter_wait(Worker_Waiter* self, uint64_t deadline = UINT64_MAX);
+
+	// suspends the calling fiber until ready(arg) returns true, it's called by worker_suspend_until with a type-erased
+	// ready function, the worker polls it between the other jobs it runs, it returns false without calling ready if
+	// the caller isn't running on a fabric fiber, and true once ready returned true
+	MN_EXPORT bool
+	_worker_suspend_until(bool (*ready)(void*), void* arg);
+
+	// suspends the calling fabric fiber until the given function returns true, the worker runs other tasks in the
+	// meantime and polls the function between them, the function is called from the same worker thread
+	// it returns false right away without calling the function if the caller isn't running on a fiber
+	// it's meant for conditions which nobody can signal (e.g. the state of another process), for in process conditions
+	// use worker_block_on_signal which resumes the fiber only when the signal is notified
+	template<typename TFunc>
+	inline static bool
+	worker_suspend_until(TFunc&& fn)
+	{
+		using Func = std::remove_reference_t<TFunc>;
+		return _worker_suspend_until([](void* arg) -> bool { return (*(Func*)arg)(); }, (void*)&fn);
+	}
+
 	// blocks the current thread execution until the given function returns true
-	// it will check the function periodically (every 1 ms)
+	// it will check the function periodically (every 1 ms), if the code which makes the function true is in the same
+	// process use worker_block_on_signal instead which doesn't poll
 	template<typename TFunc>
 	inline static void
 	worker_block_on(TFunc&& fn)
 	{
+		if (worker_suspend_until(fn))
+			return;
+
 		worker_block_ahead();
 		while(fn() == false)
 			thread_sleep(1);
@@ -116,8 +212,21 @@ namespace mn
 	inline static void
 	worker_block_on_with_timeout(Timeout timeout, TFunc&& fn)
 	{
-		worker_block_ahead();
 		auto start = std::chrono::steady_clock::now();
+		if (timeout != NO_TIMEOUT && worker_on_fiber())
+		{
+			worker_suspend_until([&] {
+				if (fn())
+					return true;
+				if (timeout == INFINITE_TIMEOUT)
+					return false;
+				auto t = std::chrono::steady_clock::now();
+				return (uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(t - start).count() >= timeout.milliseconds;
+			});
+			return;
+		}
+
+		worker_block_ahead();
 		while(fn() == false)
 		{
 			if (timeout == NO_TIMEOUT)
@@ -136,30 +245,189 @@ namespace mn
 	}
 
 
+	// a wakeable event which tasks block on until a condition becomes true, the code which changes the condition
+	// notifies the signal so that the waiters check it again right away instead of polling it every 1 ms like
+	// worker_block_on, the threads sleep on a futex and the fibers are suspended and their workers are woken up
+	typedef struct IWorker_Signal* Worker_Signal;
+
+	// creates a new worker signal
+	MN_EXPORT Worker_Signal
+	worker_signal_new();
+
+	// frees the given worker signal
+	MN_EXPORT void
+	worker_signal_free(Worker_Signal self);
+
+	// destruct overload for worker signal free
+	inline static void
+	destruct(Worker_Signal self)
+	{
+		worker_signal_free(self);
+	}
+
+	// wakes up all the waiters of the given signal so that they check their conditions again, it should be called
+	// after the condition is changed, it doesn't make any syscalls if there are no waiters
+	MN_EXPORT void
+	worker_signal_notify(Worker_Signal self);
+
+	// registers the given waiter on the signal, it's signaled on every notify until it's removed
+	MN_EXPORT void
+	_worker_signal_waiter_add(Worker_Signal self, Worker_Waiter* waiter);
+
+	// unregisters the given waiter from the signal, the waiter can go out of scope once this returns
+	MN_EXPORT void
+	_worker_signal_waiter_remove(Worker_Signal self, Worker_Waiter* waiter);
+
+	// returns the signal which the given waitgroup notifies once its count reaches zero
+	MN_EXPORT Worker_Signal
+	_waitgroup_signal(Waitgroup self);
+
+	// blocks until ready(arg) returns true, it's checked again every time the signal is notified, it's called by
+	// worker_block_on_signal and worker_block_on_signal_with_timeout with a type-erased ready function
+	// it returns true once ready returned true, and false if the timeout passed first, NO_TIMEOUT checks ready once
+	// without blocking, and fibers are suspended on the signal instead of blocking their worker thread
+	MN_EXPORT bool
+	_worker_block_on_signal(Worker_Signal self, Timeout timeout, bool (*ready)(void*), void* arg);
+
+	// blocks the current thread execution (or suspends the current fiber) until the given function returns true, the
+	// function is checked again every time the signal is notified, the blocking is announced to sysmon like
+	// worker_block_ahead, worker_block_clear
+	template<typename TFunc>
+	inline static void
+	worker_block_on_signal(Worker_Signal signal, TFunc&& fn)
+	{
+		using Func = std::remove_reference_t<TFunc>;
+		_worker_block_on_signal(signal, INFINITE_TIMEOUT, [](void* arg) -> bool { return (*(Func*)arg)(); }, (void*)&fn);
+	}
+
+	// blocks the current thread execution (or suspends the current fiber) until the given function returns true, or
+	// until it times out, it returns whether the function returned true
+	template<typename TFunc>
+	inline static bool
+	worker_block_on_signal_with_timeout(Worker_Signal signal, Timeout timeout, TFunc&& fn)
+	{
+		using Func = std::remove_reference_t<TFunc>;
+		return _worker_block_on_signal(signal, timeout, [](void* arg) -> bool { return (*(Func*)arg)(); }, (void*)&fn);
+	}
+
 	// fabric is a job queue system with multiple workers which it uses to execute jobs effieciently
 	typedef struct IFabric* Fabric;
 
+	// what an idle worker does when it runs out of jobs
+	enum FABRIC_IDLE_STRATEGY
+	{
+		// spins for a while checking for jobs, then yields its time slice for a while, then parks on a futex
+		FABRIC_IDLE_STRATEGY_SPIN_THEN_PARK,
+		// parks on a futex right away, which uses the least cpu time at the cost of a slower wake up
+		FABRIC_IDLE_STRATEGY_PARK,
+	};
+
+	// what fabric_task_do does with a task when the fabric is overloaded, see Fabric_Settings::max_pending_tasks and
+	// Fabric_Settings::max_worker_queue_size
+	enum FABRIC_OVERLOAD_POLICY
+	{
+		// blocks the submitting thread until there's room for the task, tasks which are submitted from the fabric's own
+		// workers run inline instead because the workers can't wait for themselves
+		FABRIC_OVERLOAD_POLICY_BLOCK,
+		// runs the task inline on the submitting thread, the tasks which are submitted from inline tasks a few levels deep
+		// are queued instead so that the tasks which keep submitting can't overflow the stack
+		FABRIC_OVERLOAD_POLICY_RUN_INLINE,
+		// frees the task without running it and fabric_task_do returns false
+		FABRIC_OVERLOAD_POLICY_REJECT,
+	};
+
 	// fabric construction settings, which is used to customize fabric behavior on creation
 	struct Fabric_Settings
 	{
 		// fabric instance name
 		const char* name;
+		// the workers count the fabric starts with
 		// default: CPU cores count
 		size_t workers_count;
+		// the workers count the fabric can shrink down to when some of its workers stay idle for worker_idle_timeout_in_ms
+		// default: workers_count
+		size_t min_workers_count;
+		// the workers count the fabric can grow up to when the tasks wait in the queues while all the workers are busy
+		// default: workers_count
+		size_t max_workers_count;
+		// how long sysmon waits while some of the workers are idle before it parks one of them, the parked workers free
+		// their tmp memory and fibers, and they're resumed first when the fabric grows again
+		// default: 10000
+		uint32_t worker_idle_timeout_in_ms;
 		// default: 1/2 CPU cores count
 		size_t put_aside_worker_count;
-		// how many milliseconds sysmon will wait for before declaring this worker blocked
+		// how many milliseconds the tasks queued behind a busy worker can wait before sysmon declares it blocked
 		// in case this worker announced that it will block via worker_block_ahead, worker_block_clear
 		// default: 10
 		uint32_t coop_blocking_threshold_in_ms;
-		// how many milliseconds sysmon will wait for before declaring this worker blocked
-		// in case this worker didn't announce that it will block via worker_block_ahead, worker_block_clear API
+		// how many milliseconds the tasks queued behind a busy worker can wait before sysmon declares it blocked
+		// in case this worker didn't announce that it will block via worker_block_ahead, worker_block_clear API,
+		// a long running task with nothing waiting behind it is left alone
 		// default: 1000
 		uint32_t external_blocking_threshold_in_ms;
 		// threshold of the blocking workers ratio [0, 1] which sysmon
 		// will use to start evicting these workers if the blocking_workers_count >= workers_count * blocking_workers_threshold
 		// default: 0.5f
 		float blocking_workers_threshold;
+		// maximum number of threads the fabric runs tasks on, it includes the workers, the blocking workers which sysmon
+		// puts aside, and the blocking pool threads, sysmon stops evicting blocking workers once it's reached
+		// default: 4 * max_workers_count
+		size_t max_threads_count;
+		// maximum number of threads in the blocking pool which runs the tasks submitted via fabric_do_blocking, they're
+		// started on demand and count towards max_threads_count, except for the first one which is always allowed
+		// default: workers_count
+		size_t blocking_threads_count;
+		// capacity of the fabric-wide lock-free queues (one per task priority) which tasks submitted from outside the fabric go through,
+		// when it's full the tasks are pushed directly to the workers' queues
+		// default: 4096
+		size_t injection_queue_capacity;
+		// runs the tasks on stackful fibers, so that the blocking mn primitives (chan_send, chan_recv, waitgroup_wait,
+		// socket_read, worker_block_on) suspend the fiber and let the worker run other tasks instead of blocking its thread
+		// it's only supported on linux x86_64 and aarch64, it's ignored elsewhere
+		// default: false
+		bool enable_fibers;
+		// the stack size of each fiber
+		// default: 256KB
+		size_t fiber_stack_size;
+		// what the workers do when they run out of jobs
+		// default: FABRIC_IDLE_STRATEGY_SPIN_THEN_PARK
+		FABRIC_IDLE_STRATEGY idle_strategy;
+		// how many times an idle worker spins (with a cpu pause) checking for jobs before it starts yielding
+		// default: 256
+		uint32_t idle_spin_count;
+		// how many times an idle worker yields its time slice checking for jobs before it parks
+		// default: 16
+		uint32_t idle_yield_count;
+		// pins each worker to a cpu, the workers are spread over the physical cores first then over their SMT siblings
+		// and workers beyond the cpus count wrap around, see Topology.h
+		// default: false
+		bool pin_workers;
+		// makes the idle workers try to steal from the workers which share their last level cache, then from the ones
+		// on their NUMA node, before the rest of the workers, it only takes effect when the workers are pinned
+		// default: false
+		bool topology_aware_stealing;
+		// makes each worker allocate its queues after it pins itself so that the memory is placed on its NUMA node
+		// (first touch), the tmp arenas and fibers are already allocated by the worker's own thread, it only takes
+		// effect when the workers are pinned
+		// default: false
+		bool numa_local_memory;
+		// makes the workers measure how long each task waited in the queues and how long it ran, see fabric_stats,
+		// it costs a couple of clock reads per task so it's off by default, the rest of the stats are always collected
+		// default: false
+		bool enable_timing_stats;
+		// maximum number of the tasks which are queued or running in the fabric, the submissions beyond it are handled
+		// by the overload policy, it's checked without locking so concurrent submitters can exceed it by a few tasks,
+		// the fabric's internal tasks (timers, strands, graphs, compute) are not limited
+		// default: 0 (unlimited)
+		size_t max_pending_tasks;
+		// maximum number of the tasks which are queued on a single worker, a full worker's tasks go through the
+		// injection queue, and if it's full too they go to a worker which isn't full, if there's none the
+		// submission is handled by the overload policy
+		// default: 0 (unlimited)
+		size_t max_worker_queue_size;
+		// what to do with the submitted tasks when the fabric is overloaded
+		// default: FABRIC_OVERLOAD_POLICY_BLOCK
+		FABRIC_OVERLOAD_POLICY overload_policy;
 		// function which will be executed after each worker finishes executing a job
 		Task<void()> after_each_job;
 		// function which will be executed when a new worker is started
@@ -181,28 +449,353 @@ namespace mn
 		fabric_free(self);
 	}
 
-	// adds a task to the fabric
-	MN_EXPORT void
+	// adds a task to the fabric, if the fabric is overloaded the task is handled by the fabric's overload policy, it
+	// returns false if the task was rejected, in which case the task is freed
+	MN_EXPORT bool
 	fabric_task_do(Fabric self, const Fabric_Task& task);
 
-	// adds a batch of tasks to fabric
-	MN_EXPORT void
+	// adds a batch of tasks to fabric, each task is handled by the overload policy if the fabric is overloaded,
+	// it returns the number of the tasks which were not rejected
+	MN_EXPORT size_t
 	fabric_task_batch_do(Fabric self, const Fabric_Task* ptr, size_t count);
 
-	// schedules any callable into the fabric queue
+	// tries to add a task to the fabric without blocking, it returns false if the fabric is overloaded regardless of
+	// its overload policy, in which case the task isn't freed and the caller still owns it
+	MN_EXPORT bool
+	fabric_task_try_do(Fabric self, const Fabric_Task& task);
+
+	// schedules any callable into the fabric queue, it returns false if it was rejected
 	template<typename TFunc>
-	inline static void
+	inline static bool
 	fabric_do(Fabric self, TFunc&& f)
 	{
 		Fabric_Task entry{};
-		entry.task = Task<void()>::make(std::forward<TFunc>(f));
-		fabric_task_do(self, entry);
+		entry.task = fabric_task_make(std::forward<TFunc>(f));
+		return fabric_task_do(self, entry);
+	}
+
+	// tries to schedule any callable into the fabric queue without blocking, it returns false if the fabric is
+	// overloaded, in which case the callable is dropped
+	template<typename TFunc>
+	inline static bool
+	fabric_try_do(Fabric self, TFunc&& f)
+	{
+		Fabric_Task entry{};
+		entry.task = fabric_task_make(std::forward<TFunc>(f));
+		if (fabric_task_try_do(self, entry))
+			return true;
+		fabric_task_free(entry);
+		return false;
+	}
+
+	// adds a task which is expected to block its thread (file io, blocking syscalls) to the fabric's blocking pool,
+	// it runs on one of the pool's threads in submission order instead of occupying a worker, the task priority is ignored
+	MN_EXPORT void
+	fabric_task_do_blocking(Fabric self, const Fabric_Task& task);
+
+	// schedules any callable into the fabric's blocking pool
+	template<typename TFunc>
+	inline static void
+	fabric_do_blocking(Fabric self, TFunc&& f)
+	{
+		Fabric_Task entry{};
+		entry.task = fabric_task_make(std::forward<TFunc>(f));
+		fabric_task_do_blocking(self, entry);
+	}
+
+	// adds a task to the fabric which is scheduled once the ready function returns true, the fabric's workers check
+	// the ready function periodically (between jobs and every 1 ms while idle) instead of blocking a thread on it
+	MN_EXPORT void
+	fabric_task_do_when(Fabric self, Task<bool()> ready, const Fabric_Task& task);
+
+	// schedules any callable into the fabric once the given ready function returns true
+	template<typename TReady, typename TFunc>
+	inline static void
+	fabric_do_when(Fabric self, TReady&& ready, TFunc&& f)
+	{
+		Fabric_Task entry{};
+		entry.task = fabric_task_make(std::forward<TFunc>(f));
+		// the ready function outlives this call so we always keep a copy of it
+		using Ready = std::decay_t<TReady>;
+		fabric_task_do_when(self, Task<bool()>::make(Ready(std::forward<TReady>(ready))), entry);
+	}
+
+	// the readiness which fabric_task_do_when_io waits for
+	enum FABRIC_IO
+	{
+		FABRIC_IO_READ,
+		FABRIC_IO_WRITE,
+		FABRIC_IO_COUNT,
+	};
+
+	// adds a task to the fabric which is scheduled once the given os handle can be read from (or written to) without
+	// blocking, the handle is a file descriptor on linux and mac, and a socket or an overlapped named pipe on windows
+	// the fabric waits on all the handles in a dedicated io thread using epoll on linux, kqueue on mac, and WSAPoll and
+	// zero byte overlapped reads on windows, the handles which can't be waited on (e.g. regular files) are always ready
+	// a handle should stay open until its task is scheduled, and it can only have one pending task for each io
+	MN_EXPORT void
+	fabric_task_do_when_io(Fabric self, int64_t handle, FABRIC_IO io, const Fabric_Task& task);
+
+	// schedules any callable into the fabric once the given os handle is ready for the given io
+	template<typename TFunc>
+	inline static void
+	fabric_do_when_io(Fabric self, int64_t handle, FABRIC_IO io, TFunc&& f)
+	{
+		Fabric_Task entry{};
+		entry.task = fabric_task_make(std::forward<TFunc>(f));
+		fabric_task_do_when_io(self, handle, io, entry);
+	}
+
+	// the os readiness poller behind fabric_task_do_when_io, each platform implements it next to its threads and
+	// sockets, the fabric's io thread waits on it and submits the jobs which it returns
+	typedef struct IFabric_Poller* Fabric_Poller;
+
+	MN_EXPORT Fabric_Poller
+	_fabric_poller_new();
+
+	// frees the given poller and appends the jobs which never got ready to the given buffer
+	MN_EXPORT void
+	_fabric_poller_free(Fabric_Poller self, Buf<Fabric_Task*>& pending);
+
+	// registers a one shot wait for the given io on the handle, the job is returned by _fabric_poller_wait once the
+	// handle is ready
+	MN_EXPORT void
+	_fabric_poller_add(Fabric_Poller self, int64_t handle, FABRIC_IO io, Fabric_Task* job);
+
+	// blocks until some of the registered handles are ready (or until the poller is woken up) and appends their jobs
+	// to the given buffer
+	MN_EXPORT void
+	_fabric_poller_wait(Fabric_Poller self, Buf<Fabric_Task*>& ready);
+
+	// wakes up the thread which is blocked in _fabric_poller_wait
+	MN_EXPORT void
+	_fabric_poller_wake(Fabric_Poller self);
+
+	// makes the given waiter schedule the task into the fabric once it's signaled instead of waking a sleeper up, it
+	// returns false and frees the task if the waiter is already signaled, the waiter should be reset before it's armed
+	MN_EXPORT bool
+	_worker_waiter_arm(Worker_Waiter* self, Fabric fabric, const Fabric_Task& task);
+
+	// a handle to a delayed or periodic task in the fabric, it's used to cancel the task
+	struct Fabric_Timer
+	{
+		uint64_t handle;
+	};
+
+	// adds a task to the fabric which is scheduled after the given delay, the fabric keeps its timers in a
+	// hierarchical timer wheel with a 1 ms resolution which is driven by a dedicated timer thread
+	MN_EXPORT Fabric_Timer
+	fabric_task_do_after(Fabric self, uint64_t delay_in_ms, const Fabric_Task& task);
+
+	// adds a task to the fabric which is scheduled every period until it's canceled, the next run is scheduled
+	// after the current one finishes so runs of the same task never overlap, and the runs which are missed
+	// because the task took longer than its period are skipped
+	MN_EXPORT Fabric_Timer
+	fabric_task_do_every(Fabric self, uint64_t period_in_ms, const Fabric_Task& task);
+
+	// cancels the given timer, it returns false if the timer already fired (for delayed tasks) or was already canceled
+	// a periodic task which is running while it's canceled finishes its current run and isn't scheduled again
+	MN_EXPORT bool
+	fabric_timer_cancel(Fabric self, Fabric_Timer timer);
+
+	// schedules any callable into the fabric after the given delay
+	template<typename TFunc>
+	inline static Fabric_Timer
+	fabric_do_after(Fabric self, uint64_t delay_in_ms, TFunc&& f)
+	{
+		Fabric_Task entry{};
+		entry.task = fabric_task_make(std::forward<TFunc>(f));
+		return fabric_task_do_after(self, delay_in_ms, entry);
+	}
+
+	// schedules any callable into the fabric every period until it's canceled
+	template<typename TFunc>
+	inline static Fabric_Timer
+	fabric_do_every(Fabric self, uint64_t period_in_ms, TFunc&& f)
+	{
+		Fabric_Task entry{};
+		entry.task = fabric_task_make(std::forward<TFunc>(f));
+		return fabric_task_do_every(self, period_in_ms, entry);
 	}
 
 	// returns the local fabric of the calling thread if it has one, if it doesn't it will return nullptr
 	MN_EXPORT Fabric
 	fabric_local();
 
+	// returns the number of active workers in the given fabric, it changes over time if the fabric is elastic, see
+	// Fabric_Settings::min_workers_count and Fabric_Settings::max_workers_count
+	MN_EXPORT size_t
+	fabric_workers_count(Fabric self);
+
+	// the stats histograms have a bucket for each power of 2 microseconds, bucket 0 counts the samples under 1 microsecond,
+	// bucket i counts the samples in [2^(i-1), 2^i) microseconds and the last bucket counts everything above that
+	constexpr static size_t FABRIC_STATS_HISTOGRAM_BUCKETS_COUNT = 32;
+
+	// counters of a fabric worker, they only go up except for the queue counts which are sampled with the snapshot
+	struct Fabric_Worker_Stats
+	{
+		uint64_t tasks_executed;
+		// how many times the worker stole tasks from other workers
+		uint64_t steals;
+		// how many times the worker went to sleep waiting for jobs, and how many times it was woken up by others
+		uint64_t parks;
+		uint64_t unparks;
+		// how long the tasks waited from their submission until they started running, and how long they ran (including
+		// the time they spent suspended on a fiber), they're only collected if Fabric_Settings::enable_timing_stats is set
+		uint64_t queue_wait_histogram[FABRIC_STATS_HISTOGRAM_BUCKETS_COUNT];
+		uint64_t run_time_histogram[FABRIC_STATS_HISTOGRAM_BUCKETS_COUNT];
+		// the tasks submitted to the worker from other threads, and the tasks in its local deque, per priority
+		size_t job_q_count[FABRIC_TASK_PRIORITY_COUNT];
+		size_t local_q_count[FABRIC_TASK_PRIORITY_COUNT];
+	};
+
+	// a snapshot of the fabric's runtime stats
+	struct Fabric_Stats
+	{
+		// the workers in the fabric's slots, workers evicted by sysmon are replaced in their slots
+		Buf<Fabric_Worker_Stats> workers;
+		// the sum of all the workers the fabric ever had, including the evicted and the retired ones
+		Fabric_Worker_Stats total;
+		// tasks submitted from outside the fabric which no worker picked up yet, per priority
+		size_t injection_q_count[FABRIC_TASK_PRIORITY_COUNT];
+		// how many workers sysmon evicted because they were blocking
+		uint64_t blocking_evictions;
+		// how many submissions found the fabric overloaded
+		uint64_t overloaded_submissions;
+		// evicted workers which are still blocked, and evicted workers which are waiting to replace blocking ones
+		size_t sleepy_side_workers_count;
+		size_t ready_side_workers_count;
+		// workers which sysmon parked because the fabric was underutilized, see Fabric_Settings::min_workers_count
+		size_t surplus_workers_count;
+		// how many times sysmon left a blocking worker in place because the fabric reached max_threads_count
+		uint64_t skipped_evictions;
+		// the threads the fabric runs tasks on right now, see Fabric_Settings::max_threads_count
+		size_t threads_count;
+		// the blocking pool threads, and the blocking tasks which no pool thread picked up yet
+		size_t blocking_threads_count;
+		size_t blocking_q_count;
+	};
+
+	// returns a snapshot of the given fabric's stats, the counters are read without stopping the workers so the
+	// snapshot is not atomic, it's cheap enough to be sampled periodically by a monitoring thread
+	MN_EXPORT Fabric_Stats
+	fabric_stats(Fabric self);
+
+	// frees the given fabric stats
+	inline static void
+	fabric_stats_free(Fabric_Stats& self)
+	{
+		buf_free(self.workers);
+	}
+
+	// destruct overload for the fabric stats free function
+	inline static void
+	destruct(Fabric_Stats& self)
+	{
+		fabric_stats_free(self);
+	}
+
+	// runs fn(chunk) for each chunk in [0, chunks_count) using the given fabric, the calling thread takes chunks
+	// too and it returns when all the chunks are done, it's the building block of the parallel algorithms
+	MN_EXPORT void
+	_fabric_parallel_chunks(Fabric self, size_t chunks_count, Task<void(size_t)> fn);
+
+	// the default grain gives each worker a few chunks so that the faster workers can take more of them
+	constexpr static size_t PARALLEL_CHUNKS_PER_WORKER = 4;
+
+	// returns the number of chunks the given count of elements should be split into, grain is the number of
+	// elements per chunk, if it's 0 the grain is picked from the number of workers in the fabric
+	inline static size_t
+	_parallel_chunks_count(Fabric f, size_t count, size_t grain)
+	{
+		if (count == 0)
+			return 0;
+
+		if (grain > 0)
+			return (count + grain - 1) / grain;
+
+		if (f == nullptr)
+			return 1;
+
+		auto res = fabric_workers_count(f) * PARALLEL_CHUNKS_PER_WORKER;
+		if (res > count)
+			res = count;
+		return res;
+	}
+
+	// calls fn(chunk, begin, end) for each chunk of the given count of elements, the chunks are balanced
+	// contiguous ranges, it runs serially if there's no fabric
+	template<typename TFunc>
+	inline static void
+	_parallel_chunks_do(Fabric f, size_t count, size_t chunks_count, TFunc&& fn)
+	{
+		auto chunk_fn = [count, chunks_count, &fn](size_t chunk) {
+			auto base = count / chunks_count;
+			auto extra = count % chunks_count;
+			auto begin = chunk * base + (chunk < extra ? chunk : extra);
+			auto end = begin + base + (chunk < extra ? 1 : 0);
+			fn(chunk, begin, end);
+		};
+
+		if (f == nullptr || chunks_count < 2)
+		{
+			for (size_t i = 0; i < chunks_count; ++i)
+				chunk_fn(i);
+		}
+		else
+		{
+			_fabric_parallel_chunks(f, chunks_count, Task<void(size_t)>::make(chunk_fn));
+		}
+	}
+
+	// a graph of tasks where each task runs after all of its predecessors finish, the workers which finish a task
+	// schedule its ready successors directly so the whole graph runs without any blocking joins, the graph
+	// can be submitted again after it finishes without any reallocation
+	typedef struct IFabric_Graph* Fabric_Graph;
+
+	// creates a new empty fabric graph
+	MN_EXPORT Fabric_Graph
+	fabric_graph_new();
+
+	// frees the given fabric graph, it shouldn't be running
+	MN_EXPORT void
+	fabric_graph_free(Fabric_Graph self);
+
+	// destruct overload for fabric graph free
+	inline static void
+	destruct(Fabric_Graph self)
+	{
+		fabric_graph_free(self);
+	}
+
+	// adds a task node to the graph and returns its index, the graph owns the task and frees it with the graph
+	MN_EXPORT size_t
+	fabric_graph_task_add(Fabric_Graph self, const Fabric_Task& task);
+
+	// adds any callable as a task node to the graph and returns its index
+	template<typename TFunc>
+	inline static size_t
+	fabric_graph_add(Fabric_Graph self, TFunc&& f)
+	{
+		Fabric_Task entry{};
+		entry.task = fabric_task_make(std::forward<TFunc>(f));
+		return fabric_graph_task_add(self, entry);
+	}
+
+	// adds an edge to the graph which makes the `to` node run after the `from` node finishes
+	MN_EXPORT void
+	fabric_graph_edge_add(Fabric_Graph self, size_t from, size_t to);
+
+	// schedules the nodes of the given graph into the given fabric, the graph shouldn't be running
+	// it returns false without scheduling any node if the graph has a cycle, since the nodes in the cycle (and the
+	// ones after them) would never run
+	MN_EXPORT bool
+	fabric_graph_submit(Fabric_Graph self, Fabric f);
+
+	// waits until all the nodes of the submitted graph finish
+	MN_EXPORT void
+	fabric_graph_wait(Fabric_Graph self);
+
 	// represents the compute interface dimensions which is used to specify
 	// how many tasks you need along x, y, and z axis
 	// similar to graphics compute dispatch interface
@@ -230,14 +823,27 @@ namespace mn
 		Compute_Dims global_invocation_id;
 	};
 
-	// schedules the given callable into the given fabric
+	// schedules the given callable into the given fabric, it returns false if the fabric rejected it (see
+	// FABRIC_OVERLOAD_POLICY_REJECT) in which case the callable is dropped
 	template<typename TFunc>
-	inline static void
+	inline static bool
 	go(Fabric f, TFunc&& fn)
 	{
 		Fabric_Task entry{};
-		entry.task = Task<void()>::make(std::forward<TFunc>(fn));
-		fabric_task_do(f, entry);
+		entry.task = fabric_task_make(std::forward<TFunc>(fn));
+		return fabric_task_do(f, entry);
+	}
+
+	// schedules the given callable into the given fabric with the given priority, it returns false if the fabric
+	// rejected it in which case the callable is dropped
+	template<typename TFunc>
+	inline static bool
+	go(Fabric f, FABRIC_TASK_PRIORITY priority, TFunc&& fn)
+	{
+		Fabric_Task entry{};
+		entry.task = fabric_task_make(std::forward<TFunc>(fn));
+		entry.priority = priority;
+		return fabric_task_do(f, entry);
 	}
 
 	// schedules the given callable into the given worker
@@ -246,27 +852,28 @@ namespace mn
 	go(Worker worker, TFunc&& fn)
 	{
 		Fabric_Task entry{};
-		entry.task = Task<void()>::make(std::forward<TFunc>(fn));
+		entry.task = fabric_task_make(std::forward<TFunc>(fn));
 		worker_task_do(worker, entry);
 	}
 
 	// tries to schedule the given callable into the local worker/fabric
-	// if it doesn't find any it will panic
+	// if it doesn't find any it will panic, it returns false if the local fabric rejected it
 	template<typename TFunc>
-	inline static void
+	inline static bool
 	go(TFunc&& fn)
 	{
 		if (Fabric f = fabric_local())
 		{
 			Fabric_Task entry{};
-			entry.task = Task<void()>::make(std::forward<TFunc>(fn));
-			fabric_task_do(f, entry);
+			entry.task = fabric_task_make(std::forward<TFunc>(fn));
+			return fabric_task_do(f, entry);
 		}
 		else if (Worker w = worker_local())
 		{
 			Fabric_Task entry{};
-			entry.task = Task<void()>::make(std::forward<TFunc>(fn));
+			entry.task = fabric_task_make(std::forward<TFunc>(fn));
 			worker_task_do(w, entry);
+			return true;
 		}
 		else
 		{
@@ -274,13 +881,120 @@ namespace mn
 		}
 	}
 
+	// a strand runs the tasks posted to it one at a time and in the order they were posted, but on any of the fabric's
+	// workers, it's useful to serialize the work of a single connection or entity without guarding it with a mutex
+	// which blocks the workers, it doesn't lock, and it's only scheduled into the fabric while it has pending tasks
+	typedef struct IStrand* Strand;
+
+	// creates a new strand which runs its tasks in the given fabric with the given priority
+	MN_EXPORT Strand
+	strand_new(Fabric f, FABRIC_TASK_PRIORITY priority = FABRIC_TASK_PRIORITY_NORMAL);
+
+	// frees the given strand, the tasks which are already posted to it still run before it's actually freed
+	MN_EXPORT void
+	strand_free(Strand self);
+
+	// destruct overload for strand free
+	inline static void
+	destruct(Strand self)
+	{
+		strand_free(self);
+	}
+
+	// posts a task to the given strand, it will run after all the previously posted tasks have finished
+	MN_EXPORT void
+	strand_task_do(Strand self, Task<void()> task);
+
+	// schedules the given callable into the given strand
+	template<typename TFunc>
+	inline static void
+	go(Strand strand, TFunc&& fn)
+	{
+		strand_task_do(strand, fabric_task_make(std::forward<TFunc>(fn)));
+	}
+
+	// a task group tracks the tasks spawned into it so they can be waited on or cancelled together, cancelling a group
+	// skips its tasks which didn't start yet, and the running ones can poll task_group_cancelled to stop early, a group
+	// is also cancelled once its deadline passes, and a child group is cancelled with its parent and never outlives the
+	// parent's deadline
+	typedef struct ITask_Group* Task_Group;
+
+	// creates a new task group which spawns its tasks into the given fabric, the group is cancelled after the given
+	// timeout passes
+	MN_EXPORT Task_Group
+	task_group_new(Fabric f, Timeout timeout = INFINITE_TIMEOUT);
+
+	// creates a new task group which is cancelled along with the given parent group, its deadline is the earlier of
+	// the given timeout and the parent's deadline
+	MN_EXPORT Task_Group
+	task_group_new_child(Task_Group parent, Timeout timeout = INFINITE_TIMEOUT);
+
+	// waits for the group's tasks to finish and then frees it, so the tasks can use the group while they run
+	MN_EXPORT void
+	task_group_free(Task_Group self);
+
+	// destruct overload for task group free
+	inline static void
+	destruct(Task_Group self)
+	{
+		task_group_free(self);
+	}
+
+	// spawns a task into the given group, it's skipped if the group is cancelled before the task starts
+	MN_EXPORT void
+	task_group_task_do(Task_Group self, Task<void()> task);
+
+	// spawns the given callable into the given group
+	template<typename TFunc>
+	inline static void
+	task_group_spawn(Task_Group self, TFunc&& fn)
+	{
+		task_group_task_do(self, fabric_task_make(std::forward<TFunc>(fn)));
+	}
+
+	// waits for all the tasks spawned into the group so far, the skipped tasks are counted as finished
+	MN_EXPORT void
+	task_group_wait(Task_Group self);
+
+	// cancels the given group and its children
+	MN_EXPORT void
+	task_group_cancel(Task_Group self);
+
+	// returns whether the given group or any of its parents is cancelled or past its deadline, it's cheap enough to be
+	// polled in the inner loops of the running tasks
+	MN_EXPORT bool
+	task_group_cancelled(Task_Group self);
+
+	// returns the time left until the group's deadline, it's meant to be passed to the blocking calls (chan_recv,
+	// socket_read, ...) made by the group's tasks so they don't wait past the deadline
+	MN_EXPORT Timeout
+	task_group_timeout(Task_Group self);
+
+	// default byte capacity of the channel streams created by lazy_stream
+	constexpr static size_t CHAN_STREAM_DEFAULT_BUFFER_SIZE = 64ULL * 1024ULL;
+
 	// a message passing primitive used to communicate between fabric tasks
 	// this one is built around messages being simple byte streams
 	// which is useful if you're going to do work like encryption/compression
+	// it works in one of two modes:
+	// - unbuffered (buffer size is 0): each write blocks until the reader has copied all of its bytes out
+	// - buffered: writes are copied into a byte ring buffer and only block when it's full
+	// whole blocks can also be handed over without copying using chan_stream_write_block/chan_stream_read_block
 	typedef struct IChan_Stream* Chan_Stream;
 	struct IChan_Stream final: IStream
 	{
+		// the block of the writer which is currently blocked in an unbuffered write
 		Block data_blob;
+		// byte ring buffer of the buffered mode, it's empty in unbuffered mode
+		Block ring_blob;
+		size_t ring_head;
+		size_t ring_count;
+		// blocks transferred using chan_stream_write_block, they're owned by the stream until they're read
+		Ring<Block> blocks;
+		// number of already read bytes of the front block
+		size_t blocks_offset;
+		// number of unread bytes in all the blocks
+		size_t blocks_size;
 		Mutex mtx;
 		Cond_Var read_cv;
 		Cond_Var write_cv;
@@ -316,9 +1030,10 @@ namespace mn
 	};
 
 	// creates a new channel stream which is a message passing primitive used
-	// to communicate between fabric tasks in byte/binary messages
+	// to communicate between fabric tasks in byte/binary messages, if buffer_size is 0 the stream is unbuffered and
+	// each write blocks until it's read, otherwise writers only block when buffer_size bytes are waiting to be read
 	MN_EXPORT Chan_Stream
-	chan_stream_new();
+	chan_stream_new(size_t buffer_size = 0);
 
 	// frees the given channel stream, by decrementing its reference count and only freeing it if it reaches 0
 	MN_EXPORT void
@@ -346,6 +1061,18 @@ namespace mn
 	MN_EXPORT bool
 	chan_stream_closed(Chan_Stream self);
 
+	// transfers the ownership of the given block to the channel stream without copying it, the block should be
+	// allocated using memory::clib(), it blocks while the stream already has buffer_size bytes (or any block in
+	// unbuffered mode) waiting to be read, the block is freed by the stream if it's read using stream_read
+	MN_EXPORT void
+	chan_stream_write_block(Chan_Stream self, Block block);
+
+	// reads the next available bytes as a whole block and transfers its ownership to the caller, blocks written
+	// using chan_stream_write_block are returned as is, otherwise the available bytes are copied into a new block,
+	// the returned block is allocated using memory::clib(), it returns an empty block if the stream is closed and empty
+	MN_EXPORT Block
+	chan_stream_read_block(Chan_Stream self);
+
 	// automatic wrapper around channel stream which uses RAII to handle the reference counting
 	// useful for scoped usage of channel streams
 	struct Auto_Chan_Stream
@@ -356,6 +1083,10 @@ namespace mn
 			: handle(chan_stream_new())
 		{}
 
+		explicit Auto_Chan_Stream(size_t buffer_size)
+			: handle(chan_stream_new(buffer_size))
+		{}
+
 		explicit Auto_Chan_Stream(Chan_Stream s)
 			: handle(chan_stream_ref(s))
 		{}
@@ -420,46 +1151,79 @@ namespace mn
 	// copy_stream(encrypted_stream, my_output_stream);
 	// ```
 	// this way you won't need to load the entire file into memory in order to process it
+	// the returned stream is buffered with CHAN_STREAM_DEFAULT_BUFFER_SIZE bytes so the stages of the pipeline overlap
+	// instead of waiting on each other's writes, stages which produce whole blocks can hand them over without copying
+	// using chan_stream_write_block
+	// if the fabric rejects the stage (see FABRIC_OVERLOAD_POLICY_REJECT) the returned stream is closed right away
 	template<typename TFunc, typename ... TArgs>
 	inline static Auto_Chan_Stream
-	lazy_stream(Fabric f, TFunc&& func, mn::Stream stream_in, TArgs&& ... args)
+	lazy_stream_with_buffer_size(Fabric f, size_t buffer_size, TFunc&& func, mn::Stream stream_in, TArgs&& ... args)
 	{
-		Auto_Chan_Stream res;
-		mn::go(f, [=]{
+		Auto_Chan_Stream res{buffer_size};
+		auto accepted = mn::go(f, [=]{
 			func(stream_in, res, args...);
 			chan_stream_close(res);
 		});
+		if (accepted == false)
+			chan_stream_close(res);
 		return res;
 	}
 
+	template<typename TFunc, typename ... TArgs>
+	inline static Auto_Chan_Stream
+	lazy_stream(Fabric f, TFunc&& func, mn::Stream stream_in, TArgs&& ... args)
+	{
+		return lazy_stream_with_buffer_size(f, CHAN_STREAM_DEFAULT_BUFFER_SIZE, std::forward<TFunc>(func), stream_in, std::forward<TArgs>(args)...);
+	}
+
+
+	// a task blocked on channels, it registers itself in all the channels it waits on (more than one in chan_select)
+	// and sleeps once until any of them changes
+	using Chan_Select_Waiter = Worker_Waiter;
+
+	// wakes up the given select waiters, the channel's mutex should be locked
+	MN_EXPORT void
+	_chan_select_waiters_notify(Buf<Chan_Select_Waiter*>& waiters);
 
 	// a generic message passing primitive used to communicate between fabric tasks
+	// values go through a lock-free bounded ring, the mutex and the condition variables are only used to park the
+	// senders and the recievers when the ring is full or empty
 	template<typename T>
 	struct IChan
 	{
-		Ring<T> r;
+		MPMC_Ring<T> r;
 		Mutex mtx;
 		Cond_Var read_cv;
 		Cond_Var write_cv;
+		// select waiters are woken up on every send, recieve, and close, they're protected by the mutex
+		Buf<Chan_Select_Waiter*> select_waiters;
+		// parked senders and recievers plus the registered select waiters, senders and recievers only lock the mutex
+		// to wake them up if it's not 0
+		std::atomic<int32_t> atomic_sleepers;
+		// the ring is rounded up to a power of 2 so the senders reserve their slots in the count which keeps the
+		// channel within the limit it was created with, the limit is 0 once the channel is closed
+		std::atomic<int32_t> atomic_count;
 		std::atomic<int32_t> atomic_limit;
 		std::atomic<int32_t> atomic_arc;
 	};
 	template<typename T>
 	using Chan = IChan<T>*;
 
-	// creates a new channel
+	// creates a new channel, the limit is the number of values it can hold before the senders block
 	template<typename T>
 	inline static Chan<T>
 	chan_new(int32_t limit = 1)
 	{
-		mn_assert(limit != 0);
+		mn_assert(limit > 0);
 		Chan<T> self = alloc<IChan<T>>();
 
-		self->r = ring_new<T>();
-		ring_reserve(self->r, limit);
+		self->r = mpmc_ring_new<T>(size_t(limit));
 		self->mtx = mn_mutex_new_with_srcloc("Channel Mutex");
 		self->read_cv = cond_var_new();
 		self->write_cv = cond_var_new();
+		self->select_waiters = buf_new<Chan_Select_Waiter*>();
+		self->atomic_sleepers = 0;
+		self->atomic_count = 0;
 		self->atomic_limit = limit;
 		self->atomic_arc = 1;
 		return self;
@@ -494,10 +1258,14 @@ namespace mn
 		{
 			chan_close(self);
 
-			destruct(self->r);
+			T value{};
+			while (mpmc_ring_pop_try(self->r, value))
+				destruct(value);
+			mpmc_ring_free(self->r);
 			mutex_free(self->mtx);
 			cond_var_free(self->read_cv);
 			cond_var_free(self->write_cv);
+			buf_free(self->select_waiters);
 			mn::free(self);
 			return nullptr;
 		}
@@ -545,36 +1313,200 @@ namespace mn
 	{
 		mutex_lock(self->mtx);
 		self->atomic_limit.exchange(0);
+		_chan_select_waiters_notify(self->select_waiters);
 		mutex_unlock(self->mtx);
 		cond_var_notify_all(self->read_cv);
 		cond_var_notify_all(self->write_cv);
 	}
 
+	// represents the return of the channel recieve operation
+	template<typename T>
+	struct Recv_Result
+	{
+		// the actualy recieved value
+		T res;
+		// boolean to indicate whether the recieve operation succeeded
+		bool more;
+	};
+
+	template<typename T>
+	inline static void
+	_chan_select_waiter_add(void* chan, Chan_Select_Waiter* waiter)
+	{
+		auto self = (Chan<T>)chan;
+		mutex_lock(self->mtx);
+		buf_push(self->select_waiters, waiter);
+		self->atomic_sleepers.fetch_add(1);
+		mutex_unlock(self->mtx);
+		// pairs with the fence in _chan_wake so that either the channel sees the waiter or the select sees the change
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+	}
+
+	template<typename T>
+	inline static void
+	_chan_select_waiter_remove(void* chan, Chan_Select_Waiter* waiter)
+	{
+		auto self = (Chan<T>)chan;
+		mutex_lock(self->mtx);
+		for (size_t i = 0; i < self->select_waiters.count; ++i)
+		{
+			if (self->select_waiters[i] == waiter)
+			{
+				buf_remove(self->select_waiters, i);
+				self->atomic_sleepers.fetch_sub(1);
+				break;
+			}
+		}
+		mutex_unlock(self->mtx);
+	}
+
+	// wakes up the parked parties of the channel after values are sent or recieved through the ring
+	template<typename T>
+	inline static void
+	_chan_wake(Chan<T> self, Cond_Var cv, bool all)
+	{
+		// pairs with the fence in _chan_park so that either we see the sleeper or it sees the ring change
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (self->atomic_sleepers.load(std::memory_order_relaxed) == 0)
+			return;
+
+		// parked threads check the ring while holding the mutex so locking it here makes sure that
+		// they're either waiting on the condition variable or will see the change
+		mutex_lock(self->mtx);
+		_chan_select_waiters_notify(self->select_waiters);
+		mutex_unlock(self->mtx);
+		if (all)
+			cond_var_notify_all(cv);
+		else
+			cond_var_notify(cv);
+	}
+
+	// waits until the given function returns true, if the caller is running on a fabric fiber it suspends the fiber
+	// instead of blocking the worker thread
+	template<typename T, typename TFunc>
+	inline static void
+	_chan_park(Chan<T> self, Cond_Var cv, TFunc&& ready)
+	{
+		// fibers register a waiter like chan_select does so that the channel resumes them when it changes
+		if (worker_on_fiber())
+		{
+			Chan_Select_Waiter waiter{};
+			while (ready() == false)
+			{
+				_worker_waiter_reset(&waiter);
+				_chan_select_waiter_add<T>(self, &waiter);
+				if (ready() == false)
+					_worker_waiter_wait(&waiter);
+				_chan_select_waiter_remove<T>(self, &waiter);
+			}
+			return;
+		}
+
+		mutex_lock(self->mtx);
+		self->atomic_sleepers.fetch_add(1);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		cond_var_wait(cv, self->mtx, ready);
+		self->atomic_sleepers.fetch_sub(1);
+		mutex_unlock(self->mtx);
+	}
+
+	// returns whether the channel has room under its limit, it's only a hint when other threads use the channel
+	template<typename T>
+	inline static bool
+	_chan_has_room(Chan<T> self)
+	{
+		return self->atomic_count.load() < self->atomic_limit.load();
+	}
+
+	// reserves a slot under the channel's limit and pushes the given value into the ring, it returns whether the value
+	// was pushed
+	template<typename T>
+	inline static bool
+	_chan_push_try(Chan<T> self, const T& v)
+	{
+		auto count = self->atomic_count.load();
+		do
+		{
+			if (count >= self->atomic_limit.load())
+				return false;
+		} while (self->atomic_count.compare_exchange_weak(count, count + 1) == false);
+
+		if (mpmc_ring_push_try(self->r, v))
+			return true;
+
+		// a reciever which is still reading the slot makes the ring look full for a moment
+		self->atomic_count.fetch_sub(1);
+		return false;
+	}
+
+	// pops a value from the ring and releases its slot, it returns whether it got a value
+	template<typename T>
+	inline static bool
+	_chan_pop_try(Chan<T> self, T& v)
+	{
+		if (mpmc_ring_pop_try(self->r, v) == false)
+			return false;
+
+		self->atomic_count.fetch_sub(1);
+		return true;
+	}
+
+	// tries to send the given value without blocking, it returns whether the value was sent
+	template<typename T>
+	inline static bool
+	_chan_send_try(Chan<T> self, const T& v)
+	{
+		if (chan_closed(self))
+			panic("cannot send in a closed channel");
+
+		if (_chan_push_try(self, v) == false)
+			return false;
+
+		_chan_wake(self, self->read_cv, false);
+		return true;
+	}
+
+	// tries to recieve a value without blocking, it returns true if it got a value or if the channel is closed and
+	// empty in which case the result has more set to false
+	template<typename T>
+	inline static bool
+	_chan_recv_try(Chan<T> self, Recv_Result<T>& res)
+	{
+		// values which were sent before the close are still recieved
+		auto closed = chan_closed(self);
+		if (_chan_pop_try(self, res.res))
+		{
+			res.more = true;
+			_chan_wake(self, self->write_cv, false);
+			return true;
+		}
+
+		if (closed)
+		{
+			res.res = T{};
+			res.more = false;
+			return true;
+		}
+		return false;
+	}
+
 	// checks whether you can send to the given channel
 	template<typename T>
 	inline static bool
 	chan_can_send(Chan<T> self)
 	{
-		mutex_lock(self->r_mtx);
-			bool res = (self->r.count < size_t(self->atomic_limit.load())) && (chan_closed(self) == false);
-		mutex_unlock(self->r_mtx);
-		return res;
+		return _chan_has_room(self) && chan_closed(self) == false;
 	}
 
-	// tries to send the given value to the channel and returns whether it succeeded or not
+	// tries to send the given value to the channel and returns whether it succeeded or not, it fails if the channel
+	// is full or closed
 	template<typename T>
 	inline static bool
 	chan_send_try(Chan<T> self, const T& v)
 	{
-		mutex_lock(self->mtx);
-		mn_defer(mutex_unlock(self->mtx));
-
-		if (self->r.count < self->limit)
-		{
-			ring_push_back(self->r, v);
-			return true;
-		}
-		return false;
+		if (chan_closed(self))
+			return false;
+		return _chan_send_try(self, v);
 	}
 
 	// sends the given value to the channel, if it doesn't succeed it will block until it the value is sent
@@ -582,22 +1514,48 @@ namespace mn
 	inline static void
 	chan_send(Chan<T> self, const T& v)
 	{
+		if (_chan_send_try(self, v))
+			return;
+
 		chan_ref(self);
 		mn_defer(chan_unref(self));
 
-		mutex_lock(self->mtx);
-		cond_var_wait(self->write_cv, self->mtx, [self] {
-			return (self->r.count < size_t(self->atomic_limit.load()) ||
-					chan_closed(self));
-		});
+		do
+		{
+			_chan_park(self, self->write_cv, [self] {
+				return _chan_has_room(self) || chan_closed(self);
+			});
+		} while (_chan_send_try(self, v) == false);
+	}
 
-		if (chan_closed(self))
-			panic("cannot send in a closed channel");
+	// sends the given values to the channel in order, it blocks until all of them are sent
+	template<typename T>
+	inline static void
+	chan_send_n(Chan<T> self, const T* values, size_t count)
+	{
+		chan_ref(self);
+		mn_defer(chan_unref(self));
 
-		ring_push_back(self->r, v);
-		mutex_unlock(self->mtx);
+		size_t sent_count = 0;
+		while (true)
+		{
+			if (chan_closed(self))
+				panic("cannot send in a closed channel");
+
+			auto start = sent_count;
+			while (sent_count < count && _chan_push_try(self, values[sent_count]))
+				++sent_count;
+
+			if (sent_count > start)
+				_chan_wake(self, self->read_cv, true);
 
-		cond_var_notify(self->read_cv);
+			if (sent_count == count)
+				break;
+
+			_chan_park(self, self->write_cv, [self] {
+				return _chan_has_room(self) || chan_closed(self);
+			});
+		}
 	}
 
 	// checks whether you can recieve from the given channel
@@ -605,37 +1563,21 @@ namespace mn
 	inline static bool
 	chan_can_recv(Chan<T> self)
 	{
-		mutex_lock(self->mtx);
-			bool res = (self->r.count > 0) && (chan_closed(self) == false);
-		mutex_unlock(self->mtx);
-		return res;
+		return mpmc_ring_count(self->r) > 0 && chan_closed(self) == false;
 	}
 
-	// represents the return of the channel recieve operation
-	template<typename T>
-	struct Recv_Result
-	{
-		// the actualy recieved value
-		T res;
-		// boolean to indicate whether the recieve operation succeeded
-		bool more;
-	};
-
 	// tries to recieve a value from the given channel
 	template<typename T>
 	inline static Recv_Result<T>
 	chan_recv_try(Chan<T> self)
 	{
-		mutex_lock(self->mtx);
-		mn_defer(mutex_unlock(self->mtx));
-
-		if (self->r.count > 0)
+		Recv_Result<T> res{};
+		if (_chan_pop_try(self, res.res))
 		{
-			T res = ring_front(self->r);
-			ring_pop_front(self->r);
-			return { res, true };
+			res.more = true;
+			_chan_wake(self, self->write_cv, false);
 		}
-		return { T{}, false };
+		return res;
 	}
 
 	// recieves a value from the given channel, it doesn't succeed it will block until a value is recieved
@@ -643,31 +1585,55 @@ namespace mn
 	inline static Recv_Result<T>
 	chan_recv(Chan<T> self)
 	{
+		Recv_Result<T> res{};
+		if (_chan_recv_try(self, res))
+			return res;
+
 		chan_ref(self);
 		mn_defer(chan_unref(self));
 
-		mutex_lock(self->mtx);
-		cond_var_wait(self->read_cv, self->mtx, [self] {
-			return self->r.count > 0 || chan_closed(self);
-		});
-
-		if(self->r.count > 0)
+		do
 		{
-			T res = ring_front(self->r);
-			ring_pop_front(self->r);
-			mutex_unlock(self->mtx);
+			_chan_park(self, self->read_cv, [self] {
+				return mpmc_ring_count(self->r) > 0 || chan_closed(self);
+			});
+		} while (_chan_recv_try(self, res) == false);
+		return res;
+	}
 
-			cond_var_notify(self->write_cv);
-			return { res, true };
-		}
-		else if(chan_closed(self))
-		{
-			mutex_unlock(self->mtx);
-			return { T{}, false };
-		}
-		else
+	// recieves up to count values from the given channel into the given values, it blocks until at least one value
+	// is available then it takes the available ones without blocking, it returns the number of recieved values
+	// which is 0 only if the channel is closed and empty
+	template<typename T>
+	inline static size_t
+	chan_recv_n(Chan<T> self, T* values, size_t count)
+	{
+		if (count == 0)
+			return 0;
+
+		chan_ref(self);
+		mn_defer(chan_unref(self));
+
+		while (true)
 		{
-			panic("unreachable");
+			auto closed = chan_closed(self);
+
+			size_t res = 0;
+			while (res < count && _chan_pop_try(self, values[res]))
+				++res;
+
+			if (res > 0)
+			{
+				_chan_wake(self, self->write_cv, true);
+				return res;
+			}
+
+			if (closed)
+				return 0;
+
+			_chan_park(self, self->read_cv, [self] {
+				return mpmc_ring_count(self->r) > 0 || chan_closed(self);
+			});
 		}
 	}
 
@@ -859,6 +1825,343 @@ namespace mn
 		return chan_recv(self.handle);
 	}
 
+	// a single case of chan_select, it's either a send or a recieve on a channel, use chan_select_send and
+	// chan_select_recv to create it
+	struct Chan_Select_Case
+	{
+		void* chan;
+		// the value to send, or the Recv_Result to recieve into
+		void* value;
+		// tries the case's operation without blocking and returns whether it was done
+		bool (*try_op)(void* chan, void* value);
+		void (*waiter_add)(void* chan, Chan_Select_Waiter* waiter);
+		void (*waiter_remove)(void* chan, Chan_Select_Waiter* waiter);
+	};
+
+	// returned by chan_select when none of the cases is ready before the timeout
+	constexpr static size_t CHAN_SELECT_TIMEOUT = SIZE_MAX;
+
+	// waits until one of the given cases is done and returns its index, if more than one case is ready it picks one of
+	// them fairly, with NO_TIMEOUT it acts like a select with a default case and returns CHAN_SELECT_TIMEOUT right away
+	// if none of the cases is ready, the calling task sleeps once on all the channels instead of polling them and if
+	// it's running on a fabric fiber it suspends the fiber instead of blocking the worker
+	// a recieve case on a closed channel is ready and its result has more set to false, a send case on a closed
+	// channel panics just like chan_send
+	MN_EXPORT size_t
+	chan_select(const Chan_Select_Case* cases, size_t count, Timeout timeout = INFINITE_TIMEOUT);
+
+	// initializer list overload of chan_select which lets you write the cases inline
+	// `chan_select({chan_select_recv(a, &res), chan_select_send(b, &value)}, Timeout{10})`
+	inline static size_t
+	chan_select(std::initializer_list<Chan_Select_Case> cases, Timeout timeout = INFINITE_TIMEOUT)
+	{
+		return chan_select(cases.begin(), cases.size(), timeout);
+	}
+
+	template<typename T>
+	inline static bool
+	_chan_select_send_try(void* chan, void* value)
+	{
+		return _chan_send_try((Chan<T>)chan, *(const T*)value);
+	}
+
+	template<typename T>
+	inline static bool
+	_chan_select_recv_try(void* chan, void* value)
+	{
+		return _chan_recv_try((Chan<T>)chan, *(Recv_Result<T>*)value);
+	}
+
+	// creates a select case which sends the given value to the channel, the value should outlive the select call
+	template<typename T>
+	inline static Chan_Select_Case
+	chan_select_send(Chan<T> self, const T* value)
+	{
+		Chan_Select_Case res{};
+		res.chan = self;
+		res.value = (void*)value;
+		res.try_op = _chan_select_send_try<T>;
+		res.waiter_add = _chan_select_waiter_add<T>;
+		res.waiter_remove = _chan_select_waiter_remove<T>;
+		return res;
+	}
+
+	// creates a select case which recieves a value from the channel into the given result
+	template<typename T>
+	inline static Chan_Select_Case
+	chan_select_recv(Chan<T> self, Recv_Result<T>* res)
+	{
+		Chan_Select_Case c{};
+		c.chan = self;
+		c.value = res;
+		c.try_op = _chan_select_recv_try<T>;
+		c.waiter_add = _chan_select_waiter_add<T>;
+		c.waiter_remove = _chan_select_waiter_remove<T>;
+		return c;
+	}
+
+	// creates a select case which sends the given value to the automatic channel
+	template<typename T>
+	inline static Chan_Select_Case
+	chan_select_send(const Auto_Chan<T>& self, const T* value)
+	{
+		return chan_select_send(self.handle, value);
+	}
+
+	// creates a select case which recieves a value from the automatic channel into the given result
+	template<typename T>
+	inline static Chan_Select_Case
+	chan_select_recv(const Auto_Chan<T>& self, Recv_Result<T>* res)
+	{
+		return chan_select_recv(self.handle, res);
+	}
+
+	// the states of a future's completion word, waiters which can't run other tasks sleep on it
+	enum FUTURE_STATE: int32_t
+	{
+		FUTURE_STATE_PENDING,
+		FUTURE_STATE_PENDING_WITH_SLEEPERS,
+		FUTURE_STATE_READY,
+	};
+
+	// a continuation which runs once its future completes
+	struct Future_Continuation
+	{
+		Task<void()> fn;
+		Future_Continuation* next;
+	};
+
+	// adds the given continuation to the future's continuations, if the future is already completed the continuation
+	// runs right away on the calling thread
+	MN_EXPORT void
+	_future_continuation_add(std::atomic<Future_Continuation*>& continuations, Task<void()> fn);
+
+	// marks the future's state as ready, wakes up its waiters and runs its continuations in the order they were added
+	MN_EXPORT void
+	_future_complete(std::atomic<int32_t>& state, std::atomic<Future_Continuation*>& continuations);
+
+	// waits until the given future state becomes ready, fibers are suspended until a continuation wakes them up and
+	// workers run other fabric tasks while they wait, other threads sleep on the state
+	MN_EXPORT void
+	_future_wait(std::atomic<int32_t>& state, std::atomic<Future_Continuation*>& continuations);
+
+	// a value which will be available in the future, it's completed once by its promise and it can be waited on or
+	// continued with other functions, it's reference counted like channels
+	template<typename T>
+	struct IFuture
+	{
+		std::atomic<int32_t> atomic_state;
+		std::atomic<int32_t> atomic_arc;
+		std::atomic<Future_Continuation*> atomic_continuations;
+		T value;
+	};
+	template<typename T>
+	using Future = IFuture<T>*;
+
+	// creates a new pending future, you'll usually get futures from promises or go_future instead
+	template<typename T>
+	inline static Future<T>
+	future_new()
+	{
+		static_assert(std::is_void_v<T> == false, "futures should have a value, use a waitgroup to wait on void tasks");
+
+		// futures are shared between threads so they always come from the clib allocator
+		auto self = alloc_from<IFuture<T>>(memory::clib());
+		::new (self) IFuture<T>();
+		self->atomic_state = FUTURE_STATE_PENDING;
+		self->atomic_arc = 1;
+		self->atomic_continuations = nullptr;
+		return self;
+	}
+
+	// increments the reference count of the given future
+	template<typename T>
+	inline static Future<T>
+	future_ref(Future<T> self)
+	{
+		self->atomic_arc.fetch_add(1);
+		return self;
+	}
+
+	// decrements the reference count of the given future and frees it along with its value if it reaches 0
+	template<typename T>
+	inline static Future<T>
+	future_unref(Future<T> self)
+	{
+		if (self->atomic_arc.fetch_sub(1) == 1)
+		{
+			destruct(self->value);
+			free_from(memory::clib(), self);
+			return nullptr;
+		}
+		return self;
+	}
+
+	// frees the given future, by decrementing its reference count and only freeing it if it reaches 0
+	template<typename T>
+	inline static void
+	future_free(Future<T> self)
+	{
+		future_unref(self);
+	}
+
+	// destruct overload of future free
+	template<typename T>
+	inline static void
+	destruct(Future<T> self)
+	{
+		future_free(self);
+	}
+
+	// returns whether the given future is completed
+	template<typename T>
+	inline static bool
+	future_ready(Future<T> self)
+	{
+		return self->atomic_state.load(std::memory_order_acquire) == FUTURE_STATE_READY;
+	}
+
+	// completes the given future with the given value, it wakes up the waiters and runs the continuations on the
+	// calling thread, a future can only be completed once
+	template<typename T, typename TValue>
+	inline static void
+	_future_complete(Future<T> self, TValue&& value)
+	{
+		self->value = std::forward<TValue>(value);
+		_future_complete(self->atomic_state, self->atomic_continuations);
+	}
+
+	// waits until the given future is completed and returns its value, the future owns the value so it's valid as
+	// long as you hold a reference to the future, if the caller is a fabric task it runs the other fabric tasks
+	// (or suspends its fiber) while it waits instead of blocking the worker
+	template<typename T>
+	inline static const T&
+	future_wait(Future<T> self)
+	{
+		_future_wait(self->atomic_state, self->atomic_continuations);
+		return self->value;
+	}
+
+	// runs the given function with the future's value once it completes, the function runs on the thread which
+	// completes the future (or on the calling thread if it's already completed), if the function returns a value
+	// you get a future of it which you should free
+	template<typename T, typename TFunc>
+	inline static auto
+	future_then(Future<T> self, TFunc&& fn)
+	{
+		using R = std::invoke_result_t<TFunc, const T&>;
+		if constexpr (std::is_void_v<R>)
+		{
+			auto continuation = fabric_task_make([self = future_ref(self), fn = std::forward<TFunc>(fn)]() mutable {
+				fn(self->value);
+				future_unref(self);
+			});
+			_future_continuation_add(self->atomic_continuations, continuation);
+		}
+		else
+		{
+			auto res = future_new<R>();
+			auto continuation = fabric_task_make([self = future_ref(self), res = future_ref(res), fn = std::forward<TFunc>(fn)]() mutable {
+				_future_complete(res, fn(self->value));
+				future_unref(res);
+				future_unref(self);
+			});
+			_future_continuation_add(self->atomic_continuations, continuation);
+			return res;
+		}
+	}
+
+	// the producer side of a future, it's used to complete the future with its value
+	template<typename T>
+	struct Promise
+	{
+		Future<T> future;
+	};
+
+	// creates a new promise with a pending future
+	template<typename T>
+	inline static Promise<T>
+	promise_new()
+	{
+		return Promise<T>{future_new<T>()};
+	}
+
+	// frees the given promise, it doesn't complete the future so its waiters would wait forever if it wasn't set
+	template<typename T>
+	inline static void
+	promise_free(Promise<T> self)
+	{
+		future_unref(self.future);
+	}
+
+	// destruct overload of promise free
+	template<typename T>
+	inline static void
+	destruct(Promise<T> self)
+	{
+		promise_free(self);
+	}
+
+	// returns a new reference to the promise's future which you should free
+	template<typename T>
+	inline static Future<T>
+	promise_future(Promise<T> self)
+	{
+		return future_ref(self.future);
+	}
+
+	// completes the promise's future with the given value, it can only be called once
+	template<typename T, typename TValue>
+	inline static void
+	promise_set(Promise<T> self, TValue&& value)
+	{
+		_future_complete(self.future, std::forward<TValue>(value));
+	}
+
+	// schedules the given callable into the given fabric and returns a future of its result which you should free,
+	// it returns nullptr if the fabric rejected the callable (see FABRIC_OVERLOAD_POLICY_REJECT)
+	template<typename TFunc>
+	inline static auto
+	go_future(Fabric f, TFunc&& fn)
+	{
+		using R = std::invoke_result_t<TFunc>;
+		auto res = future_new<R>();
+		auto accepted = go(f, [res = future_ref(res), fn = std::forward<TFunc>(fn)]() mutable {
+			_future_complete(res, fn());
+			future_unref(res);
+		});
+		if (accepted == false)
+		{
+			// the dropped task didn't release its reference
+			future_unref(res);
+			future_unref(res);
+			return Future<R>{};
+		}
+		return res;
+	}
+
+	// tries to schedule the given callable into the local fabric and returns a future of its result
+	// if it doesn't find any it will panic, it returns nullptr if the local fabric rejected the callable
+	template<typename TFunc>
+	inline static auto
+	go_future(TFunc&& fn)
+	{
+		using R = std::invoke_result_t<TFunc>;
+		auto res = future_new<R>();
+		auto accepted = go([res = future_ref(res), fn = std::forward<TFunc>(fn)]() mutable {
+			_future_complete(res, fn());
+			future_unref(res);
+		});
+		if (accepted == false)
+		{
+			// the dropped task didn't release its reference
+			future_unref(res);
+			future_unref(res);
+			return Future<R>{};
+		}
+		return res;
+	}
+
 	template<typename TFunc>
 	inline static void
 	_single_threaded_compute(Compute_Dims global, Compute_Dims local, TFunc&& fn)
@@ -1057,4 +2360,123 @@ namespace mn
 		else
 			_multi_threaded_compute_tiled(f, global, tile_size, mn::Task<void(Compute_Args)>::make(std::forward<TFunc>(fn)));
 	}
+
+	template<typename TFunc>
+	inline static void
+	_compute_chunked(Fabric f, Compute_Dims global, Compute_Dims size, Compute_Dims local, TFunc&& fn)
+	{
+		auto local_count = local.x * local.y * local.z;
+		auto total_count = global.x * global.y * global.z * local_count;
+		if (total_count == 0)
+			return;
+
+		// the calling thread takes chunks too, so it gets its own tmp memory which can be cleared safely
+		auto tmp = allocator_arena_new();
+		auto old = _memory_tmp_set(tmp);
+		mn_defer({
+			_memory_tmp_set(old);
+			allocator_free(tmp);
+		});
+
+		_parallel_chunks_do(f, total_count, _parallel_chunks_count(f, total_count, 0), [&](size_t, size_t begin, size_t end) {
+			// invocations are ordered by workgroup then by local invocation, we only decompose the first index
+			// of the range and then step through the rest
+			auto workgroup_index = begin / local_count;
+			auto local_index = begin % local_count;
+
+			Compute_Args args{};
+			args.workgroup_size = local;
+			args.workgroup_num = global;
+			args.workgroup_id = Compute_Dims{
+				workgroup_index % global.x,
+				(workgroup_index / global.x) % global.y,
+				workgroup_index / (global.x * global.y)
+			};
+			args.local_invocation_id = Compute_Dims{
+				local_index % local.x,
+				(local_index / local.x) % local.y,
+				local_index / (local.x * local.y)
+			};
+
+			auto& workgroup_id = args.workgroup_id;
+			auto& local_id = args.local_invocation_id;
+			auto tmp_checkpoint = memory::tmp()->checkpoint();
+			for (size_t i = begin; i < end; ++i)
+			{
+				// workgroup_id * workgroup_size + local_invocation_id
+				args.global_invocation_id = Compute_Dims{
+					workgroup_id.x * local.x + local_id.x,
+					workgroup_id.y * local.y + local_id.y,
+					workgroup_id.z * local.z + local_id.z,
+				};
+				if (args.global_invocation_id.x < size.x && args.global_invocation_id.y < size.y && args.global_invocation_id.z < size.z)
+					fn(args);
+
+				if (++local_id.x < local.x)
+					continue;
+				local_id.x = 0;
+				if (++local_id.y < local.y)
+					continue;
+				local_id.y = 0;
+				if (++local_id.z < local.z)
+					continue;
+				local_id.z = 0;
+
+				if (++workgroup_id.x < global.x)
+					continue;
+				workgroup_id.x = 0;
+				if (++workgroup_id.y < global.y)
+					continue;
+				workgroup_id.y = 0;
+				++workgroup_id.z;
+			}
+			memory::tmp()->restore(tmp_checkpoint);
+		});
+	}
+
+	// dispatches a compute task with the given global and local dimensions like compute, but instead of a task per
+	// workgroup each task gets a contiguous range of invocations sized from the number of workers, the function
+	// is inlined into the range loop (no type erased call per invocation) and tmp memory is restored once per range
+	// so it suits fine grained functions, with no fabric it runs serially
+	template<typename TFunc>
+	inline static void
+	compute_chunked(Fabric f, Compute_Dims global, Compute_Dims local, TFunc&& fn)
+	{
+		Compute_Dims size{
+			global.x * local.x,
+			global.y * local.y,
+			global.z * local.z
+		};
+		_compute_chunked(f, global, size, local, std::forward<TFunc>(fn));
+	}
+
+	// local fabric overload/interface of fabric compute chunked
+	template<typename TFunc>
+	inline static void
+	compute_chunked(Compute_Dims global, Compute_Dims local, TFunc&& fn)
+	{
+		compute_chunked(fabric_local(), global, local, std::forward<TFunc>(fn));
+	}
+
+	// dispatches a compute task with the given total and local sizes like compute_sized, but using contiguous
+	// ranges of invocations like compute_chunked
+	template<typename TFunc>
+	inline static void
+	compute_sized_chunked(Fabric f, Compute_Dims total_size, Compute_Dims local, TFunc&& fn)
+	{
+		Compute_Dims global{
+			1 + ((total_size.x - 1) / local.x),
+			1 + ((total_size.y - 1) / local.y),
+			1 + ((total_size.z - 1) / local.z)
+		};
+		_compute_chunked(f, global, total_size, local, std::forward<TFunc>(fn));
+	}
+
+	// local fabric overload/interface of fabric compute sized chunked
+	template<typename TFunc>
+	inline static void
+	compute_sized_chunked(Compute_Dims total_size, Compute_Dims local, TFunc&& fn)
+	{
+		compute_sized_chunked(fabric_local(), total_size, local, std::forward<TFunc>(fn));
+	}
 }
\ No newline at end of file
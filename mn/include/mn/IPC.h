@@ -123,6 +123,10 @@ namespace mn::ipc
 	MN_EXPORT size_t
 	sputnik_write(Sputnik self, Block data);
 
+	// returns whether the given sputnik instance can be read from without blocking
+	MN_EXPORT bool
+	sputnik_can_read(Sputnik self);
+
 	// disconnects the given sputnik instance
 	MN_EXPORT bool
 	sputnik_disconnect(Sputnik self);
@@ -0,0 +1,158 @@
+#pragma once
+
+#include "mn/Memory.h"
+#include "mn/Assert.h"
+
+#include <atomic>
+#include <new>
+#include <utility>
+
+namespace mn
+{
+	// a bounded lock-free multi-producer multi-consumer ring buffer, each slot has a sequence number
+	// which tells producers and consumers whether the slot is ready for them, this is based on
+	// Dmitry Vyukov's bounded MPMC queue
+	template<typename T>
+	struct IMPMC_Ring
+	{
+		struct Cell
+		{
+			std::atomic<size_t> atomic_sequence;
+			alignas(T) unsigned char value[sizeof(T)];
+		};
+
+		Allocator allocator;
+		Cell* cells;
+		size_t mask;
+		alignas(64) std::atomic<size_t> atomic_push_index;
+		alignas(64) std::atomic<size_t> atomic_pop_index;
+	};
+	template<typename T>
+	using MPMC_Ring = IMPMC_Ring<T>*;
+
+	// creates a new mpmc ring which can hold at least the given capacity (it's rounded up to the next power of 2)
+	// the capacity is at least 2 because with a single cell the full and empty sequence numbers are the same
+	template<typename T>
+	inline static MPMC_Ring<T>
+	mpmc_ring_new(size_t capacity, Allocator allocator = allocator_top())
+	{
+		mn_assert(capacity > 0);
+		size_t cap = 2;
+		while (cap < capacity)
+			cap <<= 1;
+
+		auto self = alloc_from<IMPMC_Ring<T>>(allocator);
+		::new (self) IMPMC_Ring<T>();
+		self->allocator = allocator;
+		self->cells = (typename IMPMC_Ring<T>::Cell*)alloc_from(allocator, sizeof(typename IMPMC_Ring<T>::Cell) * cap, alignof(typename IMPMC_Ring<T>::Cell)).ptr;
+		for (size_t i = 0; i < cap; ++i)
+			::new (&self->cells[i].atomic_sequence) std::atomic<size_t>(i);
+		self->mask = cap - 1;
+		self->atomic_push_index = 0;
+		self->atomic_pop_index = 0;
+		return self;
+	}
+
+	// frees the given mpmc ring, it doesn't destruct the remaining values, pop them first if they need to be freed
+	template<typename T>
+	inline static void
+	mpmc_ring_free(MPMC_Ring<T> self)
+	{
+		auto allocator = self->allocator;
+		free_from(allocator, Block{ self->cells, sizeof(typename IMPMC_Ring<T>::Cell) * (self->mask + 1) });
+		self->~IMPMC_Ring<T>();
+		free_from(allocator, self);
+	}
+
+	// destruct overload for mpmc ring free
+	template<typename T>
+	inline static void
+	destruct(MPMC_Ring<T> self)
+	{
+		mpmc_ring_free(self);
+	}
+
+	// returns the capacity of the given mpmc ring
+	template<typename T>
+	inline static size_t
+	mpmc_ring_capacity(MPMC_Ring<T> self)
+	{
+		return self->mask + 1;
+	}
+
+	// returns an approximation of the number of values in the ring, it's only exact if no one is pushing/popping
+	template<typename T>
+	inline static size_t
+	mpmc_ring_count(MPMC_Ring<T> self)
+	{
+		auto push_index = self->atomic_push_index.load(std::memory_order_relaxed);
+		auto pop_index = self->atomic_pop_index.load(std::memory_order_relaxed);
+		return push_index > pop_index ? push_index - pop_index : 0;
+	}
+
+	// tries to push the given value into the ring, it returns false if the ring is full
+	template<typename T, typename R>
+	inline static bool
+	mpmc_ring_push_try(MPMC_Ring<T> self, R&& value)
+	{
+		typename IMPMC_Ring<T>::Cell* cell = nullptr;
+		auto index = self->atomic_push_index.load(std::memory_order_relaxed);
+		while (true)
+		{
+			cell = &self->cells[index & self->mask];
+			auto sequence = cell->atomic_sequence.load(std::memory_order_acquire);
+			auto diff = (intptr_t)sequence - (intptr_t)index;
+			if (diff == 0)
+			{
+				if (self->atomic_push_index.compare_exchange_weak(index, index + 1, std::memory_order_relaxed))
+					break;
+			}
+			else if (diff < 0)
+			{
+				return false;
+			}
+			else
+			{
+				index = self->atomic_push_index.load(std::memory_order_relaxed);
+			}
+		}
+
+		::new (cell->value) T(std::forward<R>(value));
+		cell->atomic_sequence.store(index + 1, std::memory_order_release);
+		return true;
+	}
+
+	// tries to pop a value from the ring into the given out value, it returns false if the ring is empty
+	template<typename T>
+	inline static bool
+	mpmc_ring_pop_try(MPMC_Ring<T> self, T& out)
+	{
+		typename IMPMC_Ring<T>::Cell* cell = nullptr;
+		auto index = self->atomic_pop_index.load(std::memory_order_relaxed);
+		while (true)
+		{
+			cell = &self->cells[index & self->mask];
+			auto sequence = cell->atomic_sequence.load(std::memory_order_acquire);
+			auto diff = (intptr_t)sequence - (intptr_t)(index + 1);
+			if (diff == 0)
+			{
+				if (self->atomic_pop_index.compare_exchange_weak(index, index + 1, std::memory_order_relaxed))
+					break;
+			}
+			else if (diff < 0)
+			{
+				return false;
+			}
+			else
+			{
+				index = self->atomic_pop_index.load(std::memory_order_relaxed);
+			}
+		}
+
+		auto ptr = std::launder(reinterpret_cast<T*>(cell->value));
+		out = std::move(*ptr);
+		ptr->~T();
+		cell->atomic_sequence.store(index + self->mask + 1, std::memory_order_release);
+		return true;
+	}
+}
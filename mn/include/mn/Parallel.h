@@ -0,0 +1,236 @@
+#pragma once
+
+#include "mn/Fabric.h"
+#include "mn/Buf.h"
+
+#include <algorithm>
+#include <iterator>
+#include <utility>
+
+namespace mn
+{
+	// inputs smaller than this are sorted serially because splitting them costs more than it saves
+	constexpr static size_t PARALLEL_SORT_SERIAL_THRESHOLD = 2048;
+
+	// calls fn(i) for each i in [0, count) using the given fabric, grain is the number of indices per task
+	// if it's 0 it will be picked from the number of workers
+	template<typename TFunc>
+	inline static void
+	parallel_for(Fabric f, size_t count, TFunc&& fn, size_t grain = 0)
+	{
+		_parallel_chunks_do(f, count, _parallel_chunks_count(f, count, grain), [&fn](size_t, size_t begin, size_t end) {
+			for (size_t i = begin; i < end; ++i)
+				fn(i);
+		});
+	}
+
+	// calls fn(i) for each i in [0, count) using the local fabric
+	template<typename TFunc>
+	inline static void
+	parallel_for(size_t count, TFunc&& fn, size_t grain = 0)
+	{
+		parallel_for(fabric_local(), count, std::forward<TFunc>(fn), grain);
+	}
+
+	// calls fn(value) for each value in the given buf using the given fabric
+	template<typename T, typename TFunc>
+	inline static void
+	parallel_for(Fabric f, Buf<T>& self, TFunc&& fn, size_t grain = 0)
+	{
+		parallel_for(f, self.count, [&self, &fn](size_t i) { fn(self.ptr[i]); }, grain);
+	}
+
+	// calls fn(value) for each value in the given buf using the local fabric
+	template<typename T, typename TFunc>
+	inline static void
+	parallel_for(Buf<T>& self, TFunc&& fn, size_t grain = 0)
+	{
+		parallel_for(fabric_local(), self, std::forward<TFunc>(fn), grain);
+	}
+
+	// reduces the given buf using the given associative op, the chunks are reduced in parallel and the partial
+	// results are combined in order, so op doesn't have to be commutative
+	template<typename T, typename TOp>
+	inline static T
+	parallel_reduce(Fabric f, const Buf<T>& self, T init, TOp&& op, size_t grain = 0)
+	{
+		auto chunks_count = _parallel_chunks_count(f, self.count, grain);
+		auto partials = buf_with_allocator<T>(memory::tmp());
+		buf_resize(partials, chunks_count);
+
+		_parallel_chunks_do(f, self.count, chunks_count, [&](size_t chunk, size_t begin, size_t end) {
+			T acc = self.ptr[begin];
+			for (size_t i = begin + 1; i < end; ++i)
+				acc = op(acc, self.ptr[i]);
+			partials[chunk] = acc;
+		});
+
+		T res = init;
+		for (const auto& partial: partials)
+			res = op(res, partial);
+		return res;
+	}
+
+	// reduces the given buf using the given associative op and the local fabric
+	template<typename T, typename TOp>
+	inline static T
+	parallel_reduce(const Buf<T>& self, T init, TOp&& op, size_t grain = 0)
+	{
+		return parallel_reduce(fabric_local(), self, init, std::forward<TOp>(op), grain);
+	}
+
+	// replaces each value in the given buf with op applied to all the values up to and including it (inclusive
+	// scan), each chunk is scanned in parallel, then the chunks totals are scanned, then each chunk is offset by the
+	// total of the chunks before it
+	template<typename T, typename TOp>
+	inline static void
+	parallel_scan(Fabric f, Buf<T>& self, TOp&& op, size_t grain = 0)
+	{
+		auto chunks_count = _parallel_chunks_count(f, self.count, grain);
+		auto totals = buf_with_allocator<T>(memory::tmp());
+		buf_resize(totals, chunks_count);
+
+		_parallel_chunks_do(f, self.count, chunks_count, [&](size_t chunk, size_t begin, size_t end) {
+			for (size_t i = begin + 1; i < end; ++i)
+				self.ptr[i] = op(self.ptr[i - 1], self.ptr[i]);
+			totals[chunk] = self.ptr[end - 1];
+		});
+
+		if (chunks_count < 2)
+			return;
+
+		for (size_t i = 1; i < chunks_count; ++i)
+			totals[i] = op(totals[i - 1], totals[i]);
+
+		_parallel_chunks_do(f, self.count, chunks_count, [&](size_t chunk, size_t begin, size_t end) {
+			if (chunk == 0)
+				return;
+
+			auto offset = totals[chunk - 1];
+			for (size_t i = begin; i < end; ++i)
+				self.ptr[i] = op(offset, self.ptr[i]);
+		});
+	}
+
+	// inclusive scan of the given buf using the local fabric
+	template<typename T, typename TOp>
+	inline static void
+	parallel_scan(Buf<T>& self, TOp&& op, size_t grain = 0)
+	{
+		parallel_scan(fabric_local(), self, std::forward<TOp>(op), grain);
+	}
+
+	// sorts the given buf using the given less function, it sorts a run per chunk in parallel then merges
+	// the runs in pairs in parallel until there's one run left (parallel merge sort), it's not stable
+	template<typename T, typename TLess>
+	inline static void
+	parallel_sort(Fabric f, Buf<T>& self, TLess&& less)
+	{
+		auto runs_count = _parallel_chunks_count(f, self.count, 0);
+		if (f == nullptr || runs_count < 2 || self.count < PARALLEL_SORT_SERIAL_THRESHOLD)
+		{
+			std::sort(self.ptr, self.ptr + self.count, less);
+			return;
+		}
+
+		// the run boundaries must match the merge boundaries, so all the runs have the same size except the last one
+		auto run_size = (self.count + runs_count - 1) / runs_count;
+		runs_count = (self.count + run_size - 1) / run_size;
+		parallel_for(f, runs_count, [&](size_t run) {
+			auto begin = run * run_size;
+			auto end = std::min(begin + run_size, self.count);
+			std::sort(self.ptr + begin, self.ptr + end, less);
+		}, 1);
+
+		auto tmp = buf_with_allocator<T>(memory::tmp());
+		buf_resize(tmp, self.count);
+
+		auto src = self.ptr;
+		auto dst = tmp.ptr;
+		for (size_t width = run_size; width < self.count; width *= 2)
+		{
+			auto merges_count = (self.count + 2 * width - 1) / (2 * width);
+			parallel_for(f, merges_count, [&](size_t merge) {
+				auto begin = merge * 2 * width;
+				auto mid = std::min(begin + width, self.count);
+				auto end = std::min(begin + 2 * width, self.count);
+				std::merge(
+					std::make_move_iterator(src + begin), std::make_move_iterator(src + mid),
+					std::make_move_iterator(src + mid), std::make_move_iterator(src + end),
+					dst + begin,
+					less
+				);
+			}, 1);
+			std::swap(src, dst);
+		}
+
+		if (src != self.ptr)
+			parallel_for(f, self.count, [&](size_t i) { self.ptr[i] = std::move(src[i]); });
+	}
+
+	// sorts the given buf in ascending order using the given fabric
+	template<typename T>
+	inline static void
+	parallel_sort(Fabric f, Buf<T>& self)
+	{
+		parallel_sort(f, self, [](const T& a, const T& b) { return a < b; });
+	}
+
+	// sorts the given buf using the given less function and the local fabric
+	template<typename T, typename TLess>
+	inline static void
+	parallel_sort(Buf<T>& self, TLess&& less)
+	{
+		parallel_sort(fabric_local(), self, std::forward<TLess>(less));
+	}
+
+	// sorts the given buf in ascending order using the local fabric
+	template<typename T>
+	inline static void
+	parallel_sort(Buf<T>& self)
+	{
+		parallel_sort(fabric_local(), self);
+	}
+
+	// returns a new buf with the values of the given buf which satisfy the given predicate in the same order,
+	// each chunk counts its values in parallel, then they're copied in parallel to their offsets in the result
+	// so the predicate is called twice for each value
+	template<typename T, typename TPred>
+	inline static Buf<T>
+	parallel_filter(Fabric f, const Buf<T>& self, TPred&& pred, Allocator allocator = allocator_top())
+	{
+		auto chunks_count = _parallel_chunks_count(f, self.count, 0);
+		auto offsets = buf_with_allocator<size_t>(memory::tmp());
+		buf_resize_fill(offsets, chunks_count + 1, 0);
+
+		_parallel_chunks_do(f, self.count, chunks_count, [&](size_t chunk, size_t begin, size_t end) {
+			size_t count = 0;
+			for (size_t i = begin; i < end; ++i)
+				if (pred(self.ptr[i]))
+					++count;
+			offsets[chunk + 1] = count;
+		});
+
+		for (size_t i = 1; i < offsets.count; ++i)
+			offsets[i] += offsets[i - 1];
+
+		auto res = buf_with_allocator<T>(allocator);
+		buf_resize(res, offsets[chunks_count]);
+
+		_parallel_chunks_do(f, self.count, chunks_count, [&](size_t chunk, size_t begin, size_t end) {
+			auto out = res.ptr + offsets[chunk];
+			for (size_t i = begin; i < end; ++i)
+				if (pred(self.ptr[i]))
+					*out++ = self.ptr[i];
+		});
+		return res;
+	}
+
+	// returns a new buf with the values of the given buf which satisfy the given predicate using the local fabric
+	template<typename T, typename TPred>
+	inline static Buf<T>
+	parallel_filter(const Buf<T>& self, TPred&& pred, Allocator allocator = allocator_top())
+	{
+		return parallel_filter(fabric_local(), self, std::forward<TPred>(pred), allocator);
+	}
+}
@@ -154,4 +154,13 @@ namespace mn
 	// returns the file desriptor behind the given socket
 	MN_EXPORT int64_t
 	socket_fd(Socket self);
+
+	// returns whether the given socket can be read from without blocking (data available, connection pending,
+	// closed or errored)
+	MN_EXPORT bool
+	socket_can_read(Socket self);
+
+	// returns whether the given socket can be written to without blocking
+	MN_EXPORT bool
+	socket_can_write(Socket self);
 }
@@ -5,6 +5,12 @@
 #include <utility>
 #include <functional>
 
+// size in bytes of the inline storage of a task, closures which don't fit (along with a vtable pointer) are allocated
+// out of line, it can be configured at build time using the MN_TASK_INLINE_SIZE cmake option
+#ifndef MN_TASK_INLINE_SIZE
+#define MN_TASK_INLINE_SIZE (sizeof(void*) * 7)
+#endif
+
 namespace mn
 {
 	// a task is a closure wrapper which takes care of allocation, free, and small buffer optimizations
@@ -62,7 +68,7 @@ namespace mn
 			Model(Allocator a, G&& f)
 			{
 				allocator = a;
-				fn = alloc_construct_from<F>(allocator, std::forward<F>(f));
+				fn = alloc_construct_from<F>(allocator, std::forward<G>(f));
 			}
 
 			~Model() override
@@ -76,13 +82,14 @@ namespace mn
 			}
 		};
 
-		static constexpr size_t SMALL_SIZE = sizeof(void*) * 7;
-		alignas(Concept) unsigned char concept[SMALL_SIZE];
+		static constexpr size_t SMALL_SIZE = MN_TASK_INLINE_SIZE;
+		static_assert(SMALL_SIZE >= sizeof(void*) * 2, "task inline storage should at least fit a vtable and a function pointer");
+		alignas(Concept) unsigned char concept_storage[SMALL_SIZE];
 		bool isSet;
 
 		Concept& _self()
 		{
-			return *static_cast<Concept*>(static_cast<void*>(concept));
+			return *static_cast<Concept*>(static_cast<void*>(concept_storage));
 		}
 
 		R operator()(Args... args)
@@ -108,7 +115,7 @@ namespace mn
 		{
 			constexpr bool is_small = sizeof(Model<F, true>) <= SMALL_SIZE;
 			Task<R(Args...)> self{};
-			::new (&self.concept) Model<F, is_small>(std::forward<F>(f));
+			::new (&self.concept_storage) Model<F, is_small>(std::forward<F>(f));
 			self.isSet = true;
 			return self;
 		}
@@ -120,7 +127,7 @@ namespace mn
 		{
 			constexpr bool is_small = sizeof(Model<F, true>) <= SMALL_SIZE;
 			Task<R(Args...)> self{};
-			::new (&self.concept) Model<F, is_small>(allocator, std::forward<F>(f));
+			::new (&self.concept_storage) Model<F, is_small>(allocator, std::forward<F>(f));
 			self.isSet = true;
 			return self;
 		}
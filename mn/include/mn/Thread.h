@@ -5,6 +5,7 @@
 #include "mn/OS.h"
 
 #include <stdint.h>
+#include <atomic>
 
 #define mn_mutex_new_with_srcloc(name) mn::mutex_new_with_srcloc([&](const char* func_name) -> const mn::Source_Location* { const static mn::Source_Location srcloc { name, func_name, __FILE__, __LINE__, 0 }; return &srcloc; }(__FUNCTION__))
 #define mn_mutex_rw_new_with_srcloc(name) mn::mutex_rw_new_with_srcloc([&](const char* func_name) -> const mn::Source_Location* { const static mn::Source_Location srcloc { name, func_name, __FILE__, __LINE__, 0 }; return &srcloc; }(__FUNCTION__))
@@ -124,6 +125,28 @@ namespace mn
 	MN_EXPORT void
 	thread_sleep(uint32_t milliseconds);
 
+	// yields the rest of the calling thread's time slice to the OS scheduler
+	MN_EXPORT void
+	thread_yield();
+
+	// pins the calling thread to the given cpu (the os cpu index, see Topology_CPU::id), a negative cpu unpins it
+	// so that it can run on any cpu again, it returns false if it's not supported or the cpu is invalid
+	MN_EXPORT bool
+	thread_pin_current(int32_t cpu);
+
+	// blocks the calling thread as long as the value at the given address equals the expected value, or until it times out
+	// it might return spuriously so the caller should recheck the value, it returns false only if it timed out
+	MN_EXPORT bool
+	futex_wait(std::atomic<int32_t>* address, int32_t expected, Timeout timeout = INFINITE_TIMEOUT);
+
+	// wakes a single thread blocked on the given address
+	MN_EXPORT void
+	futex_wake_one(std::atomic<int32_t>* address);
+
+	// wakes all the threads blocked on the given address
+	MN_EXPORT void
+	futex_wake_all(std::atomic<int32_t>* address);
+
 
 	// returns time in milliseonds
 	MN_EXPORT uint64_t
@@ -233,6 +256,10 @@ namespace mn
 	MN_EXPORT void
 	waitgroup_done(Waitgroup self);
 
+	// returns the current waitgroup counter
+	MN_EXPORT int
+	waitgroup_count(Waitgroup self);
+
 	// automatic waitgroup which uses RAII to manage its memory
 	// useful in case you want a quick scoped waitgroup
 	struct Auto_Waitgroup
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "mn/Exports.h"
+#include "mn/Buf.h"
+
+#include <stdint.h>
+
+namespace mn
+{
+	// a logical cpu (hardware thread) in the system
+	struct Topology_CPU
+	{
+		// os index of the cpu, it's the one thread_pin_current expects
+		int32_t id;
+		// id of the physical core, SMT siblings share the same core id
+		int32_t core_id;
+		// id of the physical package (socket)
+		int32_t package_id;
+		// id of the NUMA node, it's 0 on systems without NUMA
+		int32_t node_id;
+		// id of the group of cpus which share the last level cache
+		int32_t llc_id;
+	};
+
+	// describes the cpus of the system and how they share the cores, caches and memory
+	struct Topology
+	{
+		// online cpus sorted by their id
+		Buf<Topology_CPU> cpus;
+		size_t cores_count;
+		size_t packages_count;
+		size_t nodes_count;
+		// cache sizes in bytes as seen by the first cpu, it's 0 if the cache level doesn't exist or is unknown
+		size_t l1d_cache_size;
+		size_t l2_cache_size;
+		size_t l3_cache_size;
+		size_t cache_line_size;
+	};
+
+	// discovers the cpu topology of the system, on linux it's read from sysfs, on other systems it
+	// falls back to whatever the os reports and might assume a single package and node
+	MN_EXPORT Topology
+	topology_new();
+
+	// frees the given topology
+	inline static void
+	topology_free(Topology& self)
+	{
+		buf_free(self.cpus);
+	}
+
+	// destruct overload for topology free
+	inline static void
+	destruct(Topology& self)
+	{
+		topology_free(self);
+	}
+
+	// returns whether the two given cpus are SMT siblings (share the same physical core)
+	inline static bool
+	topology_cpu_smt_siblings(const Topology_CPU& a, const Topology_CPU& b)
+	{
+		return a.package_id == b.package_id && a.core_id == b.core_id;
+	}
+}
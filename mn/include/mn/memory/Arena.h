@@ -31,6 +31,7 @@ namespace mn::memory
 			size_t total_mem;
 			size_t used_mem;
 			size_t highwater_mem;
+			uint64_t generation;
 		};
 
 		Interface* meta;
@@ -49,6 +50,16 @@ namespace mn::memory
 		size_t clear_all_readjust_threshold;
 		size_t clear_all_current_highwater;
 		size_t clear_all_previous_highwater;
+		// blocks which were released by restore, they're reused by later allocations instead of allocating new blocks
+		Node* retained;
+		// total size in bytes of the retained blocks
+		size_t retained_mem;
+		// decaying peak of the arena's total memory which trim keeps the retained blocks under
+		size_t trim_highwater_mem;
+		// peak of the arena's total memory since the last trim
+		size_t trim_peak_mem;
+		// incremented whenever the arena is cleared so that restore can ignore the checkpoints taken before it
+		uint64_t generation;
 
 		// creates a new arena allocator with the given block size (in bytes), and the meta allocator (defaults to system malloc)
 		MN_EXPORT
@@ -82,11 +93,21 @@ namespace mn::memory
 		MN_EXPORT bool
 		owns(void* ptr) const;
 
+		// saves the current allocation state of the arena to be used in a restore later
 		MN_EXPORT State
 		checkpoint() const;
 
+		// restores the arena back to the given checkpoint, the blocks allocated after it are retained for reuse
+		// instead of being freed to the meta allocator, see trim, if the arena was cleared after the checkpoint it
+		// does nothing
 		MN_EXPORT void
 		restore(State state);
+
+		// frees the retained blocks which exceed the arena's decaying memory peak, the peak is the highest total memory
+		// since the last trim, or the previous peak minus 1/64 of it if it was higher, so an arena which is restored
+		// and trimmed regularly keeps its blocks while it's busy and gives them back gradually when it's not
+		MN_EXPORT void
+		trim();
 	};
 }
 
@@ -126,4 +147,11 @@ namespace mn
 	{
 		self->restore(state);
 	}
+
+	// frees the retained blocks of the arena which exceed its decaying memory peak
+	inline static void
+	allocator_arena_trim(memory::Arena* self)
+	{
+		self->trim();
+	}
 }
@@ -1,720 +1,4314 @@
 #include "mn/Fabric.h"
+#include "mn/MPMC_Ring.h"
+#include "mn/Topology.h"
 #include "mn/Memory.h"
 #include "mn/Pool.h"
+#include "mn/Handle_Table.h"
 #include "mn/Buf.h"
 #include "mn/Log.h"
 #include "mn/Assert.h"
+#include "mn/Context.h"
+#include "mn/Virtual_Memory.h"
+#include "mn/memory/Arena.h"
 
+#include <algorithm>
 #include <atomic>
 #include <chrono>
 #include <thread>
 
+#if MN_COMPILER_MSVC
+#include <intrin.h>
+#endif
+
+// fibers use a custom context switch which is only implemented for linux x86_64 and aarch64
+#if defined(__linux__) && (defined(__x86_64__) || defined(__aarch64__))
+	#define MN_FIBERS_SUPPORTED 1
+#else
+	#define MN_FIBERS_SUPPORTED 0
+#endif
+
+// sanitizers should be told about the stack switches otherwise they report false positives
+#if defined(__SANITIZE_THREAD__)
+	#define MN_FIBERS_TSAN 1
+#elif defined(__has_feature)
+	#if __has_feature(thread_sanitizer)
+		#define MN_FIBERS_TSAN 1
+	#endif
+#endif
+
+#if defined(__SANITIZE_ADDRESS__)
+	#define MN_FIBERS_ASAN 1
+#elif defined(__has_feature)
+	#if __has_feature(address_sanitizer)
+		#define MN_FIBERS_ASAN 1
+	#endif
+#endif
+
+#if MN_FIBERS_TSAN
+#include <sanitizer/tsan_interface.h>
+#endif
+
+#if MN_FIBERS_ASAN
+#include <sanitizer/common_interface_defs.h>
+#endif
+
+#if MN_FIBERS_SUPPORTED
+// saves the callee-saved registers on the current stack and stores the stack pointer into save_sp
+// then loads the stack pointer from load_sp and restores the callee-saved registers of the other stack
+extern "C" void mn_fiber_switch(void** save_sp, void* load_sp);
+
+#if defined(__x86_64__)
+asm(R"(
+	.text
+	.globl mn_fiber_switch
+	.hidden mn_fiber_switch
+	.type mn_fiber_switch,@function
+	.p2align 4
+mn_fiber_switch:
+	pushq %rbp
+	pushq %rbx
+	pushq %r12
+	pushq %r13
+	pushq %r14
+	pushq %r15
+	subq $8, %rsp
+	stmxcsr (%rsp)
+	fnstcw 4(%rsp)
+	movq %rsp, (%rdi)
+	movq %rsi, %rsp
+	ldmxcsr (%rsp)
+	fldcw 4(%rsp)
+	addq $8, %rsp
+	popq %r15
+	popq %r14
+	popq %r13
+	popq %r12
+	popq %rbx
+	popq %rbp
+	ret
+	.size mn_fiber_switch,.-mn_fiber_switch
+)");
+#elif defined(__aarch64__)
+asm(R"(
+	.text
+	.globl mn_fiber_switch
+	.hidden mn_fiber_switch
+	.type mn_fiber_switch,%function
+	.p2align 2
+mn_fiber_switch:
+	sub sp, sp, #176
+	stp x19, x20, [sp, #0]
+	stp x21, x22, [sp, #16]
+	stp x23, x24, [sp, #32]
+	stp x25, x26, [sp, #48]
+	stp x27, x28, [sp, #64]
+	stp x29, x30, [sp, #80]
+	stp d8, d9, [sp, #96]
+	stp d10, d11, [sp, #112]
+	stp d12, d13, [sp, #128]
+	stp d14, d15, [sp, #144]
+	mov x9, sp
+	str x9, [x0]
+	mov sp, x1
+	ldp x19, x20, [sp, #0]
+	ldp x21, x22, [sp, #16]
+	ldp x23, x24, [sp, #32]
+	ldp x25, x26, [sp, #48]
+	ldp x27, x28, [sp, #64]
+	ldp x29, x30, [sp, #80]
+	ldp d8, d9, [sp, #96]
+	ldp d10, d11, [sp, #112]
+	ldp d12, d13, [sp, #128]
+	ldp d14, d15, [sp, #144]
+	add sp, sp, #176
+	ret
+	.size mn_fiber_switch,.-mn_fiber_switch
+)");
+#endif
+#endif
+
 namespace mn
 {
 	constexpr static auto DEFAULT_COOP_BLOCKING_THRESHOLD = 10;
 	constexpr static auto DEFAULT_EXTR_BLOCKING_THRESHOLD = 1000;
-
-	// Worker
-	struct IWorker
-	{
-		enum STATE
-		{
-			STATE_RUNNING,
-			STATE_PAUSED,
-			STATE_STOP_REQUEST,
-			STATE_STOP_ACKNOWLEDGED
-		};
-
-		Str name;
-		Mutex mtx;
-		Cond_Var cv;
-		Fabric fabric;
-		Ring<Fabric_Task> job_q;
-		Thread thread;
-		std::atomic<FABRIC_TASK_FLAGS> atomic_current_job_flags;
-		std::atomic<uint64_t> atomic_job_start_time_in_ms;
-		std::atomic<uint64_t> atomic_block_start_time_in_ms;
-		std::atomic<STATE> atomic_state;
-		std::atomic<bool> atomic_disable_block_timing;
+	constexpr static size_t DEFAULT_MAX_THREADS_PER_WORKER = 4;
+	constexpr static uint32_t DEFAULT_WORKER_IDLE_TIMEOUT_IN_MS = 10000;
+	// how long the tasks can wait behind the busy workers before sysmon grows the workers count of an elastic fabric
+	constexpr static uint64_t WORKERS_GROW_QUEUE_WAIT_IN_MS = 2;
+	constexpr static size_t DEFAULT_INJECTION_QUEUE_CAPACITY = 4096;
+	constexpr static size_t INJECTION_QUEUE_GRAB_COUNT = 32;
+	constexpr static size_t CACHE_LINE_SIZE = 64;
+	constexpr static int64_t TASK_DEQUE_INITIAL_CAPACITY = 64;
+	constexpr static uint32_t DEFAULT_IDLE_SPIN_COUNT = 256;
+	constexpr static uint32_t DEFAULT_IDLE_YIELD_COUNT = 16;
+	constexpr static size_t DEFAULT_FIBER_STACK_SIZE = 256ULL * 1024ULL;
+	constexpr static size_t FIBER_POOL_CAPACITY = 32;
+	constexpr static uint64_t FIBER_POLL_INTERVAL_IN_MS = 1;
+	// how many jobs the overload policy can run inline on top of each other before it queues them instead, the tasks
+	// which keep submitting would otherwise recurse without a bound (on the small fiber stacks too)
+	constexpr static uint32_t MAX_INLINE_JOBS_DEPTH = 8;
+	// how many tasks the job_q of a worker can hold before it grows, it's only reserved up front for numa local memory
+	constexpr static size_t NUMA_LOCAL_JOB_Q_CAPACITY = 256;
+	// every NORMAL_PRIORITY_TURN schedule ticks the normal priority tasks get the first pick, and every
+	// BACKGROUND_PRIORITY_TURN ticks the background tasks do, this way higher priority tasks can't starve them
+	constexpr static uint64_t NORMAL_PRIORITY_TURN = 8;
+	constexpr static uint64_t BACKGROUND_PRIORITY_TURN = 32;
+	// the timer wheel has 4 levels of 256 slots each with a 1 ms tick, which covers ~49 days
+	constexpr static size_t TIMER_WHEEL_LEVELS = 4;
+	constexpr static size_t TIMER_WHEEL_SLOT_BITS = 8;
+	constexpr static size_t TIMER_WHEEL_SLOTS_COUNT = size_t(1) << TIMER_WHEEL_SLOT_BITS;
+	constexpr static uint64_t TIMER_WHEEL_SLOT_MASK = TIMER_WHEEL_SLOTS_COUNT - 1;
+	constexpr static uint64_t TIMER_WHEEL_MAX_DELTA = (uint64_t(1) << (TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOT_BITS)) - 1;
+	constexpr static size_t TIMER_POOL_BUCKET_SIZE = 1024;
+	// marks the continuations list of a completed future, continuations which are added after that run right away
+	static Future_Continuation* const FUTURE_CONTINUATIONS_CLOSED = (Future_Continuation*)uintptr_t(1);
+	constexpr static FABRIC_TASK_PRIORITY PRIORITY_ORDER_HIGH_FIRST[FABRIC_TASK_PRIORITY_COUNT] = {
+		FABRIC_TASK_PRIORITY_HIGH, FABRIC_TASK_PRIORITY_NORMAL, FABRIC_TASK_PRIORITY_BACKGROUND
+	};
+	constexpr static FABRIC_TASK_PRIORITY PRIORITY_ORDER_NORMAL_FIRST[FABRIC_TASK_PRIORITY_COUNT] = {
+		FABRIC_TASK_PRIORITY_NORMAL, FABRIC_TASK_PRIORITY_HIGH, FABRIC_TASK_PRIORITY_BACKGROUND
+	};
+	constexpr static FABRIC_TASK_PRIORITY PRIORITY_ORDER_BACKGROUND_FIRST[FABRIC_TASK_PRIORITY_COUNT] = {
+		FABRIC_TASK_PRIORITY_BACKGROUND, FABRIC_TASK_PRIORITY_HIGH, FABRIC_TASK_PRIORITY_NORMAL
 	};
-	thread_local Worker LOCAL_WORKER = nullptr;
 
-	struct IFabric
+	// a hint to the cpu that we're in a spin loop
+	inline static void
+	_cpu_pause()
 	{
-		Fabric_Settings settings;
-		Str name;
-		Str sysmon_name;
+	#if MN_COMPILER_MSVC && ARCH_X86
+		_mm_pause();
+	#elif MN_COMPILER_MSVC && ARCH_ARM
+		__yield();
+	#elif ARCH_X86
+		__builtin_ia32_pause();
+	#elif ARCH_ARM || defined(__aarch64__)
+		__asm__ __volatile__("yield");
+	#endif
+	}
 
-		Buf<Worker> workers;
-		Buf<Worker> sleepy_side_workers;
-		Buf<Worker> ready_side_workers;
+	// returns the index of the lowest set bit in the given non-zero value
+	inline static size_t
+	_lowest_set_bit(uint64_t value)
+	{
+	#if MN_COMPILER_MSVC
+		unsigned long index = 0;
+		_BitScanForward64(&index, value);
+		return index;
+	#else
+		return __builtin_ctzll(value);
+	#endif
+	}
 
-		Mutex mtx;
-		Cond_Var cv;
-		bool is_running;
-		std::atomic<size_t> atomic_available_jobs;
-		size_t next_worker;
-		size_t worker_id_generator;
+	// returns the index of the highest set bit in the given non-zero value
+	inline static size_t
+	_highest_set_bit(uint64_t value)
+	{
+	#if MN_COMPILER_MSVC
+		unsigned long index = 0;
+		_BitScanReverse64(&index, value);
+		return index;
+	#else
+		return 63 - __builtin_clzll(value);
+	#endif
+	}
 
-		Thread sysmon;
+	// Task Deque
+	// Chase-Lev work stealing deque, the owner worker pushes and pops at the bottom while
+	// other workers steal from the top, based on "Dynamic Circular Work-Stealing Deque"
+	struct Task_Deque_Buffer
+	{
+		int64_t cap;
+		std::atomic<Fabric_Task*>* ptr;
 	};
 
-	static void
-	_worker_main(void* worker)
+	struct Task_Deque
 	{
-		auto self = (Worker)worker;
-		LOCAL_WORKER = self;
-
-		if (self->fabric)
-			if (self->fabric->settings.on_worker_start)
-				self->fabric->settings.on_worker_start();
-
-		while(true)
-		{
-			auto state = self->atomic_state.load();
-			if (state == IWorker::STATE_RUNNING)
-			{
-				Fabric_Task job{};
-				{
-					mutex_lock(self->mtx);
-					mn_defer(mutex_unlock(self->mtx));
-
-					if (self->job_q.count == 0)
-					{
-						cond_var_wait(self->cv, self->mtx, [&]{
-							return self->job_q.count > 0 ||
-								self->atomic_state.load() != IWorker::STATE_RUNNING;
-						});
-						state = self->atomic_state.load();
-					}
-
-					if (state != IWorker::STATE_RUNNING)
-						continue;
-
-					job = ring_front(self->job_q);
-					ring_pop_front(self->job_q);
-				}
-
-				if (job.task)
-				{
-					self->atomic_job_start_time_in_ms.store(time_in_millis());
-					self->atomic_disable_block_timing = false;
-					self->atomic_current_job_flags.store(job.flags);
-					job.task();
-					self->atomic_disable_block_timing = true;
-					self->atomic_job_start_time_in_ms.store(0);
-					self->atomic_current_job_flags.store(FABRIC_TASK_FLAG_NONE);
-					fabric_task_free(job);
-					memory::tmp()->clear_all();
-					if (self->fabric)
-					{
-						if (self->fabric->settings.after_each_job)
-							self->fabric->settings.after_each_job();
-						self->fabric->atomic_available_jobs.fetch_sub(1);
-					}
-				}
-			}
-			else if (state == IWorker::STATE_PAUSED)
-			{
-				mutex_lock(self->mtx);
-				mn_defer(mutex_unlock(self->mtx));
-
-				if (self->atomic_state.load() == IWorker::STATE_PAUSED)
-				{
-					cond_var_wait(self->cv, self->mtx, [&]{
-						return self->atomic_state.load() != IWorker::STATE_PAUSED;
-					});
-				}
-			}
-			else if (state == IWorker::STATE_STOP_REQUEST)
-			{
-				break;
-			}
-			else
-			{
-				mn_unreachable();
-			}
-		}
+		alignas(CACHE_LINE_SIZE) std::atomic<int64_t> atomic_top;
+		alignas(CACHE_LINE_SIZE) std::atomic<int64_t> atomic_bottom;
+		std::atomic<Task_Deque_Buffer*> atomic_buffer;
+		// old buffers are kept alive until the deque is freed because thieves might still be reading them
+		Buf<Task_Deque_Buffer*> retired_buffers;
+	};
 
-		[[maybe_unused]] auto old_state = self->atomic_state.exchange(IWorker::STATE_STOP_ACKNOWLEDGED);
-		mn_assert(old_state == IWorker::STATE_STOP_REQUEST);
-		LOCAL_WORKER = nullptr;
+	inline static Task_Deque_Buffer*
+	_task_deque_buffer_new(int64_t cap)
+	{
+		auto self = alloc_from<Task_Deque_Buffer>(memory::clib());
+		self->cap = cap;
+		self->ptr = (std::atomic<Fabric_Task*>*)alloc_from(memory::clib(), sizeof(std::atomic<Fabric_Task*>) * cap, alignof(std::atomic<Fabric_Task*>)).ptr;
+		for (int64_t i = 0; i < cap; ++i)
+			::new (self->ptr + i) std::atomic<Fabric_Task*>(nullptr);
+		return self;
 	}
 
 	inline static void
-	_worker_stop(Worker self)
+	_task_deque_buffer_free(Task_Deque_Buffer* self)
 	{
-		mutex_lock(self->mtx);
-		mn_defer(mutex_unlock(self->mtx));
-
-		self->atomic_state = IWorker::STATE_STOP_REQUEST;
-		cond_var_notify(self->cv);
+		free_from(memory::clib(), Block{ self->ptr, sizeof(std::atomic<Fabric_Task*>) * self->cap });
+		free_from(memory::clib(), self);
 	}
 
 	inline static void
-	_worker_pause(Worker self)
+	_task_deque_init(Task_Deque& self)
 	{
-		mutex_lock(self->mtx);
-		mn_defer(mutex_unlock(self->mtx));
-
-		mn_assert(self->atomic_state == IWorker::STATE_RUNNING);
-
-		self->atomic_state = IWorker::STATE_PAUSED;
-		cond_var_notify(self->cv);
+		self.atomic_top = 0;
+		self.atomic_bottom = 0;
+		self.atomic_buffer = _task_deque_buffer_new(TASK_DEQUE_INITIAL_CAPACITY);
+		self.retired_buffers = buf_with_allocator<Task_Deque_Buffer*>(memory::clib());
 	}
 
 	inline static void
-	_worker_resume(Worker self)
+	_task_deque_free(Task_Deque& self)
 	{
-		mutex_lock(self->mtx);
-		mn_defer(mutex_unlock(self->mtx));
-
-		mn_assert(self->atomic_state == IWorker::STATE_PAUSED);
-
-		self->atomic_state = IWorker::STATE_RUNNING;
-		cond_var_notify(self->cv);
+		_task_deque_buffer_free(self.atomic_buffer.load());
+		for (auto buffer: self.retired_buffers)
+			_task_deque_buffer_free(buffer);
+		buf_free(self.retired_buffers);
 	}
 
-	inline static Worker
-	_worker_new(Str name, Fabric fabric, Ring<Fabric_Task> stolen_jobs = ring_new<Fabric_Task>())
+	// moves the deque's tasks to a new buffer with the given capacity and returns it, the new buffer is allocated
+	// by the calling thread so it's also used to move the buffer to the owner's numa node, only the owner worker is
+	// allowed to call this function
+	inline static Task_Deque_Buffer*
+	_task_deque_rebuffer(Task_Deque& self, int64_t cap)
 	{
-		auto self = alloc_zerod<IWorker>();
-		self->name = name;
-		self->mtx = mn_mutex_new_with_srcloc(self->name.ptr);
-		self->cv = cond_var_new();
-		self->fabric = fabric;
-		self->job_q = stolen_jobs;
-		self->atomic_state = IWorker::STATE_RUNNING;
-		self->atomic_disable_block_timing = true;
-		self->thread = thread_new(_worker_main, self, self->name.ptr);
-		return self;
+		auto b = self.atomic_bottom.load(std::memory_order_relaxed);
+		auto t = self.atomic_top.load(std::memory_order_acquire);
+		auto buffer = self.atomic_buffer.load(std::memory_order_relaxed);
+
+		auto new_buffer = _task_deque_buffer_new(cap);
+		for (auto i = t; i < b; ++i)
+			new_buffer->ptr[i % new_buffer->cap].store(buffer->ptr[i % buffer->cap].load(std::memory_order_relaxed), std::memory_order_relaxed);
+		buf_push(self.retired_buffers, buffer);
+		self.atomic_buffer.store(new_buffer, std::memory_order_release);
+		return new_buffer;
 	}
 
+	// pushes a task to the bottom of the deque, only the owner worker is allowed to call this function
 	inline static void
-	_worker_free(Worker self)
+	_task_deque_push(Task_Deque& self, Fabric_Task* task)
 	{
-		[[maybe_unused]] auto state = self->atomic_state.load();
-		mn_assert(state == IWorker::STATE_STOP_REQUEST ||
-			   state == IWorker::STATE_STOP_ACKNOWLEDGED);
+		auto b = self.atomic_bottom.load(std::memory_order_relaxed);
+		auto t = self.atomic_top.load(std::memory_order_acquire);
+		auto buffer = self.atomic_buffer.load(std::memory_order_relaxed);
 
-		thread_join(self->thread);
-		thread_free(self->thread);
-
-		str_free(self->name);
-		mutex_free(self->mtx);
-		cond_var_free(self->cv);
-		destruct(self->job_q);
+		if (b - t > buffer->cap - 1)
+			buffer = _task_deque_rebuffer(self, buffer->cap * 2);
 
-		free(self);
+		buffer->ptr[b % buffer->cap].store(task, std::memory_order_relaxed);
+		self.atomic_bottom.store(b + 1, std::memory_order_release);
 	}
 
-	// Fabric
-	struct Blocking_Worker
+	// pops a task from the bottom of the deque, only the owner worker is allowed to call this function
+	inline static Fabric_Task*
+	_task_deque_pop(Task_Deque& self)
 	{
-		Worker worker;
-		size_t index;
-	};
+		auto b = self.atomic_bottom.load(std::memory_order_relaxed) - 1;
+		auto buffer = self.atomic_buffer.load(std::memory_order_relaxed);
+		self.atomic_bottom.store(b, std::memory_order_seq_cst);
+		auto t = self.atomic_top.load(std::memory_order_seq_cst);
 
-	inline static void
-	_sysmon_detect_blocking_workers(Fabric self, Buf<Blocking_Worker>& blocking_workers)
-	{
-		// detect blocking workers
-		for (size_t i = 0; i < self->workers.count; ++i)
+		Fabric_Task* res = nullptr;
+		if (t <= b)
 		{
-			auto current_job_flags = self->workers[i]->atomic_current_job_flags.load();
-			auto block_start_time = self->workers[i]->atomic_block_start_time_in_ms.load();
-			if(block_start_time != 0 && current_job_flags == FABRIC_TASK_FLAG_NONE)
+			res = buffer->ptr[b % buffer->cap].load(std::memory_order_relaxed);
+			if (t == b)
 			{
-				auto block_time = time_in_millis() - block_start_time;
-				if(block_time > self->settings.coop_blocking_threshold_in_ms)
-				{
-					buf_push(blocking_workers, Blocking_Worker{ self->workers[i], i });
-				}
+				// last element in the deque, race against the thieves for it
+				if (self.atomic_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed) == false)
+					res = nullptr;
+				self.atomic_bottom.store(b + 1, std::memory_order_relaxed);
 			}
 		}
+		else
+		{
+			self.atomic_bottom.store(b + 1, std::memory_order_relaxed);
+		}
+		return res;
+	}
 
-		// if we have some free workers then it's okay, ignore it this is normal
-		// we only care about total system blocking
-		if (blocking_workers.count < self->workers.count * self->settings.blocking_workers_threshold)
-			buf_clear(blocking_workers);
-
-		// pause all the blocking workers
-		for (auto blocking_worker: blocking_workers)
-			_worker_pause(blocking_worker.worker);
+	// steals a task from the top of the deque, it returns nullptr if the deque is empty or if it lost the race to another thief
+	inline static Fabric_Task*
+	_task_deque_steal(Task_Deque& self)
+	{
+		auto t = self.atomic_top.load(std::memory_order_seq_cst);
+		auto b = self.atomic_bottom.load(std::memory_order_seq_cst);
 
-		// move the blocking workers out
-		for (auto blocking_worker: blocking_workers)
+		if (t < b)
 		{
-			Ring<Fabric_Task> job_q{};
-			{
-				mutex_lock(blocking_worker.worker->mtx);
-				mn_defer(mutex_unlock(blocking_worker.worker->mtx));
+			auto buffer = self.atomic_buffer.load(std::memory_order_acquire);
+			auto res = buffer->ptr[t % buffer->cap].load(std::memory_order_relaxed);
+			if (self.atomic_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed) == false)
+				return nullptr;
+			return res;
+		}
+		return nullptr;
+	}
 
-				job_q = blocking_worker.worker->job_q;
-				blocking_worker.worker->job_q = ring_new<Fabric_Task>();
-			}
+	// returns an approximation of the number of tasks in the deque
+	inline static size_t
+	_task_deque_count(const Task_Deque& self)
+	{
+		auto b = self.atomic_bottom.load(std::memory_order_relaxed);
+		auto t = self.atomic_top.load(std::memory_order_relaxed);
+		return b > t ? size_t(b - t) : 0;
+	}
 
-			{
-				mutex_lock(self->mtx);
-				mn_defer(mutex_unlock(self->mtx));
+	// Task Pool
+	// the task pool serves the fabric task nodes and the out of line task closures, each thread has its own cache of
+	// size classed blocks which it carves out of slabs, a block which is freed by another thread is pushed to its
+	// owner's remote free list (lock-free) and the owner takes the whole list back once its own free list runs out,
+	// the caches are never freed, when a thread exits its cache is adopted by the next thread which needs one
+	constexpr static size_t TASK_POOL_MIN_BLOCK_SIZE = 64;
+	// the blocks are 64, 128, 256, 512, and 1024 bytes including their headers
+	constexpr static size_t TASK_POOL_CLASSES_COUNT = 5;
+	constexpr static size_t TASK_POOL_SLAB_SIZE = 64ULL * 1024ULL;
+	constexpr static size_t TASK_POOL_ALIGNMENT = 16;
+
+	struct Task_Pool_Cache;
+
+	// each block starts with a header and the allocated memory follows it
+	struct alignas(TASK_POOL_ALIGNMENT) Task_Pool_Header
+	{
+		// it's nullptr for the blocks which are allocated from clib because they're too big or over aligned
+		Task_Pool_Cache* owner;
+		Task_Pool_Header* next;
+		// the size class of the pooled blocks, or the total allocated size of the clib blocks
+		size_t size;
+		// the pointer which was allocated from clib
+		void* base;
+	};
 
-				// find a suitable worker
-				if (self->ready_side_workers.count > 0)
-				{
-					auto new_worker = buf_top(self->ready_side_workers);
-					buf_pop(self->ready_side_workers);
+	struct Task_Pool_Cache
+	{
+		Task_Pool_Header* free_list[TASK_POOL_CLASSES_COUNT];
+		// the rest of the current slab which the blocks are carved from
+		char* slab_head;
+		char* slab_end;
+		alignas(CACHE_LINE_SIZE) std::atomic<Task_Pool_Header*> remote_free[TASK_POOL_CLASSES_COUNT];
+		alignas(CACHE_LINE_SIZE) std::atomic<bool> atomic_in_use;
+		Task_Pool_Cache* next;
+	};
 
-					self->workers[blocking_worker.index] = new_worker;
-					ring_free(new_worker->job_q);
-					new_worker->job_q = job_q;
+	static std::atomic<Task_Pool_Cache*> TASK_POOL_CACHES;
 
-					_worker_resume(new_worker);
-				}
-				else
-				{
-					auto new_worker = _worker_new(
-						strf("{} worker #{}", self->name, self->worker_id_generator++),
-						self,
-						job_q
-					);
+	struct Task_Pool_Thread
+	{
+		Task_Pool_Cache* cache;
 
-					self->workers[blocking_worker.index] = new_worker;
-				}
-			}
+		~Task_Pool_Thread()
+		{
+			// the blocks which are freed by this thread from now on go through the remote free list
+			if (cache)
+				cache->atomic_in_use.store(false, std::memory_order_release);
+			cache = nullptr;
 		}
+	};
 
-		// now that we have replaced all the blocking workers with a newly created workers
-		// we need to store the blocking workers away to be reused later in the replacement above
-		for (auto blocking_worker: blocking_workers)
-			buf_push(self->sleepy_side_workers, blocking_worker.worker);
-
-		// clear the blocking workers list
-		buf_clear(blocking_workers);
-	}
+	thread_local Task_Pool_Thread TASK_POOL_THREAD;
 
-	inline static void
-	_sysmon_detect_long_running_workers(Fabric self, Buf<Blocking_Worker>& blocking_workers)
+	inline static Task_Pool_Cache*
+	_task_pool_cache()
 	{
-		// detect blocking workers
-		for (size_t i = 0; i < self->workers.count; ++i)
+		auto& thread = TASK_POOL_THREAD;
+		if (thread.cache)
+			return thread.cache;
+
+		for (auto it = TASK_POOL_CACHES.load(std::memory_order_acquire); it != nullptr; it = it->next)
 		{
-			auto current_job_flags = self->workers[i]->atomic_current_job_flags.load();
-			auto job_start_time = self->workers[i]->atomic_job_start_time_in_ms.load();
-			if (job_start_time != 0 && current_job_flags == FABRIC_TASK_FLAG_NONE)
+			bool in_use = false;
+			if (it->atomic_in_use.load(std::memory_order_relaxed) == false &&
+				it->atomic_in_use.compare_exchange_strong(in_use, true, std::memory_order_acq_rel))
 			{
-				auto job_run_time = time_in_millis() - job_start_time;
-				if(job_run_time > self->settings.external_blocking_threshold_in_ms)
-				{
-					buf_push(blocking_workers, Blocking_Worker{ self->workers[i], i });
-				}
+				thread.cache = it;
+				return it;
 			}
 		}
 
-		// pause all the blocking workers
-		for (auto blocking_worker: blocking_workers)
-			_worker_pause(blocking_worker.worker);
+		auto cache = alloc_zerod_from<Task_Pool_Cache>(memory::clib());
+		cache->atomic_in_use.store(true, std::memory_order_relaxed);
+		cache->next = TASK_POOL_CACHES.load(std::memory_order_relaxed);
+		while (TASK_POOL_CACHES.compare_exchange_weak(cache->next, cache, std::memory_order_release, std::memory_order_relaxed) == false)
+		{}
+		thread.cache = cache;
+		return cache;
+	}
 
-		// move the blocking workers out
-		for (auto blocking_worker: blocking_workers)
+	struct Task_Pool_Allocator final: memory::Interface
+	{
+		Block
+		alloc(size_t size, uint8_t alignment) override
 		{
-			Ring<Fabric_Task> job_q{};
+			auto total_size = size + sizeof(Task_Pool_Header);
+			if (alignment <= TASK_POOL_ALIGNMENT && total_size <= (TASK_POOL_MIN_BLOCK_SIZE << (TASK_POOL_CLASSES_COUNT - 1)))
 			{
-				mutex_lock(blocking_worker.worker->mtx);
-				mn_defer(mutex_unlock(blocking_worker.worker->mtx));
-
-				job_q = blocking_worker.worker->job_q;
-				blocking_worker.worker->job_q = ring_new<Fabric_Task>();
-			}
+				size_t size_class = 0;
+				while ((TASK_POOL_MIN_BLOCK_SIZE << size_class) < total_size)
+					++size_class;
 
-			{
-				mutex_lock(self->mtx);
-				mn_defer(mutex_unlock(self->mtx));
+				auto cache = _task_pool_cache();
+				auto header = cache->free_list[size_class];
+				if (header == nullptr)
+					header = cache->remote_free[size_class].exchange(nullptr, std::memory_order_acquire);
 
-				// find a suitable worker
-				if (self->ready_side_workers.count > 0)
+				if (header)
 				{
-					auto new_worker = buf_top(self->ready_side_workers);
-					buf_pop(self->ready_side_workers);
-
-					self->workers[blocking_worker.index] = new_worker;
-					ring_free(new_worker->job_q);
-					new_worker->job_q = job_q;
-
-					_worker_resume(new_worker);
+					cache->free_list[size_class] = header->next;
 				}
 				else
 				{
-					auto new_worker = _worker_new(
-						strf("{} worker #{}", self->name, self->worker_id_generator++),
-						self,
-						job_q
-					);
-
-					self->workers[blocking_worker.index] = new_worker;
+					auto block_size = TASK_POOL_MIN_BLOCK_SIZE << size_class;
+					if (size_t(cache->slab_end - cache->slab_head) < block_size)
+					{
+						// the rest of the old slab is wasted, it's less than the biggest block
+						auto slab = memory::clib()->alloc(TASK_POOL_SLAB_SIZE, TASK_POOL_ALIGNMENT);
+						cache->slab_head = (char*)slab.ptr;
+						cache->slab_end = cache->slab_head + slab.size;
+					}
+					header = (Task_Pool_Header*)cache->slab_head;
+					cache->slab_head += block_size;
 				}
+
+				header->owner = cache;
+				header->next = nullptr;
+				header->size = size_class;
+				header->base = header;
+				return Block{header + 1, size};
 			}
+
+			if (alignment < TASK_POOL_ALIGNMENT)
+				alignment = TASK_POOL_ALIGNMENT;
+			total_size += alignment;
+			auto base = memory::clib()->alloc(total_size, TASK_POOL_ALIGNMENT).ptr;
+			auto ptr = ((uintptr_t)base + sizeof(Task_Pool_Header) + alignment - 1) & ~uintptr_t(alignment - 1);
+			auto header = (Task_Pool_Header*)ptr - 1;
+			header->owner = nullptr;
+			header->next = nullptr;
+			header->size = total_size;
+			header->base = base;
+			return Block{(void*)ptr, size};
 		}
 
-		// now that we have replaced all the blocking workers with a newly created workers
-		// we need to store the blocking workers away to be reused later in the replacement above
-		for (auto blocking_worker: blocking_workers)
-			buf_push(self->sleepy_side_workers, blocking_worker.worker);
+		void
+		free(Block block) override
+		{
+			if (block.ptr == nullptr)
+				return;
 
-		// clear the blocking workers list
-		buf_clear(blocking_workers);
-	}
+			auto header = (Task_Pool_Header*)block.ptr - 1;
+			auto owner = header->owner;
+			if (owner == nullptr)
+			{
+				memory::clib()->free(Block{header->base, header->size});
+			}
+			else if (owner == TASK_POOL_THREAD.cache)
+			{
+				header->next = owner->free_list[header->size];
+				owner->free_list[header->size] = header;
+			}
+			else
+			{
+				auto& remote_free = owner->remote_free[header->size];
+				header->next = remote_free.load(std::memory_order_relaxed);
+				while (remote_free.compare_exchange_weak(header->next, header, std::memory_order_release, std::memory_order_relaxed) == false)
+				{}
+			}
+		}
+	};
 
-	static void
-	_sysmon_main(void* fabric)
+	// fabric tasks are heap allocated so that they can be published to the work stealing deques as a single pointer
+	struct Fabric_Task_Node
 	{
-		_disable_profiling_for_this_thread();
+		// it's the first member so that the node and its task share the same address
+		Fabric_Task task;
+		// when the task was submitted to the fabric, it's only set if the timing stats are enabled
+		uint64_t submit_time_in_us;
+	};
 
-		auto self = (Fabric)fabric;
+	inline static Fabric_Task*
+	_fabric_task_node_new(const Fabric_Task& task)
+	{
+		auto self = alloc_from<Fabric_Task_Node>(fabric_task_allocator());
+		::new (&self->task) Fabric_Task(task);
+		self->submit_time_in_us = 0;
+		return &self->task;
+	}
 
-		// workers who exceeded the coop blocking threshold
-		auto blocking_workers = buf_with_capacity<Blocking_Worker>(self->workers.count);
-		mn_defer(buf_free(blocking_workers));
+	inline static void
+	_fabric_task_node_free(Fabric_Task* self)
+	{
+		fabric_task_free(*self);
+		free_from(fabric_task_allocator(), (Fabric_Task_Node*)self);
+	}
 
-		// workers who exceeded the external blocking threshold
-		auto long_running_workers = buf_with_capacity<Blocking_Worker>(self->workers.count);
-		mn_defer(buf_free(long_running_workers));
+	inline static uint64_t&
+	_fabric_task_node_submit_time(Fabric_Task* self)
+	{
+		return ((Fabric_Task_Node*)self)->submit_time_in_us;
+	}
 
-		auto dead_workers = buf_with_capacity<Worker>(self->workers.count);
-		mn_defer(destruct(dead_workers));
+	// Stats
+	// worker stats are only written by the worker's own thread so they're updated with a relaxed load and store instead of
+	// an atomic read-modify-write, and they're on their own cache lines so that sampling them doesn't slow the worker down
+	struct alignas(CACHE_LINE_SIZE) Worker_Stats
+	{
+		std::atomic<uint64_t> tasks_executed;
+		std::atomic<uint64_t> steals;
+		std::atomic<uint64_t> parks;
+		std::atomic<uint64_t> unparks;
+		std::atomic<uint64_t> queue_wait_histogram[FABRIC_STATS_HISTOGRAM_BUCKETS_COUNT];
+		std::atomic<uint64_t> run_time_histogram[FABRIC_STATS_HISTOGRAM_BUCKETS_COUNT];
+	};
 
-		auto tmp_jobs = buf_new<Fabric_Task>();
-		mn_defer(destruct(tmp_jobs));
+	inline static void
+	_stats_inc(std::atomic<uint64_t>& counter)
+	{
+		counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	}
 
-		auto timeslice = self->settings.coop_blocking_threshold_in_ms;
-		if (timeslice > self->settings.external_blocking_threshold_in_ms)
-			timeslice = self->settings.external_blocking_threshold_in_ms;
+	inline static uint64_t
+	_stats_now_in_us()
+	{
+		auto tp = std::chrono::steady_clock::now().time_since_epoch();
+		return std::chrono::duration_cast<std::chrono::microseconds>(tp).count();
+	}
 
-		timeslice /= 2;
-		if (timeslice == 0)
-			timeslice = 1;
+	inline static void
+	_stats_histogram_add(std::atomic<uint64_t>* histogram, uint64_t time_in_us)
+	{
+		size_t bucket = 0;
+		if (time_in_us > 0)
+			bucket = _highest_set_bit(time_in_us) + 1;
+		if (bucket >= FABRIC_STATS_HISTOGRAM_BUCKETS_COUNT)
+			bucket = FABRIC_STATS_HISTOGRAM_BUCKETS_COUNT - 1;
+		_stats_inc(histogram[bucket]);
+	}
 
-		while(true)
+	// adds the given worker's counters to the result
+	inline static void
+	_stats_accumulate(Fabric_Worker_Stats& res, const Worker_Stats& stats)
+	{
+		res.tasks_executed += stats.tasks_executed.load(std::memory_order_relaxed);
+		res.steals += stats.steals.load(std::memory_order_relaxed);
+		res.parks += stats.parks.load(std::memory_order_relaxed);
+		res.unparks += stats.unparks.load(std::memory_order_relaxed);
+		for (size_t i = 0; i < FABRIC_STATS_HISTOGRAM_BUCKETS_COUNT; ++i)
 		{
-			// dispose of dead workers before holding the mutex
-			buf_remove_if(dead_workers, [](Worker worker){
-				auto state = worker->atomic_state.load();
+			res.queue_wait_histogram[i] += stats.queue_wait_histogram[i].load(std::memory_order_relaxed);
+			res.run_time_histogram[i] += stats.run_time_histogram[i].load(std::memory_order_relaxed);
+		}
+	}
 
-				if (state == IWorker::STATE_STOP_REQUEST)
-					return false;
+	// Fiber
+	// a fiber runs fabric jobs on its own stack so that they can be suspended while waiting on mn primitives,
+	// fibers are pinned to the worker which created them and are pooled to reuse their stacks
+	struct Fiber
+	{
+		// the saved stack pointer while the fiber is switched out
+		void* sp;
+		Block stack;
+		// each fiber has its own context so that suspended jobs keep their allocators stack and tmp memory
+		Context context;
+		// the job which the fiber is running, it's reset to nullptr when the job finishes
+		Fabric_Task* job;
+		// the worker which runs the fiber, fibers don't move between workers
+		Worker worker;
+		// tells whether a suspended fiber is ready to resume
+		bool (*ready)(void*);
+		void* ready_arg;
+		// the waiter which the fiber is suspended on and its deadline, the worker doesn't poll waiting fibers, the
+		// signal puts them on the worker's ready list
+		Worker_Waiter* waiter;
+		uint64_t deadline;
+		// the fiber's index in its worker's waiting fibers list
+		size_t waiting_index;
+		// links the fibers in their worker's ready list
+		Fiber* next_ready;
+	#if MN_FIBERS_TSAN
+		void* tsan_fiber;
+	#endif
+	#if MN_FIBERS_ASAN
+		void* asan_fake_stack;
+	#endif
+	};
 
-				mn_assert(state == IWorker::STATE_STOP_ACKNOWLEDGED);
-				_worker_free(worker);
-				return true;
-			});
+	static void
+	_fiber_main();
 
-			bool slept_on_cond_var = false;
+	inline static Fiber*
+	_fiber_new(size_t stack_size)
+	{
+		auto self = alloc_zerod_from<Fiber>(memory::clib());
+		self->stack = virtual_alloc(nullptr, stack_size);
+		mn_assert(self->stack.ptr != nullptr);
+		context_init(&self->context);
+
+	#if MN_FIBERS_SUPPORTED
+		// build an initial frame which mn_fiber_switch restores and "returns" into _fiber_main
+		auto top = ((uintptr_t)self->stack.ptr + self->stack.size) & ~uintptr_t(15);
+		#if defined(__x86_64__)
+			auto sp = (uint64_t*)top;
+			// fake return address of _fiber_main which keeps the stack aligned as if it was called
+			*--sp = 0;
+			*--sp = (uint64_t)(uintptr_t)&_fiber_main;
+			// rbp, rbx, r12, r13, r14, r15
+			for (int i = 0; i < 6; ++i)
+				*--sp = 0;
+			// default mxcsr and x87 control word
+			*--sp = uint64_t(0x1F80) | (uint64_t(0x037F) << 32);
+			self->sp = sp;
+		#elif defined(__aarch64__)
+			auto sp = (uint64_t*)(top - 176);
+			for (int i = 0; i < 176 / 8; ++i)
+				sp[i] = 0;
+			// x30 (link register)
+			sp[11] = (uint64_t)(uintptr_t)&_fiber_main;
+			self->sp = sp;
+		#endif
+	#endif
+
+	#if MN_FIBERS_TSAN
+		self->tsan_fiber = __tsan_create_fiber(0);
+	#endif
+		return self;
+	}
 
-			{
-				mutex_lock(self->mtx);
-				mn_defer(mutex_unlock(self->mtx));
+	inline static void
+	_fiber_free(Fiber* self)
+	{
+	#if MN_FIBERS_TSAN
+		__tsan_destroy_fiber(self->tsan_fiber);
+	#endif
+		if (self->job)
+			_fabric_task_node_free(self->job);
+		context_free(&self->context);
+		virtual_free(self->stack);
+		free_from(memory::clib(), self);
+	}
 
-				if (self->atomic_available_jobs.load() == 0 &&
-					self->sleepy_side_workers.count == 0)
-				{
-					slept_on_cond_var = true;
-					cond_var_wait(self->cv, self->mtx, [&]{
-						return self->atomic_available_jobs.load() > 0 ||
-							self->is_running == false ||
-							self->sleepy_side_workers.count > 0;
-					});
-				}
+	// a task which waits for its ready function to return true before it's scheduled
+	struct Fabric_Waiter
+	{
+		Task<bool()> ready;
+		Fabric_Task* job;
+	};
 
-				if (self->is_running == false)
-					return;
+	// Timer Wheel
+	// a hierarchical timing wheel, each slot of a level spans the whole level below it, timers are linked into the
+	// level which covers their expiry and they cascade down to the lower levels as the wheel advances, this way
+	// inserting and canceling a timer is O(1) no matter how many timers are pending
+	struct Fabric_Timer_Node
+	{
+		enum STATE
+		{
+			// the timer is linked into one of the wheel slots
+			STATE_WAITING,
+			// the periodic task is running and the timer will be linked again once it finishes
+			STATE_RUNNING,
+			// the periodic task was canceled while it's running, it's freed once it finishes
+			STATE_CANCELED,
+		};
+
+		Fabric_Timer_Node* prev;
+		Fabric_Timer_Node* next;
+		// the head of the slot list which the timer is linked into
+		Fabric_Timer_Node** slot;
+		uint64_t handle;
+		// the tick at which the timer expires
+		uint64_t expires;
+		// the period of the periodic tasks, it's 0 for delayed tasks
+		uint64_t period;
+		STATE state;
+		Fabric_Task task;
+	};
+
+	struct Timer_Wheel
+	{
+		Mutex mtx;
+		Cond_Var cv;
+		Pool nodes_pool;
+		// a node stays in the timers table until it's freed, that's how we catch stale handles
+		Handle_Table<Fabric_Timer_Node*> timers;
+		Fabric_Timer_Node* slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS_COUNT];
+		// time_in_millis() at tick 0
+		uint64_t start_time_in_ms;
+		// the next tick to be processed
+		uint64_t current_tick;
+		// the tick which the timer thread sleeps until, it's 0 while the timer thread is awake
+		uint64_t wake_tick;
+		bool is_running;
+		// the timer thread is started with the first timer
+		Thread thread;
+	};
+
+	inline static void
+	_timer_wheel_init(Timer_Wheel& self, const char* name)
+	{
+		self.mtx = mn_mutex_new_with_srcloc(name);
+		self.cv = cond_var_new();
+		self.nodes_pool = pool_new(sizeof(Fabric_Timer_Node), TIMER_POOL_BUCKET_SIZE, memory::clib());
+		self.timers = handle_table_new<Fabric_Timer_Node*>();
+		self.start_time_in_ms = time_in_millis();
+		self.current_tick = 0;
+		self.wake_tick = 0;
+		self.is_running = true;
+		self.thread = nullptr;
+	}
+
+	inline static void
+	_timer_wheel_free(Timer_Wheel& self)
+	{
+		// the tasks which never fired are freed without running
+		for (auto& item: self.timers.items)
+			fabric_task_free(item.item->task);
+		handle_table_free(self.timers);
+		pool_free(self.nodes_pool);
+		cond_var_free(self.cv);
+		mutex_free(self.mtx);
+	}
+
+	// returns the current tick of the wheel's clock
+	inline static uint64_t
+	_timer_wheel_now(const Timer_Wheel& self)
+	{
+		auto now = time_in_millis();
+		return now > self.start_time_in_ms ? now - self.start_time_in_ms : 0;
+	}
+
+	inline static Fabric_Timer_Node*
+	_timer_wheel_node_new(Timer_Wheel& self, const Fabric_Task& task, uint64_t expires, uint64_t period)
+	{
+		auto node = (Fabric_Timer_Node*)pool_get(self.nodes_pool);
+		::new (node) Fabric_Timer_Node{};
+		node->handle = handle_table_insert(self.timers, node);
+		node->expires = expires;
+		node->period = period;
+		node->state = Fabric_Timer_Node::STATE_WAITING;
+		node->task = task;
+		return node;
+	}
+
+	// frees the given node, the caller should free or take ownership of its task
+	inline static void
+	_timer_wheel_node_free(Timer_Wheel& self, Fabric_Timer_Node* node)
+	{
+		handle_table_remove(self.timers, node->handle);
+		pool_put(self.nodes_pool, node);
+	}
+
+	// returns the node of the given handle, or nullptr if the handle is stale
+	inline static Fabric_Timer_Node*
+	_timer_wheel_find(Timer_Wheel& self, uint64_t handle)
+	{
+		auto index = handle_table_index_from_uint64(handle);
+		if (index.index >= self.timers._map.count || handle_table_exists(self.timers, handle) == false)
+			return nullptr;
+		return handle_table_get(self.timers, handle);
+	}
+
+	// links the timer into the slot which covers its expiry, expired timers are put in the current tick's slot
+	inline static void
+	_timer_wheel_link(Timer_Wheel& self, Fabric_Timer_Node* node)
+	{
+		if (node->expires < self.current_tick)
+			node->expires = self.current_tick;
+
+		// timers beyond the wheel's range go to the farthest slot and they're linked again once they cascade
+		auto delta = node->expires - self.current_tick;
+		if (delta > TIMER_WHEEL_MAX_DELTA)
+			delta = TIMER_WHEEL_MAX_DELTA;
+		auto expires = self.current_tick + delta;
+
+		size_t level = 0;
+		while (level + 1 < TIMER_WHEEL_LEVELS && delta >= (uint64_t(1) << ((level + 1) * TIMER_WHEEL_SLOT_BITS)))
+			++level;
+
+		auto slot = &self.slots[level][(expires >> (level * TIMER_WHEEL_SLOT_BITS)) & TIMER_WHEEL_SLOT_MASK];
+		node->slot = slot;
+		node->prev = nullptr;
+		node->next = *slot;
+		if (*slot)
+			(*slot)->prev = node;
+		*slot = node;
+	}
+
+	inline static void
+	_timer_wheel_unlink(Fabric_Timer_Node* node)
+	{
+		if (node->prev)
+			node->prev->next = node->next;
+		else
+			*node->slot = node->next;
+		if (node->next)
+			node->next->prev = node->prev;
+		node->prev = nullptr;
+		node->next = nullptr;
+		node->slot = nullptr;
+	}
+
+	// returns the next tick which has work to do, which is either a tick with expiring timers or a tick at which
+	// the higher levels cascade down
+	inline static uint64_t
+	_timer_wheel_next_tick(const Timer_Wheel& self)
+	{
+		// a tick at a slot boundary cascades the upper levels so it must be processed even if level 0 is empty
+		auto tick = self.current_tick;
+		if ((tick & TIMER_WHEEL_SLOT_MASK) == 0)
+			return tick;
+		while (self.slots[0][tick & TIMER_WHEEL_SLOT_MASK] == nullptr)
+		{
+			++tick;
+			if ((tick & TIMER_WHEEL_SLOT_MASK) == 0)
+				break;
+		}
+		return tick;
+	}
+
+	// processes the current tick of the wheel and appends the timers which expire at it to the given list
+	inline static void
+	_timer_wheel_tick(Timer_Wheel& self, Buf<Fabric_Timer_Node*>& expired)
+	{
+		auto tick = self.current_tick;
+
+		// when a level wraps around, the next slot of the level above it cascades down
+		for (size_t level = 1; level < TIMER_WHEEL_LEVELS; ++level)
+		{
+			auto shift = level * TIMER_WHEEL_SLOT_BITS;
+			if ((tick & ((uint64_t(1) << shift) - 1)) != 0)
+				break;
+
+			auto& slot = self.slots[level][(tick >> shift) & TIMER_WHEEL_SLOT_MASK];
+			auto node = slot;
+			slot = nullptr;
+			while (node)
+			{
+				auto next = node->next;
+				_timer_wheel_link(self, node);
+				node = next;
 			}
+		}
 
-			// SYSMON rest station, sysmon needs to sleep for some time, he does a lot of work, he deserves it
-			if (slept_on_cond_var == false)
-				thread_sleep(timeslice);
+		auto& slot = self.slots[0][tick & TIMER_WHEEL_SLOT_MASK];
+		for (auto node = slot; node; node = node->next)
+		{
+			node->slot = nullptr;
+			buf_push(expired, node);
+		}
+		slot = nullptr;
+		self.current_tick = tick + 1;
+	}
 
-			// get the max/min jobs
-			size_t busiest_worker = 0;
-			size_t max_jobs = 0;
-			size_t idle_worker = SIZE_MAX;
-			size_t min_jobs = SIZE_MAX;
-			for (size_t i = 0; i < self->workers.count; ++i)
+	// advances the wheel up to the given tick and appends the expired timers to the given list, the ticks with
+	// nothing to do are skipped
+	inline static void
+	_timer_wheel_advance(Timer_Wheel& self, uint64_t now, Buf<Fabric_Timer_Node*>& expired)
+	{
+		while (self.current_tick <= now)
+		{
+			auto tick = _timer_wheel_next_tick(self);
+			if (tick > now)
 			{
-				auto worker = self->workers[i];
+				self.current_tick = now + 1;
+				break;
+			}
+			self.current_tick = tick;
+			_timer_wheel_tick(self, expired);
+		}
+	}
 
-				mutex_lock(worker->mtx);
-				mn_defer(mutex_unlock(worker->mtx));
+	// a pool of plain threads which run the tasks that are expected to block, so they don't hold up the workers or get
+	// them evicted, the threads are started on demand and live until the fabric is freed
+	struct Blocking_Pool
+	{
+		Mutex mtx;
+		Cond_Var cv;
+		Ring<Fabric_Task*> q;
+		Buf<Thread> threads;
+		// how many threads are waiting for tasks
+		size_t idle_count;
+		bool is_running;
+	};
 
-				if (worker->job_q.count > max_jobs)
-				{
-					busiest_worker = i;
-					max_jobs = worker->job_q.count;
-				}
+	inline static void
+	_blocking_pool_init(Blocking_Pool& self, const char* name)
+	{
+		self.mtx = mn_mutex_new_with_srcloc(name);
+		self.cv = cond_var_new();
+		self.q = ring_new<Fabric_Task*>();
+		self.threads = buf_new<Thread>();
+		self.idle_count = 0;
+		self.is_running = true;
+	}
 
-				if (worker->atomic_job_start_time_in_ms.load() == 0 && worker->job_q.count < min_jobs)
+	inline static void
+	_blocking_pool_free(Blocking_Pool& self)
+	{
+		{
+			mutex_lock(self.mtx);
+			mn_defer(mutex_unlock(self.mtx));
+
+			self.is_running = false;
+			cond_var_notify_all(self.cv);
+		}
+
+		for (auto thread: self.threads)
+		{
+			thread_join(thread);
+			thread_free(thread);
+		}
+		buf_free(self.threads);
+
+		// the tasks which no thread picked up are freed without running, just like the workers' queued tasks
+		for (size_t i = 0; i < self.q.count; ++i)
+			_fabric_task_node_free(self.q[i]);
+		ring_free(self.q);
+		cond_var_free(self.cv);
+		mutex_free(self.mtx);
+	}
+
+	// Worker
+	struct IWorker
+	{
+		enum STATE
+		{
+			STATE_RUNNING,
+			STATE_PAUSED,
+			STATE_STOP_REQUEST,
+			STATE_STOP_ACKNOWLEDGED
+		};
+
+		Str name;
+		Mutex mtx;
+		Cond_Var cv;
+		Fabric fabric;
+		// tasks submitted to this worker from other threads, one queue per priority, protected by the mutex
+		Ring<Fabric_Task*> job_q[FABRIC_TASK_PRIORITY_COUNT];
+		// tasks owned by this worker, one deque per priority, the worker pops them from the bottom while other
+		// workers steal from the top
+		Task_Deque local_q[FABRIC_TASK_PRIORITY_COUNT];
+		uint64_t random_state;
+		// counts the scheduled jobs, used to check the injection queue periodically so it doesn't starve
+		uint64_t schedule_tick;
+		// how many jobs the worker is running on top of other jobs which are waiting on futures
+		uint32_t nested_jobs_depth;
+		Thread thread;
+		// futex word which is 1 while the worker is parked, wakers reset it to 0 and wake the worker
+		std::atomic<int32_t> atomic_parked;
+		// the worker's slot in the fabric workers list, it's used to index the fabric's sleeping workers bitmap, sysmon
+		// changes it while the worker runs when it moves the worker to another slot
+		std::atomic<size_t> atomic_index;
+		// the cpu the worker should be pinned to (-1 for none), it's set by sysmon when it moves the worker to another
+		// slot or evicts it, and the worker applies it from its own thread
+		std::atomic<int32_t> atomic_cpu;
+		// the cpu the worker's thread is currently pinned to, it's only touched by the worker's own thread
+		int32_t pinned_cpu;
+		// mirrors job_q[i].count so that submitters and thieves can check the queues without locking them
+		std::atomic<size_t> atomic_job_q_count[FABRIC_TASK_PRIORITY_COUNT];
+		std::atomic<FABRIC_TASK_FLAGS> atomic_current_job_flags;
+		std::atomic<uint64_t> atomic_job_start_time_in_ms;
+		std::atomic<uint64_t> atomic_block_start_time_in_ms;
+		std::atomic<STATE> atomic_state;
+		std::atomic<bool> atomic_disable_block_timing;
+		// set while a paused worker is waiting idle in its paused loop, which means that it finished the job it was
+		// running when it was paused and gave back its jobs, sysmon only resumes the paused workers which are idle
+		std::atomic<bool> atomic_paused_idle;
+
+		// fibers are only touched by the worker's own thread
+		// the worker's thread stack pointer while it's running a fiber
+		void* fiber_scheduler_sp;
+		Fiber* current_fiber;
+		Buf<Fiber*> free_fibers;
+		// fibers suspended until their ready functions return true, they're polled
+		Buf<Fiber*> suspended_fibers;
+		// fibers suspended on waiters, they're not polled but the ones with deadlines are checked for timeouts
+		Buf<Fiber*> waiting_fibers;
+		size_t timed_fibers_count;
+		// scratch list used while going over the suspended and the waiting fibers
+		Buf<Fiber*> fibers_scratch;
+		// waiting fibers which were signaled, the signalers push them from any thread and the worker takes them all at once
+		std::atomic<Fiber*> atomic_ready_fibers;
+	#if MN_FIBERS_TSAN
+		void* tsan_thread_fiber;
+	#endif
+	#if MN_FIBERS_ASAN
+		const void* thread_stack_bottom;
+		size_t thread_stack_size;
+	#endif
+
+		Worker_Stats stats;
+	};
+	thread_local Worker LOCAL_WORKER = nullptr;
+	// how many jobs the overload policy is running inline on top of each other on this thread, it's shared by the
+	// fibers of a worker so it can only overestimate the depth of each fiber's stack
+	thread_local uint32_t INLINE_JOBS_DEPTH = 0;
+	// the fabric of the blocking pool thread, it's not a worker but the tasks it runs can still submit to its fabric
+	thread_local Fabric LOCAL_BLOCKING_FABRIC = nullptr;
+
+	struct IFabric
+	{
+		Fabric_Settings settings;
+		Str name;
+		Str sysmon_name;
+		Str timer_name;
+
+		// workers list is read locked by task submission and stealing, and write locked by sysmon when it replaces a worker
+		Mutex_RW workers_mtx;
+		Buf<Worker> workers;
+		Buf<Worker> sleepy_side_workers;
+		Buf<Worker> ready_side_workers;
+		// paused workers which were taken out of the workers list when the fabric shrank, they're resumed first when
+		// the fabric grows again or when a blocking worker needs a replacement
+		Buf<Worker> surplus_workers;
+		// sysmon holds it while it moves workers in and out of the side workers lists so that fabric_stats can sum them
+		Mutex side_workers_mtx;
+		// the counters of the workers which sysmon stopped, it's protected by the side workers mutex
+		Fabric_Worker_Stats retired_stats;
+		std::atomic<uint64_t> atomic_blocking_evictions;
+		std::atomic<uint64_t> atomic_skipped_evictions;
+		// the workers, the side workers and the blocking pool threads, it's bounded by the max threads count
+		std::atomic<size_t> atomic_threads_count;
+
+		Str blocking_name;
+		Blocking_Pool blocking_pool;
+
+		// the submitters which are blocked by the overload policy wait on the signal, the workers only notify it
+		// after finishing a job if there are any
+		Worker_Signal overload_signal;
+		std::atomic<int32_t> atomic_blocked_submitters;
+		std::atomic<uint64_t> atomic_overloaded_submissions;
+
+		// tasks submitted from outside the fabric's workers, one queue per priority
+		MPMC_Ring<Fabric_Task*> injection_q[FABRIC_TASK_PRIORITY_COUNT];
+
+		// the cpu of each worker slot, it's empty if the workers are not pinned
+		Buf<Topology_CPU> workers_cpus;
+		// for each worker slot, the slots which share its last level cache followed by the ones on its numa node
+		// it's empty if the stealing is not topology aware
+		Buf<Buf<size_t>> near_workers;
+
+		// tasks waiting for their ready functions, they're polled by the workers
+		Mutex waiters_mtx;
+		Buf<Fabric_Waiter> waiters;
+		std::atomic<size_t> atomic_waiters_count;
+		// only one worker polls the waiters at a time
+		std::atomic<bool> atomic_waiters_polling;
+
+		// delayed and periodic tasks
+		Timer_Wheel timer_wheel;
+
+		// tasks waiting for their os handles to be ready, the poller and the io thread are started with the first one
+		Str io_name;
+		Mutex io_mtx;
+		Fabric_Poller io_poller;
+		Thread io_thread;
+		std::atomic<bool> atomic_io_running;
+
+		Mutex mtx;
+		Cond_Var cv;
+		bool is_running;
+		std::atomic<bool> atomic_sysmon_sleeping;
+		// it's incremented after the tasks are pushed so it can go negative for a short period
+		std::atomic<int64_t> atomic_available_jobs;
+		// a bit for each worker slot which is set while the worker in that slot is parked
+		std::atomic<uint64_t>* sleeping_workers_bitmap;
+		size_t sleeping_workers_bitmap_count;
+		std::atomic<size_t> atomic_next_worker;
+		size_t worker_id_generator;
+
+		Thread sysmon;
+	};
+
+	inline static uint64_t
+	_worker_random(Worker self)
+	{
+		// xorshift64
+		auto x = self->random_state;
+		x ^= x << 13;
+		x ^= x >> 7;
+		x ^= x << 17;
+		self->random_state = x;
+		return x;
+	}
+
+	// wakes up the given worker if it's parked, it returns whether the worker was woken up
+	inline static bool
+	_worker_wake(Worker self)
+	{
+		if (self->atomic_parked.load() == 0)
+			return false;
+
+		if (self->atomic_parked.exchange(0) == 0)
+			return false;
+
+		futex_wake_one(&self->atomic_parked);
+		return true;
+	}
+
+	// returns the order in which the worker should look at the priority queues for the current schedule tick
+	inline static const FABRIC_TASK_PRIORITY*
+	_worker_priority_order(Worker self)
+	{
+		if (self->schedule_tick % BACKGROUND_PRIORITY_TURN == 0)
+			return PRIORITY_ORDER_BACKGROUND_FIRST;
+		else if (self->schedule_tick % NORMAL_PRIORITY_TURN == 0)
+			return PRIORITY_ORDER_NORMAL_FIRST;
+		return PRIORITY_ORDER_HIGH_FIRST;
+	}
+
+	// pushes the task to the job_q of its priority, the caller should have the worker's mutex locked
+	inline static void
+	_worker_enqueue_locked(Worker self, Fabric_Task* task)
+	{
+		auto& job_q = self->job_q[task->priority];
+		ring_push_back(job_q, task);
+		self->atomic_job_q_count[task->priority].store(job_q.count);
+	}
+
+	// pushes the task to the local deque of its priority, only the worker's own thread can call it
+	inline static void
+	_worker_local_push(Worker self, Fabric_Task* task)
+	{
+		_task_deque_push(self->local_q[task->priority], task);
+	}
+
+	inline static void
+	_worker_push(Worker self, Fabric_Task* task)
+	{
+		mutex_lock(self->mtx);
+		_worker_enqueue_locked(self, task);
+		mutex_unlock(self->mtx);
+
+		_worker_wake(self);
+	}
+
+	// pushes the tasks to the worker's job_q without notifying it, the caller is responsible for waking it up
+	inline static void
+	_worker_enqueue_batch(Worker self, Fabric_Task** tasks, size_t count)
+	{
+		mutex_lock(self->mtx);
+		mn_defer(mutex_unlock(self->mtx));
+
+		for (size_t i = 0; i < count; ++i)
+			_worker_enqueue_locked(self, tasks[i]);
+	}
+
+	inline static void
+	_worker_push_batch(Worker self, Fabric_Task** tasks, size_t count)
+	{
+		_worker_enqueue_batch(self, tasks, count);
+		_worker_wake(self);
+	}
+
+	// returns an approximation of the number of tasks waiting in the worker's job_q
+	inline static size_t
+	_worker_job_q_count(Worker self)
+	{
+		size_t res = 0;
+		for (size_t i = 0; i < FABRIC_TASK_PRIORITY_COUNT; ++i)
+			res += self->atomic_job_q_count[i].load(std::memory_order_relaxed);
+		return res;
+	}
+
+	// returns an approximation of the number of tasks waiting in the worker's local deques
+	inline static size_t
+	_worker_local_q_count(Worker self)
+	{
+		size_t res = 0;
+		for (size_t i = 0; i < FABRIC_TASK_PRIORITY_COUNT; ++i)
+			res += _task_deque_count(self->local_q[i]);
+		return res;
+	}
+
+	// returns an approximation of the number of tasks waiting in the worker's queues
+	inline static size_t
+	_worker_queue_depth(Worker self)
+	{
+		return _worker_local_q_count(self) + _worker_job_q_count(self);
+	}
+
+	inline static bool
+	_fabric_has_sleeping_workers(Fabric self)
+	{
+		for (size_t i = 0; i < self->sleeping_workers_bitmap_count; ++i)
+			if (self->sleeping_workers_bitmap[i].load() != 0)
+				return true;
+		return false;
+	}
+
+	// wakes up a single sleeping worker, the caller should have the workers list read locked
+	inline static bool
+	_fabric_wake_sleeping_worker_locked(Fabric self)
+	{
+		for (size_t i = 0; i < self->sleeping_workers_bitmap_count; ++i)
+		{
+			auto& word = self->sleeping_workers_bitmap[i];
+			auto bits = word.load();
+			while (bits != 0)
+			{
+				auto bit = _lowest_set_bit(bits);
+				auto mask = uint64_t(1) << bit;
+				auto index = i * 64 + bit;
+				// a worker which is checking for jobs on its way to sleep shouldn't consume the wake up
+				if (index < self->workers.count && self->workers[index] != LOCAL_WORKER)
 				{
-					idle_worker = i;
-					min_jobs = worker->job_q.count;
+					// whoever clears the bit owns the wake up of this worker
+					if ((word.fetch_and(~mask) & mask) != 0 && _worker_wake(self->workers[index]))
+						return true;
 				}
+				bits &= ~mask;
 			}
+		}
+		return false;
+	}
 
-			// steal from the max jobs and give to min jobs, if we have a worker that's idle
-			if (idle_worker < self->workers.count && max_jobs > min_jobs && min_jobs == 0)
-			{
-				{
-					auto max_worker = self->workers[busiest_worker];
+	// wakes up a single sleeping worker, it only touches the workers list if there are sleeping workers
+	// the submitters should increment the available jobs (read-modify-write) after pushing their tasks and before
+	// calling this function, this way either we see the sleeping worker or it sees the tasks we've just pushed
+	inline static bool
+	_fabric_wake_sleeping_worker(Fabric self)
+	{
+		if (_fabric_has_sleeping_workers(self) == false)
+			return false;
 
-					mutex_lock(max_worker->mtx);
-					mn_defer(mutex_unlock(max_worker->mtx));
+		mutex_read_lock(self->workers_mtx);
+		mn_defer(mutex_read_unlock(self->workers_mtx));
 
-					max_jobs = max_worker->job_q.count;
-					size_t job_steal_count = max_jobs;
-					if (job_steal_count > 1)
-						job_steal_count /= 2;
+		return _fabric_wake_sleeping_worker_locked(self);
+	}
 
-					for (size_t i = 0; i < job_steal_count; ++i)
-					{
-						auto job = ring_back(max_worker->job_q);
-						ring_pop_back(max_worker->job_q);
+	// notifies sysmon that there are available jobs, only if it's sleeping
+	inline static void
+	_fabric_notify_sysmon(Fabric self)
+	{
+		if (self->atomic_sysmon_sleeping.load() == false)
+			return;
 
-						buf_push(tmp_jobs, job);
-					}
-				}
+		mutex_lock(self->mtx);
+		cond_var_notify(self->cv);
+		mutex_unlock(self->mtx);
+	}
 
-				{
-					auto min_worker = self->workers[idle_worker];
+	// pops a group of tasks from the fabric's injection queue of the given priority, it returns the first one and
+	// pushes the rest to the worker's local deque so that other workers can steal them
+	inline static Fabric_Task*
+	_worker_grab_injected_jobs(Worker self, FABRIC_TASK_PRIORITY priority)
+	{
+		Fabric_Task* jobs[INJECTION_QUEUE_GRAB_COUNT];
+		size_t count = 0;
+		auto injection_q = self->fabric->injection_q[priority];
+		while (count < INJECTION_QUEUE_GRAB_COUNT && mpmc_ring_pop_try(injection_q, jobs[count]))
+			++count;
+
+		if (count == 0)
+			return nullptr;
+
+		// push the newest first so that the worker pops the jobs in the same order they were submitted
+		for (size_t i = count - 1; i > 0; --i)
+			_task_deque_push(self->local_q[priority], jobs[i]);
+
+		if (count > 1)
+			_fabric_wake_sleeping_worker(self->fabric);
+		return jobs[0];
+	}
+
+	// moves all the tasks in the worker's job_q of the given priority into its local deque so that other workers
+	// can steal them, it returns the number of moved tasks
+	inline static size_t
+	_worker_drain_job_q(Worker self, FABRIC_TASK_PRIORITY priority)
+	{
+		if (self->atomic_job_q_count[priority].load() == 0)
+			return 0;
+
+		mutex_lock(self->mtx);
+		mn_defer(mutex_unlock(self->mtx));
+
+		auto& job_q = self->job_q[priority];
+		auto count = job_q.count;
+		// push the newest first so that the worker pops the jobs in the same order they were submitted
+		for (size_t i = 0; i < count; ++i)
+			_task_deque_push(self->local_q[priority], job_q[count - i - 1]);
+		for (size_t i = 0; i < count; ++i)
+			ring_pop_back(job_q);
+		self->atomic_job_q_count[priority].store(0);
+		return count;
+	}
+
+	// steals half the tasks of the victim's job_q of the given priority into the thief's local deque and returns
+	// one of them
+	inline static Fabric_Task*
+	_worker_steal_job_q(Worker thief, Worker victim, FABRIC_TASK_PRIORITY priority)
+	{
+		if (victim->atomic_job_q_count[priority].load() == 0)
+			return nullptr;
+
+		mutex_lock(victim->mtx);
+		mn_defer(mutex_unlock(victim->mtx));
+
+		auto& job_q = victim->job_q[priority];
+		if (job_q.count == 0)
+			return nullptr;
+
+		auto res = ring_front(job_q);
+		ring_pop_front(job_q);
+
+		auto steal_count = job_q.count / 2;
+		for (size_t i = 0; i < steal_count; ++i)
+		{
+			_task_deque_push(thief->local_q[priority], ring_back(job_q));
+			ring_pop_back(job_q);
+		}
+		victim->atomic_job_q_count[priority].store(job_q.count);
+		return res;
+	}
+
+	// tries to steal a task of the given priority from the given victim, the caller should have the workers list
+	// read locked
+	inline static Fabric_Task*
+	_fabric_steal_job_from_locked(Fabric self, Worker thief, Worker victim, FABRIC_TASK_PRIORITY priority)
+	{
+		if (victim == thief)
+			return nullptr;
+
+		auto res = _task_deque_steal(victim->local_q[priority]);
+		if (res == nullptr)
+			res = _worker_steal_job_q(thief, victim, priority);
+
+		if (res)
+			_stats_inc(thief->stats.steals);
+
+		// the victim still has work, so we wake another sleeping worker to help it
+		if (res && (_task_deque_count(victim->local_q[priority]) > 0 || _task_deque_count(thief->local_q[priority]) > 0))
+			_fabric_wake_sleeping_worker_locked(self);
+		return res;
+	}
+
+	// tries to steal a task from a random victim in the fabric, it looks for the higher priority tasks in all
+	// the victims before it settles for a lower priority one, with topology aware stealing the victims near
+	// the thief are tried first for each priority
+	inline static Fabric_Task*
+	_fabric_steal_job(Fabric self, Worker thief, const FABRIC_TASK_PRIORITY* order)
+	{
+		mutex_read_lock(self->workers_mtx);
+		mn_defer(mutex_read_unlock(self->workers_mtx));
+
+		auto count = self->workers.count;
+		if (count < 2)
+			return nullptr;
+
+		const Buf<size_t>* near_workers = nullptr;
+		auto thief_index = thief->atomic_index.load(std::memory_order_relaxed);
+		if (thief_index < self->near_workers.count && self->workers[thief_index] == thief)
+			near_workers = &self->near_workers[thief_index];
+
+		auto start = _worker_random(thief) % count;
+		for (size_t p = 0; p < FABRIC_TASK_PRIORITY_COUNT; ++p)
+		{
+			auto priority = order[p];
+			if (near_workers && near_workers->count > 0)
+			{
+				for (size_t i = 0; i < near_workers->count; ++i)
+				{
+					// the near workers might be in the slots which the fabric doesn't use after it shrank
+					auto index = near_workers->ptr[(start + i) % near_workers->count];
+					if (index >= count)
+						continue;
+					auto victim = self->workers[index];
+					if (auto res = _fabric_steal_job_from_locked(self, thief, victim, priority))
+						return res;
+				}
+			}
+
+			for (size_t i = 0; i < count; ++i)
+			{
+				auto victim = self->workers[(start + i) % count];
+				if (auto res = _fabric_steal_job_from_locked(self, thief, victim, priority))
+					return res;
+			}
+		}
+		return nullptr;
+	}
+
+	inline static Fabric_Task*
+	_worker_find_job(Worker self)
+	{
+		++self->schedule_tick;
+		auto order = _worker_priority_order(self);
+
+		// check the injection queue every once in a while so that it doesn't starve
+		// in case the worker keeps on pushing jobs to its local deque
+		if (self->fabric && self->schedule_tick % 61 == 0)
+		{
+			for (size_t i = 0; i < FABRIC_TASK_PRIORITY_COUNT; ++i)
+				if (auto res = _worker_grab_injected_jobs(self, order[i]))
+					return res;
+		}
+
+		for (size_t i = 0; i < FABRIC_TASK_PRIORITY_COUNT; ++i)
+		{
+			auto priority = order[i];
+			if (auto res = _task_deque_pop(self->local_q[priority]))
+				return res;
+
+			auto drained_count = _worker_drain_job_q(self, priority);
+			if (drained_count > 0)
+			{
+				if (drained_count > 1 && self->fabric)
+					_fabric_wake_sleeping_worker(self->fabric);
+
+				if (auto res = _task_deque_pop(self->local_q[priority]))
+					return res;
+			}
+
+			if (self->fabric)
+			{
+				if (auto res = _worker_grab_injected_jobs(self, priority))
+					return res;
+			}
+		}
+
+		if (self->fabric)
+			return _fabric_steal_job(self->fabric, self, order);
+
+		return nullptr;
+	}
+
+	// runs the given job and frees it, it's shared by the jobs which the worker takes from its queues and the ones which
+	// the overload policy runs inline
+	inline static void
+	_worker_invoke_job(Worker self, Fabric_Task* job)
+	{
+		auto timing = self->fabric && self->fabric->settings.enable_timing_stats;
+		uint64_t start_time_in_us = 0;
+		if (timing)
+		{
+			start_time_in_us = _stats_now_in_us();
+			auto submit_time_in_us = _fabric_task_node_submit_time(job);
+			if (submit_time_in_us != 0)
+				_stats_histogram_add(self->stats.queue_wait_histogram, start_time_in_us - submit_time_in_us);
+		}
+
+		// each job gets its tmp memory scoped with a checkpoint, nested jobs run on top of the job which is waiting
+		// for them so they just restore back to where it was, and the arena keeps its blocks between jobs
+		auto tmp = memory::tmp();
+		auto tmp_checkpoint = tmp->checkpoint();
+
+		self->atomic_job_start_time_in_ms.store(time_in_millis());
+		self->atomic_disable_block_timing = false;
+		self->atomic_current_job_flags.store(job->flags);
+		job->task();
+		self->atomic_disable_block_timing = true;
+		self->atomic_job_start_time_in_ms.store(0);
+		self->atomic_current_job_flags.store(FABRIC_TASK_FLAG_NONE);
+
+		if (timing)
+			_stats_histogram_add(self->stats.run_time_histogram, _stats_now_in_us() - start_time_in_us);
+		_stats_inc(self->stats.tasks_executed);
+
+		_fabric_task_node_free(job);
+		tmp->restore(tmp_checkpoint);
+		if (self->nested_jobs_depth == 0)
+			tmp->trim();
+	}
+
+	inline static void
+	_worker_execute_job(Worker self, Fabric_Task* job)
+	{
+		_worker_invoke_job(self, job);
+		if (self->fabric)
+		{
+			if (self->fabric->settings.after_each_job)
+				self->fabric->settings.after_each_job();
+			self->fabric->atomic_available_jobs.fetch_sub(1);
+			if (self->fabric->atomic_blocked_submitters.load() > 0)
+				worker_signal_notify(self->fabric->overload_signal);
+		}
+	}
+
+	// switches from the worker's thread stack to the given fiber, it returns when the fiber finishes its job or suspends
+	inline static void
+	_worker_switch_to_fiber(Worker self, Fiber* fiber)
+	{
+	#if MN_FIBERS_SUPPORTED
+		self->current_fiber = fiber;
+		auto thread_context = context_local(&fiber->context);
+	#if MN_FIBERS_TSAN
+		if (self->tsan_thread_fiber == nullptr)
+			self->tsan_thread_fiber = __tsan_get_current_fiber();
+		__tsan_switch_to_fiber(fiber->tsan_fiber, 0);
+	#endif
+	#if MN_FIBERS_ASAN
+		void* fake_stack = nullptr;
+		__sanitizer_start_switch_fiber(&fake_stack, fiber->stack.ptr, fiber->stack.size);
+	#endif
+		mn_fiber_switch(&self->fiber_scheduler_sp, fiber->sp);
+	#if MN_FIBERS_ASAN
+		__sanitizer_finish_switch_fiber(fake_stack, nullptr, nullptr);
+	#endif
+		context_local(thread_context);
+		self->current_fiber = nullptr;
+	#else
+		mn_unreachable();
+	#endif
+	}
+
+	// switches from the given fiber back to its worker's thread stack
+	inline static void
+	_fiber_switch_to_worker(Fiber* self, Worker worker)
+	{
+	#if MN_FIBERS_SUPPORTED
+	#if MN_FIBERS_TSAN
+		__tsan_switch_to_fiber(worker->tsan_thread_fiber, 0);
+	#endif
+	#if MN_FIBERS_ASAN
+		__sanitizer_start_switch_fiber(&self->asan_fake_stack, worker->thread_stack_bottom, worker->thread_stack_size);
+	#endif
+		mn_fiber_switch(&self->sp, worker->fiber_scheduler_sp);
+	#if MN_FIBERS_ASAN
+		__sanitizer_finish_switch_fiber(self->asan_fake_stack, &worker->thread_stack_bottom, &worker->thread_stack_size);
+	#endif
+	#else
+		mn_unreachable();
+	#endif
+	}
+
+	static void
+	_fiber_main()
+	{
+		auto worker = LOCAL_WORKER;
+		auto self = worker->current_fiber;
+	#if MN_FIBERS_ASAN
+		__sanitizer_finish_switch_fiber(nullptr, &worker->thread_stack_bottom, &worker->thread_stack_size);
+	#endif
+
+		// the fiber never returns, it goes back to the worker after each job and the worker reuses it for other jobs
+		while (true)
+		{
+			_worker_execute_job(worker, self->job);
+			self->job = nullptr;
+			_fiber_switch_to_worker(self, worker);
+		}
+	}
+
+	inline static bool
+	_worker_fibers_enabled(Worker self)
+	{
+		return MN_FIBERS_SUPPORTED && self->fabric && self->fabric->settings.enable_fibers;
+	}
+
+	// runs the given fiber until it finishes its job or suspends, finished fibers go back to the pool
+	inline static void
+	_worker_run_fiber(Worker self, Fiber* fiber)
+	{
+		_worker_switch_to_fiber(self, fiber);
+
+		if (fiber->job == nullptr)
+		{
+			if (self->free_fibers.count < FIBER_POOL_CAPACITY)
+				buf_push(self->free_fibers, fiber);
+			else
+				_fiber_free(fiber);
+		}
+	}
+
+	// resumes the suspended fibers which are ready, it returns whether it resumed any of them
+	inline static bool
+	_worker_resume_ready_fibers(Worker self)
+	{
+		if (self->suspended_fibers.count == 0)
+			return false;
+
+		// fibers which suspend again while we're going over the list are added to the emptied list so we don't check
+		// them again, and the fibers which aren't ready go back to it
+		std::swap(self->suspended_fibers, self->fibers_scratch);
+		bool res = false;
+		for (auto fiber: self->fibers_scratch)
+		{
+			if (fiber->ready(fiber->ready_arg))
+			{
+				_worker_run_fiber(self, fiber);
+				res = true;
+			}
+			else
+			{
+				buf_push(self->suspended_fibers, fiber);
+			}
+		}
+		buf_clear(self->fibers_scratch);
+		return res;
+	}
+
+	// resumes the waiting fibers whose waiters were signaled, it returns whether it resumed any of them
+	inline static bool
+	_worker_resume_signaled_fibers(Worker self)
+	{
+		if (self->atomic_ready_fibers.load(std::memory_order_relaxed) == nullptr)
+			return false;
+
+		// the fibers are pushed to the front so we reverse them to resume them in the order they were signaled
+		auto it = self->atomic_ready_fibers.exchange(nullptr, std::memory_order_acquire);
+		Fiber* ordered = nullptr;
+		while (it)
+		{
+			auto next = it->next_ready;
+			it->next_ready = ordered;
+			ordered = it;
+			it = next;
+		}
+
+		while (ordered)
+		{
+			// the fiber might wait and get signaled again while it runs so we read the next one first
+			auto next = ordered->next_ready;
+			ordered->next_ready = nullptr;
+			_worker_run_fiber(self, ordered);
+			ordered = next;
+		}
+		return true;
+	}
+
+	// resumes the waiting fibers whose deadlines have passed, it returns whether it resumed any of them
+	inline static bool
+	_worker_resume_timed_out_fibers(Worker self)
+	{
+		if (self->timed_fibers_count == 0)
+			return false;
+
+		auto now = time_in_millis();
+		for (auto fiber: self->waiting_fibers)
+		{
+			if (fiber->deadline > now)
+				continue;
+
+			// take the fiber back from its waiter, if the signal took it first then it's already on the ready list
+			void* sleeper = fiber;
+			if (fiber->waiter->atomic_sleeper.compare_exchange_strong(sleeper, nullptr))
+				buf_push(self->fibers_scratch, fiber);
+		}
+
+		// the fibers remove themselves from the waiting list once they're resumed
+		bool res = self->fibers_scratch.count > 0;
+		for (auto fiber: self->fibers_scratch)
+			_worker_run_fiber(self, fiber);
+		buf_clear(self->fibers_scratch);
+		return res;
+	}
+
+	// resumes all the fibers which can continue, it returns whether it resumed any of them
+	inline static bool
+	_worker_resume_fibers(Worker self)
+	{
+		bool res = false;
+		res |= _worker_resume_signaled_fibers(self);
+		res |= _worker_resume_timed_out_fibers(self);
+		res |= _worker_resume_ready_fibers(self);
+		return res;
+	}
+
+	// returns whether the worker has fibers which can't continue yet
+	inline static bool
+	_worker_has_suspended_fibers(Worker self)
+	{
+		return self->suspended_fibers.count > 0 || self->waiting_fibers.count > 0;
+	}
+
+	// returns whether any of the suspended fibers can continue
+	inline static bool
+	_worker_has_ready_fibers(Worker self)
+	{
+		if (self->atomic_ready_fibers.load(std::memory_order_relaxed) != nullptr)
+			return true;
+
+		if (self->timed_fibers_count > 0)
+		{
+			auto now = time_in_millis();
+			for (auto fiber: self->waiting_fibers)
+				if (fiber->deadline <= now)
+					return true;
+		}
+
+		for (auto fiber: self->suspended_fibers)
+			if (fiber->ready(fiber->ready_arg))
+				return true;
+		return false;
+	}
+
+	// returns how long the worker can sleep before it has to check its suspended fibers again, the fibers which are
+	// suspended on ready functions are polled and the waiting ones are only checked for their deadlines
+	inline static Timeout
+	_worker_fibers_poll_timeout(Worker self)
+	{
+		if (self->suspended_fibers.count > 0)
+			return Timeout{FIBER_POLL_INTERVAL_IN_MS};
+
+		if (self->timed_fibers_count == 0)
+			return INFINITE_TIMEOUT;
+
+		auto deadline = UINT64_MAX;
+		for (auto fiber: self->waiting_fibers)
+			if (fiber->deadline < deadline)
+				deadline = fiber->deadline;
+
+		auto now = time_in_millis();
+		if (deadline <= now)
+			return Timeout{1};
+		return Timeout{deadline - now};
+	}
+
+	// submits the given job node to the fabric, jobs submitted from within the fabric go to the local worker's deque
+	// without any locking, and the rest go through the injection queue
+	inline static void
+	_fabric_submit_job(Fabric self, Fabric_Task* job)
+	{
+		if (self->settings.enable_timing_stats)
+			_fabric_task_node_submit_time(job) = _stats_now_in_us();
+
+		auto local_worker = LOCAL_WORKER;
+		if (local_worker && local_worker->fabric == self && local_worker->atomic_state.load() == IWorker::STATE_RUNNING)
+		{
+			_worker_local_push(local_worker, job);
+		}
+		else if (mpmc_ring_push_try(self->injection_q[job->priority], job) == false)
+		{
+			// injection queue is full, push it directly to one of the workers
+			mutex_read_lock(self->workers_mtx);
+			mn_defer(mutex_read_unlock(self->workers_mtx));
+
+			auto next_worker = self->atomic_next_worker.fetch_add(1) % self->workers.count;
+			_worker_push(self->workers[next_worker], job);
+		}
+
+		self->atomic_available_jobs.fetch_add(1);
+		_fabric_wake_sleeping_worker(self);
+		_fabric_notify_sysmon(self);
+	}
+
+	// submits the given job node to the fabric if it's not overloaded, it returns false if it's overloaded in which case
+	// the job isn't submitted
+	inline static bool
+	_fabric_try_submit_job(Fabric self, Fabric_Task* job)
+	{
+		auto max_pending_tasks = self->settings.max_pending_tasks;
+		if (max_pending_tasks > 0 && self->atomic_available_jobs.load() >= int64_t(max_pending_tasks))
+			return false;
+
+		auto max_worker_queue_size = self->settings.max_worker_queue_size;
+		if (max_worker_queue_size == 0)
+		{
+			_fabric_submit_job(self, job);
+			return true;
+		}
+
+		if (self->settings.enable_timing_stats)
+			_fabric_task_node_submit_time(job) = _stats_now_in_us();
+
+		auto local_worker = LOCAL_WORKER;
+		if (local_worker && local_worker->fabric == self && local_worker->atomic_state.load() == IWorker::STATE_RUNNING &&
+			_worker_queue_depth(local_worker) < max_worker_queue_size)
+		{
+			_worker_local_push(local_worker, job);
+		}
+		else if (mpmc_ring_push_try(self->injection_q[job->priority], job) == false)
+		{
+			// injection queue is full, push it directly to one of the workers which isn't full
+			mutex_read_lock(self->workers_mtx);
+			mn_defer(mutex_read_unlock(self->workers_mtx));
+
+			auto workers_count = self->workers.count;
+			auto start = self->atomic_next_worker.fetch_add(1);
+			Worker receiver = nullptr;
+			for (size_t i = 0; i < workers_count; ++i)
+			{
+				auto worker = self->workers[(start + i) % workers_count];
+				if (_worker_queue_depth(worker) < max_worker_queue_size)
+				{
+					receiver = worker;
+					break;
+				}
+			}
+
+			if (receiver == nullptr)
+				return false;
+			_worker_push(receiver, job);
+		}
+
+		self->atomic_available_jobs.fetch_add(1);
+		_fabric_wake_sleeping_worker(self);
+		_fabric_notify_sysmon(self);
+		return true;
+	}
+
+	// runs the given job on the calling thread for the overload policy, on the fabric's own workers it runs on top of
+	// the worker's current job and it's accounted like the jobs the worker takes from its queues, it returns false
+	// without running the job if the thread is already MAX_INLINE_JOBS_DEPTH inline jobs deep
+	inline static bool
+	_fabric_run_job_inline(Fabric self, Fabric_Task* job)
+	{
+		if (INLINE_JOBS_DEPTH >= MAX_INLINE_JOBS_DEPTH)
+			return false;
+
+		++INLINE_JOBS_DEPTH;
+		mn_defer(--INLINE_JOBS_DEPTH);
+
+		// the job didn't wait in any queue
+		_fabric_task_node_submit_time(job) = 0;
+
+		auto local_worker = LOCAL_WORKER;
+		if (local_worker && local_worker->fabric == self)
+		{
+			// the inline job takes over the sysmon timing of the job which submitted it until it finishes
+			auto flags = local_worker->atomic_current_job_flags.load();
+			auto start_time = local_worker->atomic_job_start_time_in_ms.load();
+			auto disable_block_timing = local_worker->atomic_disable_block_timing.load();
+			++local_worker->nested_jobs_depth;
+			_worker_invoke_job(local_worker, job);
+			--local_worker->nested_jobs_depth;
+			local_worker->atomic_current_job_flags.store(flags);
+			local_worker->atomic_job_start_time_in_ms.store(start_time);
+			local_worker->atomic_disable_block_timing = disable_block_timing;
+		}
+		else
+		{
+			auto tmp = memory::tmp();
+			auto tmp_checkpoint = tmp->checkpoint();
+			job->task();
+			_fabric_task_node_free(job);
+			tmp->restore(tmp_checkpoint);
+		}
+		return true;
+	}
+
+	// handles the given job according to the fabric's overload policy, it returns false if the job was rejected
+	inline static bool
+	_fabric_submit_job_with_policy(Fabric self, Fabric_Task* job)
+	{
+		if (_fabric_try_submit_job(self, job))
+			return true;
+
+		self->atomic_overloaded_submissions.fetch_add(1, std::memory_order_relaxed);
+
+		auto local_worker = LOCAL_WORKER;
+		auto on_fabric_worker = local_worker != nullptr && local_worker->fabric == self;
+		switch (self->settings.overload_policy)
+		{
+		case FABRIC_OVERLOAD_POLICY_BLOCK:
+			if (on_fabric_worker == false)
+			{
+				// the workers only notify the signal if they see a blocked submitter, so we announce ourselves before
+				// checking for room the first time
+				self->atomic_blocked_submitters.fetch_add(1);
+				worker_block_on_signal(self->overload_signal, [self, job] { return _fabric_try_submit_job(self, job); });
+				self->atomic_blocked_submitters.fetch_sub(1);
+				return true;
+			}
+			// the workers can't wait for themselves to make room so we fallthrough and run the job inline
+			[[fallthrough]];
+		case FABRIC_OVERLOAD_POLICY_RUN_INLINE:
+			// past the inline depth the job is queued regardless of the limits so that the recursion stays bounded
+			if (_fabric_run_job_inline(self, job) == false)
+				_fabric_submit_job(self, job);
+			return true;
+		case FABRIC_OVERLOAD_POLICY_REJECT:
+		default:
+			_fabric_task_node_free(job);
+			return false;
+		}
+	}
+
+	static void
+	_fabric_timer_rearm(Fabric self, Fabric_Timer_Node* node);
+
+	// turns the expired timer into a job, delayed tasks give their task to the job and are freed while periodic
+	// tasks run through a job which links them again once it finishes, the caller should have the wheel locked
+	inline static Fabric_Task*
+	_fabric_timer_fire_locked(Fabric self, Fabric_Timer_Node* node)
+	{
+		if (node->period == 0)
+		{
+			auto job = _fabric_task_node_new(node->task);
+			_timer_wheel_node_free(self->timer_wheel, node);
+			return job;
+		}
+
+		node->state = Fabric_Timer_Node::STATE_RUNNING;
+		Fabric_Task job{};
+		job.task = fabric_task_make([self, node] {
+			node->task.task();
+			_fabric_timer_rearm(self, node);
+		});
+		job.flags = node->task.flags;
+		job.priority = node->task.priority;
+		return _fabric_task_node_new(job);
+	}
+
+	static void
+	_timer_main(void* fabric)
+	{
+		_disable_profiling_for_this_thread();
+
+		auto self = (Fabric)fabric;
+		auto& wheel = self->timer_wheel;
+
+		auto expired = buf_with_allocator<Fabric_Timer_Node*>(memory::clib());
+		mn_defer(buf_free(expired));
+		auto jobs = buf_with_allocator<Fabric_Task*>(memory::clib());
+		mn_defer(buf_free(jobs));
+
+		mutex_lock(wheel.mtx);
+		while (wheel.is_running)
+		{
+			auto now = _timer_wheel_now(wheel);
+			_timer_wheel_advance(wheel, now, expired);
+			for (auto node: expired)
+				buf_push(jobs, _fabric_timer_fire_locked(self, node));
+			buf_clear(expired);
+
+			// the jobs are submitted without holding the wheel lock so that periodic tasks can link themselves again
+			if (jobs.count > 0)
+			{
+				mutex_unlock(wheel.mtx);
+				for (auto job: jobs)
+					_fabric_submit_job(self, job);
+				buf_clear(jobs);
+				mutex_lock(wheel.mtx);
+				continue;
+			}
+
+			if (wheel.timers.items.count == 0)
+			{
+				wheel.wake_tick = UINT64_MAX;
+				cond_var_wait(wheel.cv, wheel.mtx);
+			}
+			else
+			{
+				wheel.wake_tick = _timer_wheel_next_tick(wheel);
+				auto sleep_time = wheel.wake_tick - now;
+				if (sleep_time > UINT32_MAX)
+					sleep_time = UINT32_MAX;
+				cond_var_wait_timeout(wheel.cv, wheel.mtx, uint32_t(sleep_time));
+			}
+			wheel.wake_tick = 0;
+		}
+		mutex_unlock(wheel.mtx);
+	}
+
+	// reserves a thread for the fabric, it returns false if the fabric has reached its max threads count
+	inline static bool
+	_fabric_reserve_thread(Fabric self)
+	{
+		auto count = self->atomic_threads_count.load();
+		do
+		{
+			if (count >= self->settings.max_threads_count)
+				return false;
+		} while (self->atomic_threads_count.compare_exchange_weak(count, count + 1) == false);
+		return true;
+	}
+
+	static void
+	_blocking_pool_main(void* fabric)
+	{
+		auto self = (Fabric)fabric;
+		auto& pool = self->blocking_pool;
+		LOCAL_BLOCKING_FABRIC = self;
+
+		auto tmp = memory::tmp();
+
+		mutex_lock(pool.mtx);
+		while (true)
+		{
+			++pool.idle_count;
+			cond_var_wait(pool.cv, pool.mtx, [&pool] { return pool.q.count > 0 || pool.is_running == false; });
+			--pool.idle_count;
+
+			if (pool.is_running == false)
+				break;
+
+			auto job = ring_front(pool.q);
+			ring_pop_front(pool.q);
+			mutex_unlock(pool.mtx);
+
+			auto tmp_checkpoint = tmp->checkpoint();
+			job->task();
+			_fabric_task_node_free(job);
+			tmp->restore(tmp_checkpoint);
+			tmp->trim();
+
+			mutex_lock(pool.mtx);
+		}
+		mutex_unlock(pool.mtx);
+	}
+
+	// links the given timer into the wheel and wakes the timer thread up if it expires before the thread wakes up
+	// the caller should have the wheel locked
+	inline static void
+	_fabric_timer_link_locked(Fabric self, Fabric_Timer_Node* node)
+	{
+		auto& wheel = self->timer_wheel;
+		_timer_wheel_link(wheel, node);
+
+		if (wheel.thread == nullptr)
+			wheel.thread = thread_new(_timer_main, self, self->timer_name.ptr);
+		else if (node->expires < wheel.wake_tick)
+			cond_var_notify(wheel.cv);
+	}
+
+	static void
+	_fabric_timer_rearm(Fabric self, Fabric_Timer_Node* node)
+	{
+		auto& wheel = self->timer_wheel;
+		mutex_lock(wheel.mtx);
+		mn_defer(mutex_unlock(wheel.mtx));
+
+		if (node->state == Fabric_Timer_Node::STATE_CANCELED)
+		{
+			fabric_task_free(node->task);
+			_timer_wheel_node_free(wheel, node);
+			return;
+		}
+
+		// skip the runs we've missed while the task was running
+		auto now = _timer_wheel_now(wheel);
+		node->expires += node->period;
+		if (node->expires <= now)
+			node->expires += ((now - node->expires) / node->period + 1) * node->period;
+		node->state = Fabric_Timer_Node::STATE_WAITING;
+		_fabric_timer_link_locked(self, node);
+	}
+
+	inline static Fabric_Timer
+	_fabric_timer_new(Fabric self, uint64_t delay_in_ms, uint64_t period_in_ms, const Fabric_Task& task)
+	{
+		auto& wheel = self->timer_wheel;
+		mutex_lock(wheel.mtx);
+		mn_defer(mutex_unlock(wheel.mtx));
+
+		auto node = _timer_wheel_node_new(wheel, task, _timer_wheel_now(wheel) + delay_in_ms, period_in_ms);
+		_fabric_timer_link_locked(self, node);
+		return Fabric_Timer{ node->handle };
+	}
+
+	static void
+	_io_main(void* fabric)
+	{
+		_disable_profiling_for_this_thread();
+
+		auto self = (Fabric)fabric;
+
+		auto jobs = buf_with_allocator<Fabric_Task*>(memory::clib());
+		mn_defer(buf_free(jobs));
+
+		while (self->atomic_io_running.load())
+		{
+			_fabric_poller_wait(self->io_poller, jobs);
+			for (auto job: jobs)
+				_fabric_submit_job(self, job);
+			buf_clear(jobs);
+		}
+	}
+
+	// checks the waiting tasks and schedules the ready ones, it returns whether it scheduled any of them
+	inline static bool
+	_fabric_poll_waiters(Fabric self)
+	{
+		if (self->atomic_waiters_count.load() == 0)
+			return false;
+
+		if (self->atomic_waiters_polling.exchange(true))
+			return false;
+		mn_defer(self->atomic_waiters_polling.store(false));
+
+		// take the waiters out so that the ready functions run without holding the lock
+		Buf<Fabric_Waiter> waiters{};
+		mutex_lock(self->waiters_mtx);
+		std::swap(waiters, self->waiters);
+		mutex_unlock(self->waiters_mtx);
+
+		// the still waiting ones are compacted in place so the pass is linear in the number of waiters
+		size_t waiting_count = 0;
+		for (size_t i = 0; i < waiters.count; ++i)
+		{
+			if (waiters[i].ready())
+			{
+				task_free(waiters[i].ready);
+				_fabric_submit_job(self, waiters[i].job);
+			}
+			else
+			{
+				waiters[waiting_count++] = waiters[i];
+			}
+		}
+		bool res = waiting_count < waiters.count;
+		buf_resize(waiters, waiting_count);
+
+		mutex_lock(self->waiters_mtx);
+		// put the still waiting ones before the ones which were added while we were polling
+		for (auto& waiter: self->waiters)
+			buf_push(waiters, waiter);
+		std::swap(waiters, self->waiters);
+		self->atomic_waiters_count.store(self->waiters.count);
+		mutex_unlock(self->waiters_mtx);
+		buf_free(waiters);
+		return res;
+	}
+
+	// returns how long the worker can sleep before it has to poll its suspended fibers and the waiting tasks
+	inline static Timeout
+	_worker_poll_timeout(Worker self)
+	{
+		if (self->fabric && self->fabric->atomic_waiters_count.load() > 0)
+			return Timeout{FIBER_POLL_INTERVAL_IN_MS};
+		return _worker_fibers_poll_timeout(self);
+	}
+
+	// parks the worker on its futex word until it's woken up, it returns a job if it finds one while it's going to sleep
+	inline static Fabric_Task*
+	_worker_park(Worker self)
+	{
+		// announce that we're going to sleep then check again for any work that was pushed
+		// before submitters could see our announcement
+		self->atomic_parked.store(1);
+
+		std::atomic<uint64_t>* bitmap_word = nullptr;
+		uint64_t bitmap_mask = 0;
+		if (self->fabric)
+		{
+			auto index = self->atomic_index.load(std::memory_order_relaxed);
+			bitmap_word = &self->fabric->sleeping_workers_bitmap[index / 64];
+			bitmap_mask = uint64_t(1) << (index % 64);
+			bitmap_word->fetch_or(bitmap_mask);
+		}
+
+		auto res = _worker_find_job(self);
+		if (res == nullptr)
+		{
+			_stats_inc(self->stats.parks);
+			while (self->atomic_parked.load() == 1 && self->atomic_state.load() == IWorker::STATE_RUNNING)
+			{
+				// signaled fibers might have been pushed before the signalers could see our announcement
+				if (self->atomic_ready_fibers.load() != nullptr)
+					break;
+
+				// suspended fibers, timed waits, and waiting tasks have to be checked so we might not sleep indefinitely
+				auto timeout = _worker_poll_timeout(self);
+				futex_wait(&self->atomic_parked, 1, timeout);
+				if (timeout != INFINITE_TIMEOUT)
+					break;
+			}
+
+			// wakers reset the futex word before they wake us up
+			if (self->atomic_parked.load() == 0)
+				_stats_inc(self->stats.unparks);
+		}
+
+		if (bitmap_word)
+			bitmap_word->fetch_and(~bitmap_mask);
+		self->atomic_parked.store(0);
+		return res;
+	}
+
+	// returns whether there are jobs the worker can see without locking or stealing
+	inline static bool
+	_worker_has_visible_jobs(Worker self)
+	{
+		if (_worker_local_q_count(self) > 0 || _worker_job_q_count(self) > 0)
+			return true;
+
+		if (self->fabric)
+		{
+			for (size_t i = 0; i < FABRIC_TASK_PRIORITY_COUNT; ++i)
+				if (mpmc_ring_count(self->fabric->injection_q[i]) > 0)
+					return true;
+		}
+		return false;
+	}
+
+	// an idle worker spins then yields looking for jobs before it parks, this way jobs which are submitted
+	// shortly after the worker goes idle are picked up without paying for a futex wake up
+	inline static Fabric_Task*
+	_worker_idle(Worker self)
+	{
+		uint32_t spin_count = 0;
+		uint32_t yield_count = 0;
+		if (self->fabric && self->fabric->settings.idle_strategy == FABRIC_IDLE_STRATEGY_SPIN_THEN_PARK)
+		{
+			spin_count = self->fabric->settings.idle_spin_count;
+			yield_count = self->fabric->settings.idle_yield_count;
+		}
+
+		for (uint32_t i = 0; i < spin_count; ++i)
+		{
+			_cpu_pause();
+			// go back to the worker loop to resume the signaled fibers
+			if (self->atomic_ready_fibers.load(std::memory_order_relaxed) != nullptr)
+				return nullptr;
+
+			// stealing touches other workers' cache lines so we only try it once in a while
+			if (_worker_has_visible_jobs(self) || i % 32 == 31)
+			{
+				if (auto res = _worker_find_job(self))
+					return res;
+			}
+
+			if (i % 32 == 31)
+			{
+				// go back to the worker loop to resume the ready fibers
+				if (_worker_has_suspended_fibers(self) && _worker_has_ready_fibers(self))
+					return nullptr;
+
+				if (self->fabric && _fabric_poll_waiters(self->fabric))
+				{
+					if (auto res = _worker_find_job(self))
+						return res;
+				}
+			}
+
+			if (self->atomic_state.load(std::memory_order_relaxed) != IWorker::STATE_RUNNING)
+				return nullptr;
+		}
+
+		for (uint32_t i = 0; i < yield_count; ++i)
+		{
+			thread_yield();
+			if (auto res = _worker_find_job(self))
+				return res;
+
+			if (_worker_has_suspended_fibers(self) && _worker_has_ready_fibers(self))
+				return nullptr;
+
+			if (self->fabric && _fabric_poll_waiters(self->fabric))
+			{
+				if (auto res = _worker_find_job(self))
+					return res;
+			}
+
+			if (self->atomic_state.load(std::memory_order_relaxed) != IWorker::STATE_RUNNING)
+				return nullptr;
+		}
+
+		return _worker_park(self);
+	}
+
+	inline static void
+	_worker_run_job(Worker self, Fabric_Task* job)
+	{
+		if (_worker_fibers_enabled(self) == false)
+		{
+			_worker_execute_job(self, job);
+			return;
+		}
+
+		Fiber* fiber = nullptr;
+		if (self->free_fibers.count > 0)
+		{
+			fiber = buf_top(self->free_fibers);
+			buf_pop(self->free_fibers);
+		}
+		else
+		{
+			fiber = _fiber_new(self->fabric->settings.fiber_stack_size);
+			fiber->worker = self;
+		}
+		fiber->job = job;
+		_worker_run_fiber(self, fiber);
+	}
+
+	// takes all the jobs of the given worker, it takes the job_q and steals everything in the local deques
+	inline static Ring<Fabric_Task*>
+	_worker_take_jobs(Worker self)
+	{
+		auto res = ring_new<Fabric_Task*>();
+		{
+			mutex_lock(self->mtx);
+			mn_defer(mutex_unlock(self->mtx));
+
+			for (size_t i = 0; i < FABRIC_TASK_PRIORITY_COUNT; ++i)
+			{
+				auto& job_q = self->job_q[i];
+				while (job_q.count > 0)
+				{
+					ring_push_back(res, ring_front(job_q));
+					ring_pop_front(job_q);
+				}
+				self->atomic_job_q_count[i].store(0);
+			}
+		}
+
+		for (size_t i = 0; i < FABRIC_TASK_PRIORITY_COUNT; ++i)
+			while (auto job = _task_deque_steal(self->local_q[i]))
+				ring_push_back(res, job);
+
+		return res;
+	}
+
+	// a paused worker gives back the jobs it has to the fabric so that they don't starve while it sleeps
+	inline static void
+	_worker_give_back_jobs(Worker self)
+	{
+		if (self->fabric == nullptr)
+			return;
+
+		auto jobs = buf_with_allocator<Fabric_Task*>(memory::tmp());
+		for (size_t i = 0; i < FABRIC_TASK_PRIORITY_COUNT; ++i)
+			while (auto job = _task_deque_pop(self->local_q[i]))
+				buf_push(jobs, job);
+
+		{
+			mutex_lock(self->mtx);
+			mn_defer(mutex_unlock(self->mtx));
+
+			for (size_t i = 0; i < FABRIC_TASK_PRIORITY_COUNT; ++i)
+			{
+				auto& job_q = self->job_q[i];
+				for (size_t j = 0; j < job_q.count; ++j)
+					buf_push(jobs, job_q[j]);
+				while (job_q.count > 0)
+					ring_pop_back(job_q);
+				self->atomic_job_q_count[i].store(0);
+			}
+		}
+
+		if (jobs.count == 0)
+			return;
+
+		auto fabric = self->fabric;
+		mutex_read_lock(fabric->workers_mtx);
+		mn_defer(mutex_read_unlock(fabric->workers_mtx));
+
+		for (auto job: jobs)
+		{
+			auto next_worker = fabric->atomic_next_worker.fetch_add(1) % fabric->workers.count;
+			_worker_push(fabric->workers[next_worker], job);
+		}
+		_fabric_wake_sleeping_worker_locked(fabric);
+	}
+
+	// pins the worker's thread to the cpu it should be on, if it changed
+	inline static void
+	_worker_sync_cpu(Worker self)
+	{
+		auto cpu = self->atomic_cpu.load(std::memory_order_relaxed);
+		if (cpu == self->pinned_cpu)
+			return;
+
+		// if pinning is not supported we still remember the cpu so we don't keep on trying
+		thread_pin_current(cpu);
+		self->pinned_cpu = cpu;
+	}
+
+	// reallocates the worker's queues from its own (pinned) thread so that the os places them on its numa node
+	inline static void
+	_worker_numa_rehome(Worker self)
+	{
+		for (size_t i = 0; i < FABRIC_TASK_PRIORITY_COUNT; ++i)
+		{
+			_task_deque_rebuffer(self->local_q[i], self->local_q[i].atomic_buffer.load(std::memory_order_relaxed)->cap);
+
+			mutex_lock(self->mtx);
+			auto& job_q = self->job_q[i];
+			ring_reserve(job_q, NUMA_LOCAL_JOB_Q_CAPACITY);
+			// touch the free slots as well, otherwise the first submitter to write them decides where they're placed
+			for (size_t j = job_q.count; j < job_q.cap; ++j)
+				job_q.ptr[(job_q.head + j) % job_q.cap] = nullptr;
+			mutex_unlock(self->mtx);
+		}
+	}
+
+	// frees the worker's per-thread memory while it's paused, since it might stay paused for a long time, the caller
+	// should make sure that no suspended fiber is using the tmp memory
+	inline static void
+	_worker_release_memory(Worker self)
+	{
+		for (auto fiber: self->free_fibers)
+			_fiber_free(fiber);
+		buf_clear(self->free_fibers);
+		memory::tmp()->free_all();
+	}
+
+	static void
+	_worker_main(void* worker)
+	{
+		auto self = (Worker)worker;
+		LOCAL_WORKER = self;
+
+		_worker_sync_cpu(self);
+		if (self->fabric && self->fabric->settings.numa_local_memory && self->pinned_cpu >= 0)
+			_worker_numa_rehome(self);
+
+		if (self->fabric)
+			if (self->fabric->settings.on_worker_start)
+				self->fabric->settings.on_worker_start();
+
+		bool released_memory = false;
+		while(true)
+		{
+			// sysmon changes the cpu of the workers it evicts or moves to another slot
+			_worker_sync_cpu(self);
+
+			auto state = self->atomic_state.load();
+			if (state == IWorker::STATE_RUNNING)
+			{
+				released_memory = false;
+
+				// signaled fibers continue right away, they don't wait for the polling below
+				_worker_resume_signaled_fibers(self);
+
+				auto job = _worker_find_job(self);
+
+				// give the suspended fibers and the waiting tasks a chance to continue every once in a while
+				// or when we run out of jobs
+				if (job == nullptr || self->schedule_tick % 16 == 0)
+				{
+					bool progress = false;
+					if (_worker_has_suspended_fibers(self))
+						progress |= _worker_resume_fibers(self);
+					if (self->fabric)
+						progress |= _fabric_poll_waiters(self->fabric);
+					if (progress && job == nullptr)
+						continue;
+				}
+
+				if (job == nullptr)
+					job = _worker_idle(self);
+
+				if (job)
+					_worker_run_job(self, job);
+			}
+			else if (state == IWorker::STATE_PAUSED)
+			{
+				_worker_give_back_jobs(self);
+
+				// suspended fibers are pinned to this worker so it keeps resuming them while it's paused
+				if (_worker_has_suspended_fibers(self))
+					_worker_resume_fibers(self);
+
+				if (released_memory == false && _worker_has_suspended_fibers(self) == false)
+				{
+					_worker_release_memory(self);
+					released_memory = true;
+				}
+
+				mutex_lock(self->mtx);
+				mn_defer(mutex_unlock(self->mtx));
+
+				// the signalers lock the mutex before they notify us so the ready list is checked under it
+				auto wake = [&]{
+					return self->atomic_state.load() != IWorker::STATE_PAUSED || self->atomic_ready_fibers.load() != nullptr;
+				};
+				auto timeout = _worker_fibers_poll_timeout(self);
+				self->atomic_paused_idle.store(true);
+				if (timeout == INFINITE_TIMEOUT)
+					cond_var_wait(self->cv, self->mtx, wake);
+				else if (wake() == false)
+					cond_var_wait_timeout(self->cv, self->mtx, uint32_t(timeout.milliseconds));
+				self->atomic_paused_idle.store(false);
+			}
+			else if (state == IWorker::STATE_STOP_REQUEST)
+			{
+				break;
+			}
+			else
+			{
+				mn_unreachable();
+			}
+		}
+
+		[[maybe_unused]] auto old_state = self->atomic_state.exchange(IWorker::STATE_STOP_ACKNOWLEDGED);
+		mn_assert(old_state == IWorker::STATE_STOP_REQUEST);
+		LOCAL_WORKER = nullptr;
+	}
+
+	inline static void
+	_worker_stop(Worker self)
+	{
+		mutex_lock(self->mtx);
+		mn_defer(mutex_unlock(self->mtx));
+
+		self->atomic_state = IWorker::STATE_STOP_REQUEST;
+		cond_var_notify(self->cv);
+		_worker_wake(self);
+	}
+
+	inline static void
+	_worker_pause(Worker self)
+	{
+		mutex_lock(self->mtx);
+		mn_defer(mutex_unlock(self->mtx));
+
+		mn_assert(self->atomic_state == IWorker::STATE_RUNNING);
+
+		self->atomic_state = IWorker::STATE_PAUSED;
+		cond_var_notify(self->cv);
+		_worker_wake(self);
+	}
+
+	inline static void
+	_worker_resume(Worker self)
+	{
+		mutex_lock(self->mtx);
+		mn_defer(mutex_unlock(self->mtx));
+
+		mn_assert(self->atomic_state == IWorker::STATE_PAUSED);
+
+		self->atomic_paused_idle = false;
+		self->atomic_state = IWorker::STATE_RUNNING;
+		cond_var_notify(self->cv);
+	}
+
+	// returns the cpu the worker in the given slot should be pinned to, or -1 if the workers are not pinned
+	inline static int32_t
+	_fabric_worker_cpu(Fabric self, size_t index)
+	{
+		if (self == nullptr || index >= self->workers_cpus.count)
+			return -1;
+		return self->workers_cpus[index].id;
+	}
+
+	inline static Worker
+	_worker_new(Str name, Fabric fabric, size_t index = 0)
+	{
+		auto self = alloc_zerod<IWorker>();
+		self->name = name;
+		self->mtx = mn_mutex_new_with_srcloc(self->name.ptr);
+		self->cv = cond_var_new();
+		self->fabric = fabric;
+		for (size_t i = 0; i < FABRIC_TASK_PRIORITY_COUNT; ++i)
+		{
+			self->job_q[i] = ring_new<Fabric_Task*>();
+			_task_deque_init(self->local_q[i]);
+		}
+		self->atomic_index = index;
+		self->atomic_cpu = _fabric_worker_cpu(fabric, index);
+		self->pinned_cpu = -1;
+		self->free_fibers = buf_with_allocator<Fiber*>(memory::clib());
+		self->suspended_fibers = buf_with_allocator<Fiber*>(memory::clib());
+		self->waiting_fibers = buf_with_allocator<Fiber*>(memory::clib());
+		self->fibers_scratch = buf_with_allocator<Fiber*>(memory::clib());
+		self->random_state = (uint64_t)(uintptr_t)self | 1;
+		self->atomic_state = IWorker::STATE_RUNNING;
+		self->atomic_disable_block_timing = true;
+		self->thread = thread_new(_worker_main, self, self->name.ptr);
+		return self;
+	}
+
+	// waits for the stopped worker's thread to exit
+	inline static void
+	_worker_join(Worker self)
+	{
+		if (self->thread == nullptr)
+			return;
+
+		thread_join(self->thread);
+		thread_free(self->thread);
+		self->thread = nullptr;
+	}
+
+	inline static void
+	_worker_free(Worker self)
+	{
+		[[maybe_unused]] auto state = self->atomic_state.load();
+		mn_assert(state == IWorker::STATE_STOP_REQUEST ||
+			   state == IWorker::STATE_STOP_ACKNOWLEDGED);
+
+		_worker_join(self);
+
+		for (size_t i = 0; i < FABRIC_TASK_PRIORITY_COUNT; ++i)
+		{
+			while (auto job = _task_deque_pop(self->local_q[i]))
+				_fabric_task_node_free(job);
+			_task_deque_free(self->local_q[i]);
+
+			for (size_t j = 0; j < self->job_q[i].count; ++j)
+				_fabric_task_node_free(self->job_q[i][j]);
+			ring_free(self->job_q[i]);
+		}
+
+		// the jobs of the suspended fibers can't continue at this point so they're just freed
+		for (auto fiber: self->suspended_fibers)
+			_fiber_free(fiber);
+		buf_free(self->suspended_fibers);
+		for (auto fiber: self->waiting_fibers)
+			_fiber_free(fiber);
+		buf_free(self->waiting_fibers);
+		buf_free(self->fibers_scratch);
+		for (auto fiber: self->free_fibers)
+			_fiber_free(fiber);
+		buf_free(self->free_fibers);
+
+		str_free(self->name);
+		mutex_free(self->mtx);
+		cond_var_free(self->cv);
+
+		free(self);
+	}
+
+	// Fabric
+	struct Blocking_Worker
+	{
+		Worker worker;
+		size_t index;
+		// whether the worker announced that it's blocking via worker_block_ahead
+		bool is_coop;
+		// the spare worker which replaces it, or nullptr if a new worker is created for it
+		Worker replacement;
+	};
+
+	// what sysmon remembers about a worker slot between its checks
+	struct Sysmon_Slot
+	{
+		Worker worker;
+		// when the worker started the job or the block it's busy with
+		uint64_t busy_since;
+		// when sysmon first saw tasks waiting behind the busy worker
+		uint64_t stalled_since;
+	};
+
+	// takes one of the paused workers which can be resumed in a slot, the surplus workers are preferred over the ready
+	// side workers, only the workers which are idle in their paused loop are taken since the others are still busy
+	// with the job they were running when they were paused, it returns nullptr if there are none
+	inline static Worker
+	_sysmon_spare_worker_pop(Fabric self)
+	{
+		mutex_lock(self->side_workers_mtx);
+		mn_defer(mutex_unlock(self->side_workers_mtx));
+
+		for (auto spares: {&self->surplus_workers, &self->ready_side_workers})
+		{
+			for (size_t i = spares->count; i > 0; --i)
+			{
+				auto worker = (*spares)[i - 1];
+				if (worker->atomic_paused_idle.load())
+				{
+					buf_remove_ordered(*spares, i - 1);
+					return worker;
+				}
+			}
+		}
+		return nullptr;
+	}
+
+	// resumes the given spare worker in the given slot, or creates a new worker if there's none, the caller should
+	// have the workers list write locked and should have reserved a thread in case there's no spare worker
+	inline static Worker
+	_sysmon_worker_for_slot(Fabric self, size_t index, Worker spare)
+	{
+		if (spare)
+		{
+			// the index is set before the worker resumes so that it parks in the right bitmap slot
+			spare->atomic_index.store(index, std::memory_order_relaxed);
+			spare->atomic_cpu.store(_fabric_worker_cpu(self, index), std::memory_order_relaxed);
+			_worker_resume(spare);
+			return spare;
+		}
+
+		return _worker_new(
+			strf("{} worker #{}", self->name, self->worker_id_generator++),
+			self,
+			index
+		);
+	}
+
+	// replaces the given blocking workers with new workers and moves the jobs over to the new workers
+	inline static void
+	_sysmon_evict_blocking_workers(Fabric self, Buf<Blocking_Worker>& blocking_workers)
+	{
+		// each blocking worker is replaced by a spare worker or a new thread, the ones which can't get either
+		// because the fabric reached its max threads count stay in place
+		buf_remove_if(blocking_workers, [self](Blocking_Worker& blocking_worker) {
+			blocking_worker.replacement = _sysmon_spare_worker_pop(self);
+			if (blocking_worker.replacement)
+				return false;
+
+			if (_fabric_reserve_thread(self))
+				return false;
+
+			self->atomic_skipped_evictions.fetch_add(1, std::memory_order_relaxed);
+			return true;
+		});
+
+		// pause all the blocking workers, they give up their cpu to their replacements once they unblock
+		for (auto blocking_worker: blocking_workers)
+		{
+			blocking_worker.worker->atomic_cpu.store(-1, std::memory_order_relaxed);
+			_worker_pause(blocking_worker.worker);
+		}
+
+		// move the blocking workers out
+		for (auto blocking_worker: blocking_workers)
+		{
+			Worker new_worker = nullptr;
+			{
+				mutex_write_lock(self->workers_mtx);
+				mn_defer(mutex_write_unlock(self->workers_mtx));
+
+				new_worker = _sysmon_worker_for_slot(self, blocking_worker.index, blocking_worker.replacement);
+				self->workers[blocking_worker.index] = new_worker;
+			}
+
+			// now that no one can submit to the blocking worker, we move its jobs to the new worker
+			auto job_q = _worker_take_jobs(blocking_worker.worker);
+			if (job_q.count > 0)
+			{
+				mutex_lock(new_worker->mtx);
+				for (size_t i = 0; i < job_q.count; ++i)
+					_worker_enqueue_locked(new_worker, job_q[i]);
+				mutex_unlock(new_worker->mtx);
+				_worker_wake(new_worker);
+			}
+			ring_free(job_q);
+		}
+
+		// now that we have replaced all the blocking workers with a newly created workers
+		// we need to store the blocking workers away to be reused later in the replacement above
+		mutex_lock(self->side_workers_mtx);
+		for (auto blocking_worker: blocking_workers)
+			buf_push(self->sleepy_side_workers, blocking_worker.worker);
+		mutex_unlock(self->side_workers_mtx);
+		self->atomic_blocking_evictions.fetch_add(blocking_workers.count, std::memory_order_relaxed);
+
+		// clear the blocking workers list
+		buf_clear(blocking_workers);
+	}
+
+	// detects the workers which are busy while tasks wait behind them for longer than the blocking thresholds, it
+	// measures how long the tasks have been waiting instead of how long the job has been running, so a long running
+	// job which doesn't hold anything up doesn't cost a thread, it returns the longest time the tasks have been waiting
+	inline static uint64_t
+	_sysmon_detect_blocking_workers(Fabric self, Buf<Sysmon_Slot>& slots, Buf<Blocking_Worker>& blocking_workers)
+	{
+		auto now = time_in_millis();
+
+		// the tasks in the injection queue are waiting behind all the busy workers if none of the workers is parked
+		bool injection_q_waiting = false;
+		if (_fabric_has_sleeping_workers(self) == false)
+		{
+			for (size_t i = 0; i < FABRIC_TASK_PRIORITY_COUNT; ++i)
+				if (mpmc_ring_count(self->injection_q[i]) > 0)
+					injection_q_waiting = true;
+		}
+
+		uint64_t longest_wait = 0;
+		size_t coop_blocking_count = 0;
+		for (size_t i = 0; i < self->workers.count; ++i)
+		{
+			auto worker = self->workers[i];
+			auto& slot = slots[i];
+			if (slot.worker != worker)
+				slot = Sysmon_Slot{ worker, 0, 0 };
+
+			uint64_t busy_since = 0;
+			bool is_coop = false;
+			if (worker->atomic_current_job_flags.load() == FABRIC_TASK_FLAG_NONE)
+			{
+				auto block_start_time = worker->atomic_block_start_time_in_ms.load();
+				auto job_start_time = worker->atomic_job_start_time_in_ms.load();
+				is_coop = block_start_time != 0;
+				busy_since = is_coop ? block_start_time : job_start_time;
+			}
+
+			if (busy_since == 0 || (injection_q_waiting == false && _worker_queue_depth(worker) == 0))
+			{
+				slot.busy_since = 0;
+				slot.stalled_since = 0;
+				continue;
+			}
+
+			if (slot.busy_since != busy_since)
+			{
+				slot.busy_since = busy_since;
+				slot.stalled_since = now;
+			}
+
+			auto wait = now - slot.stalled_since;
+			if (wait > longest_wait)
+				longest_wait = wait;
+
+			auto threshold = is_coop ? self->settings.coop_blocking_threshold_in_ms : self->settings.external_blocking_threshold_in_ms;
+			if (wait > threshold)
+			{
+				buf_push(blocking_workers, Blocking_Worker{ worker, i, is_coop, nullptr });
+				if (is_coop)
+					++coop_blocking_count;
+			}
+		}
+
+		// if we have some free workers then it's okay for workers to block cooperatively, this is normal
+		// we only care about total system blocking
+		if (coop_blocking_count > 0 && coop_blocking_count < self->workers.count * self->settings.blocking_workers_threshold)
+			buf_remove_if(blocking_workers, [](const Blocking_Worker& w) { return w.is_coop; });
+
+		_sysmon_evict_blocking_workers(self, blocking_workers);
+		return longest_wait;
+	}
+
+	// adds a worker to the end of the workers list, it returns false if the fabric reached its max threads count
+	inline static bool
+	_sysmon_grow_workers(Fabric self)
+	{
+		auto spare = _sysmon_spare_worker_pop(self);
+		if (spare == nullptr && _fabric_reserve_thread(self) == false)
+			return false;
+
+		mutex_write_lock(self->workers_mtx);
+		mn_defer(mutex_write_unlock(self->workers_mtx));
+
+		// the workers list has the capacity for the max workers count so readers never see it reallocate
+		auto index = self->workers.count;
+		buf_push(self->workers, _sysmon_worker_for_slot(self, index, spare));
+		return true;
+	}
+
+	// takes a parked worker out of the workers list and pauses it, it gives its jobs back to the other workers and
+	// frees its per-thread memory, then it waits in the surplus workers list until the fabric grows again
+	// it returns false if none of the workers is parked
+	inline static bool
+	_sysmon_shrink_workers(Fabric self)
+	{
+		mutex_write_lock(self->workers_mtx);
+		mn_defer(mutex_write_unlock(self->workers_mtx));
+
+		// a busy worker might be in the middle of a job which would keep running while it's paused, so we only
+		// take a parked one, it's swapped into the last slot first so that the slots stay packed
+		size_t index = self->workers.count;
+		for (size_t i = self->workers.count; i > 0; --i)
+		{
+			if (self->workers[i - 1]->atomic_parked.load() != 0)
+			{
+				index = i - 1;
+				break;
+			}
+		}
+		if (index == self->workers.count)
+			return false;
+
+		auto worker = self->workers[index];
+		auto last = buf_top(self->workers);
+		if (last != worker)
+		{
+			self->workers[index] = last;
+			last->atomic_index.store(index, std::memory_order_relaxed);
+			last->atomic_cpu.store(_fabric_worker_cpu(self, index), std::memory_order_relaxed);
+			// the moved worker might be parked in the sleeping bitmap slot of its old index which the wakers don't
+			// look at anymore, so we wake it up to park again in its new slot
+			_worker_wake(last);
+		}
+		buf_pop(self->workers);
+
+		// the worker moves to the surplus list before the workers list is unlocked so that fabric_stats always
+		// finds it in one of them
+		worker->atomic_cpu.store(-1, std::memory_order_relaxed);
+		_worker_pause(worker);
+
+		mutex_lock(self->side_workers_mtx);
+		buf_push(self->surplus_workers, worker);
+		mutex_unlock(self->side_workers_mtx);
+		return true;
+	}
+
+	// grows the workers count when the tasks wait behind the busy workers, and shrinks it when some of the workers
+	// have been idle for the idle timeout, it returns the updated time since when the fabric has been idle
+	inline static uint64_t
+	_sysmon_scale_workers(Fabric self, uint64_t longest_wait, uint64_t idle_since)
+	{
+		if (longest_wait >= WORKERS_GROW_QUEUE_WAIT_IN_MS)
+		{
+			if (self->workers.count < self->settings.max_workers_count)
+				_sysmon_grow_workers(self);
+			return 0;
+		}
+
+		size_t parked_count = 0;
+		for (auto worker: self->workers)
+			if (worker->atomic_parked.load() != 0)
+				++parked_count;
+
+		if (parked_count == 0)
+			return 0;
+
+		auto now = time_in_millis();
+		if (idle_since == 0)
+			return now;
+
+		if (now - idle_since >= self->settings.worker_idle_timeout_in_ms &&
+			self->workers.count > self->settings.min_workers_count &&
+			_sysmon_shrink_workers(self))
+		{
+			return now;
+		}
+		return idle_since;
+	}
+
+	static void
+	_sysmon_main(void* fabric)
+	{
+		_disable_profiling_for_this_thread();
+
+		auto self = (Fabric)fabric;
+
+		// workers who held up the tasks waiting behind them for longer than the blocking thresholds
+		auto blocking_workers = buf_with_capacity<Blocking_Worker>(self->workers.count);
+		mn_defer(buf_free(blocking_workers));
+
+		auto slots = buf_with_count<Sysmon_Slot>(self->settings.max_workers_count);
+		mn_defer(buf_free(slots));
+		for (auto& slot: slots)
+			slot = Sysmon_Slot{};
+
+		auto dead_workers = buf_with_capacity<Worker>(self->workers.count);
+		mn_defer(destruct(dead_workers));
+
+		// since when some of the workers have been idle, it's 0 while all the workers are busy
+		uint64_t idle_since = 0;
+
+		auto timeslice = self->settings.coop_blocking_threshold_in_ms;
+		if (timeslice > self->settings.external_blocking_threshold_in_ms)
+			timeslice = self->settings.external_blocking_threshold_in_ms;
+
+		timeslice /= 2;
+		if (timeslice == 0)
+			timeslice = 1;
+
+		while(true)
+		{
+			// dispose of dead workers before holding the mutex
+			buf_remove_if(dead_workers, [self](Worker worker){
+				auto state = worker->atomic_state.load();
+
+				if (state == IWorker::STATE_STOP_REQUEST)
+					return false;
+
+				mn_assert(state == IWorker::STATE_STOP_ACKNOWLEDGED);
+				_worker_free(worker);
+				self->atomic_threads_count.fetch_sub(1);
+				return true;
+			});
+
+			bool slept_on_cond_var = false;
+
+			{
+				mutex_lock(self->mtx);
+				mn_defer(mutex_unlock(self->mtx));
+
+				// announce that we're going to sleep before checking the available jobs, submitters
+				// will only notify us if we're sleeping
+				self->atomic_sysmon_sleeping.store(true);
+				if (self->atomic_available_jobs.load() <= 0 &&
+					self->sleepy_side_workers.count == 0)
+				{
+					slept_on_cond_var = true;
+					if (self->workers.count > self->settings.min_workers_count)
+					{
+						// the fabric can shrink while it's idle so we only sleep until the idle timeout
+						if (idle_since == 0)
+							idle_since = time_in_millis();
+						cond_var_wait_timeout(self->cv, self->mtx, self->settings.worker_idle_timeout_in_ms);
+					}
+					else
+					{
+						cond_var_wait(self->cv, self->mtx, [&]{
+							return self->atomic_available_jobs.load() > 0 ||
+								self->is_running == false ||
+								self->sleepy_side_workers.count > 0;
+						});
+					}
+				}
+				self->atomic_sysmon_sleeping.store(false);
+
+				if (self->is_running == false)
+					return;
+			}
+
+			// SYSMON rest station, sysmon needs to sleep for some time, he does a lot of work, he deserves it
+			// load balancing is done by the workers themselves through work stealing, sysmon only cares
+			// about the blocking workers
+			if (slept_on_cond_var == false)
+				thread_sleep(timeslice);
+
+			// check if any sleepy worker is ready and move it either to the ready workers list
+			// or free it because we don't really need it
+			mutex_lock(self->side_workers_mtx);
+			buf_remove_if(self->sleepy_side_workers, [self, &dead_workers](Worker worker) {
+				if (worker->atomic_paused_idle.load())
+				{
+					if (self->ready_side_workers.count < self->settings.put_aside_worker_count)
+					{
+						buf_push(self->ready_side_workers, worker);
+					}
+					else
+					{
+						_worker_stop(worker);
+						_stats_accumulate(self->retired_stats, worker->stats);
+						buf_push(dead_workers, worker);
+					}
+					return true;
+				}
+				return false;
+			});
+			mutex_unlock(self->side_workers_mtx);
+
+			auto longest_wait = _sysmon_detect_blocking_workers(self, slots, blocking_workers);
+			if (self->settings.min_workers_count < self->settings.max_workers_count)
+				idle_since = _sysmon_scale_workers(self, longest_wait, idle_since);
+		}
+	}
+
+
+	// API
+	Worker
+	worker_new(const char* name)
+	{
+		return _worker_new(str_from_c(name), nullptr);
+	}
+
+	void
+	worker_free(Worker self)
+	{
+		_worker_stop(self);
+		_worker_free(self);
+	}
+
+	void
+	worker_task_do(Worker self, const Fabric_Task& task)
+	{
+		_worker_push(self, _fabric_task_node_new(task));
+	}
+
+	void
+	worker_task_batch_do(Worker self, const Fabric_Task* ptr, size_t count)
+	{
+		auto tasks = buf_with_allocator<Fabric_Task*>(memory::tmp());
+		buf_reserve(tasks, count);
+		for (size_t i = 0; i < count; ++i)
+			buf_push(tasks, _fabric_task_node_new(ptr[i]));
+		_worker_push_batch(self, tasks.ptr, tasks.count);
+	}
+
+	Worker
+	worker_local()
+	{
+		return LOCAL_WORKER;
+	}
+
+	void
+	worker_block_ahead()
+	{
+		if (LOCAL_WORKER == nullptr)
+			return;
+
+		if (LOCAL_WORKER->atomic_disable_block_timing.load() == true)
+			return;
+
+		LOCAL_WORKER->atomic_block_start_time_in_ms.store(time_in_millis());
+	}
+
+	void
+	worker_block_clear()
+	{
+		if (LOCAL_WORKER == nullptr)
+			return;
+
+		if (LOCAL_WORKER->atomic_disable_block_timing.load() == true)
+			return;
+
+		LOCAL_WORKER->atomic_block_start_time_in_ms.store(0);
+	}
+
+	bool
+	worker_on_fiber()
+	{
+		return LOCAL_WORKER != nullptr && LOCAL_WORKER->current_fiber != nullptr;
+	}
+
+	// switches the calling fiber out to its worker until the worker resumes it, the job isn't running while its fiber
+	// is suspended so sysmon shouldn't consider the worker blocked on it
+	inline static void
+	_worker_suspend_fiber(Worker self, Fiber* fiber)
+	{
+		auto flags = self->atomic_current_job_flags.load();
+		self->atomic_disable_block_timing = true;
+		self->atomic_job_start_time_in_ms.store(0);
+		self->atomic_current_job_flags.store(FABRIC_TASK_FLAG_NONE);
+
+		_fiber_switch_to_worker(fiber, self);
+
+		self->atomic_job_start_time_in_ms.store(time_in_millis());
+		self->atomic_disable_block_timing = false;
+		self->atomic_current_job_flags.store(flags);
+	}
+
+	// puts the given waiting fiber on its worker's ready list and wakes the worker up, it's called by the signalers
+	// from any thread
+	inline static void
+	_fiber_ready(Fiber* fiber)
+	{
+		auto worker = fiber->worker;
+		fiber->next_ready = worker->atomic_ready_fibers.load(std::memory_order_relaxed);
+		while (worker->atomic_ready_fibers.compare_exchange_weak(fiber->next_ready, fiber) == false)
+		{}
+
+		if (_worker_wake(worker))
+			return;
+
+		// paused workers wait on their condition variable and check the ready list under the mutex
+		if (worker->atomic_state.load() == IWorker::STATE_PAUSED)
+		{
+			mutex_lock(worker->mtx);
+			cond_var_notify(worker->cv);
+			mutex_unlock(worker->mtx);
+		}
+	}
+
+	// marks the waiter's sleeper as a thread which sleeps on the futex word
+	static char WORKER_WAITER_THREAD_SLEEPER;
+	// marks the waiter as signaled so that the sleepers which come late don't sleep
+	static char WORKER_WAITER_SIGNALED;
+
+	void
+	_worker_waiter_signal(Worker_Waiter* self)
+	{
+		if (self->atomic_signaled.exchange(1) == 1)
+			return;
+
+		// the sleeper is taken at the end since the fibers might leave as soon as they see the waiter signaled
+		auto sleeper = self->atomic_sleeper.exchange(&WORKER_WAITER_SIGNALED);
+		if (sleeper == &WORKER_WAITER_THREAD_SLEEPER)
+			futex_wake_one(&self->atomic_signaled);
+		else if (sleeper == self)
+			_fabric_submit_job(self->fabric, self->job);
+		else if (sleeper != nullptr)
+			_fiber_ready((Fiber*)sleeper);
+	}
+
+	bool
+	_worker_waiter_arm(Worker_Waiter* self, Fabric fabric, const Fabric_Task& task)
+	{
+		self->fabric = fabric;
+		self->job = _fabric_task_node_new(task);
+
+		// an armed waiter is its own sleeper, the signal takes it and submits the job
+		void* sleeper = nullptr;
+		if (self->atomic_sleeper.compare_exchange_strong(sleeper, self))
+			return true;
+
+		_fabric_task_node_free(self->job);
+		self->job = nullptr;
+		return false;
+	}
+
+	bool
+	_worker_waiter_wait(Worker_Waiter* self, uint64_t deadline)
+	{
+		auto worker = LOCAL_WORKER;
+		if (worker && worker->current_fiber)
+		{
+			if (deadline != UINT64_MAX && time_in_millis() >= deadline)
+				return self->atomic_signaled.load() == 1;
+
+			auto fiber = worker->current_fiber;
+			fiber->waiter = self;
+			fiber->deadline = deadline;
+
+			// publish the fiber, if the waiter is already signaled we don't suspend, otherwise the signal or the
+			// timeout takes the fiber back from the waiter and resumes it exactly once
+			void* sleeper = nullptr;
+			if (self->atomic_sleeper.compare_exchange_strong(sleeper, fiber))
+			{
+				fiber->waiting_index = worker->waiting_fibers.count;
+				buf_push(worker->waiting_fibers, fiber);
+				if (deadline != UINT64_MAX)
+					++worker->timed_fibers_count;
+
+				_worker_suspend_fiber(worker, fiber);
+
+				auto last = buf_top(worker->waiting_fibers);
+				worker->waiting_fibers[fiber->waiting_index] = last;
+				last->waiting_index = fiber->waiting_index;
+				buf_pop(worker->waiting_fibers);
+				if (deadline != UINT64_MAX)
+					--worker->timed_fibers_count;
+			}
+
+			fiber->waiter = nullptr;
+			fiber->deadline = 0;
+			return self->atomic_signaled.load() == 1;
+		}
+
+		self->atomic_sleeper.store(&WORKER_WAITER_THREAD_SLEEPER);
+		worker_block_ahead();
+		while (self->atomic_signaled.load() == 0)
+		{
+			auto timeout = INFINITE_TIMEOUT;
+			if (deadline != UINT64_MAX)
+			{
+				auto now = time_in_millis();
+				if (now >= deadline)
+					break;
+				timeout = Timeout{deadline - now};
+			}
+			futex_wait(&self->atomic_signaled, 0, timeout);
+		}
+		worker_block_clear();
+		return self->atomic_signaled.load() == 1;
+	}
+
+	bool
+	_worker_suspend_until(bool (*ready)(void*), void* arg)
+	{
+		auto self = LOCAL_WORKER;
+		if (self == nullptr || self->current_fiber == nullptr)
+			return false;
+
+		if (ready(arg))
+			return true;
+
+		auto fiber = self->current_fiber;
+		fiber->ready = ready;
+		fiber->ready_arg = arg;
+		buf_push(self->suspended_fibers, fiber);
+
+		_worker_suspend_fiber(self, fiber);
+
+		fiber->ready = nullptr;
+		fiber->ready_arg = nullptr;
+		return true;
+	}
+
+	// worker signal
+	struct IWorker_Signal
+	{
+		// incremented on every notify, the blocked threads sleep on it
+		std::atomic<int32_t> atomic_epoch;
+		// number of the threads which are sleeping on the epoch
+		std::atomic<int32_t> atomic_sleepers;
+		// number of the fibers which are suspended on the signal
+		std::atomic<int32_t> atomic_fibers;
+		// the waiters of the suspended fibers, they're signaled on notify which resumes the fibers on their workers
+		Mutex mtx;
+		Buf<Worker_Waiter*> fiber_waiters;
+	};
+
+	Worker_Signal
+	worker_signal_new()
+	{
+		auto self = alloc_zerod_from<IWorker_Signal>(memory::clib());
+		self->mtx = mn_mutex_new_with_srcloc("worker signal mutex");
+		self->fiber_waiters = buf_with_allocator<Worker_Waiter*>(memory::clib());
+		return self;
+	}
+
+	void
+	worker_signal_free(Worker_Signal self)
+	{
+		if (self == nullptr)
+			return;
+
+		mn_assert(self->atomic_sleepers.load() == 0 && self->atomic_fibers.load() == 0);
+		mutex_free(self->mtx);
+		buf_free(self->fiber_waiters);
+		free_from(memory::clib(), self);
+	}
+
+	void
+	_worker_signal_waiter_add(Worker_Signal self, Worker_Waiter* waiter)
+	{
+		mutex_lock(self->mtx);
+		buf_push(self->fiber_waiters, waiter);
+		self->atomic_fibers.fetch_add(1);
+		mutex_unlock(self->mtx);
+	}
+
+	void
+	_worker_signal_waiter_remove(Worker_Signal self, Worker_Waiter* waiter)
+	{
+		// the notifiers touch the waiter while they hold the mutex so it's safe to go out of scope after this
+		mutex_lock(self->mtx);
+		for (size_t i = 0; i < self->fiber_waiters.count; ++i)
+		{
+			if (self->fiber_waiters[i] == waiter)
+			{
+				buf_remove(self->fiber_waiters, i);
+				self->atomic_fibers.fetch_sub(1);
+				break;
+			}
+		}
+		mutex_unlock(self->mtx);
+	}
+
+	void
+	worker_signal_notify(Worker_Signal self)
+	{
+		// the waiters register themselves after they read the epoch, so either they see the new epoch and don't sleep
+		// or we see them registered and wake them up
+		self->atomic_epoch.fetch_add(1);
+		if (self->atomic_sleepers.load() > 0)
+			futex_wake_all(&self->atomic_epoch);
+
+		if (self->atomic_fibers.load() > 0)
+		{
+			mutex_lock(self->mtx);
+			for (auto waiter: self->fiber_waiters)
+				_worker_waiter_signal(waiter);
+			mutex_unlock(self->mtx);
+		}
+	}
+
+	bool
+	_worker_block_on_signal(Worker_Signal self, Timeout timeout, bool (*ready)(void*), void* arg)
+	{
+		if (ready(arg))
+			return true;
+
+		if (timeout == NO_TIMEOUT)
+			return false;
+
+		auto deadline = UINT64_MAX;
+		if (timeout != INFINITE_TIMEOUT)
+			deadline = time_in_millis() + timeout.milliseconds;
+
+		if (worker_on_fiber())
+		{
+			Worker_Waiter waiter{};
+			while (true)
+			{
+				// register before checking the condition again so that we don't miss the notifications in between
+				_worker_waiter_reset(&waiter);
+				_worker_signal_waiter_add(self, &waiter);
+
+				auto res = ready(arg);
+				if (res == false)
+					_worker_waiter_wait(&waiter, deadline);
+
+				_worker_signal_waiter_remove(self, &waiter);
+
+				if (res || ready(arg))
+					return true;
+				if (deadline != UINT64_MAX && time_in_millis() >= deadline)
+					return false;
+			}
+		}
+
+		worker_block_ahead();
+		mn_defer(worker_block_clear());
+		while (true)
+		{
+			auto epoch = self->atomic_epoch.load();
+			if (ready(arg))
+				return true;
+
+			auto wait_timeout = INFINITE_TIMEOUT;
+			if (deadline != UINT64_MAX)
+			{
+				auto now = time_in_millis();
+				if (now >= deadline)
+					return false;
+				wait_timeout = Timeout{deadline - now};
+			}
+
+			self->atomic_sleepers.fetch_add(1);
+			futex_wait(&self->atomic_epoch, epoch, wait_timeout);
+			self->atomic_sleepers.fetch_sub(1);
+		}
+	}
+
+	// runs other jobs on top of the calling job until the given function returns true, it returns false if the caller
+	// isn't a running worker or if it runs out of jobs for a while, in which case the caller should block instead
+	inline static bool
+	_worker_help_until(bool (*ready)(void*), void* arg)
+	{
+		auto self = LOCAL_WORKER;
+		if (self == nullptr)
+			return false;
+
+		uint32_t spin_count = DEFAULT_IDLE_SPIN_COUNT;
+		uint32_t yield_count = DEFAULT_IDLE_YIELD_COUNT;
+		if (self->fabric)
+		{
+			spin_count = self->fabric->settings.idle_spin_count;
+			yield_count = self->fabric->settings.idle_yield_count;
+		}
+
+		uint32_t idle_count = 0;
+		while (ready(arg) == false)
+		{
+			// evicted workers shouldn't take any more jobs
+			if (self->atomic_state.load() != IWorker::STATE_RUNNING)
+				return false;
+
+			if (auto job = _worker_find_job(self))
+			{
+				// the nested job takes over the sysmon timing of the waiting job until it finishes
+				auto flags = self->atomic_current_job_flags.load();
+				auto start_time = self->atomic_job_start_time_in_ms.load();
+				++self->nested_jobs_depth;
+				_worker_execute_job(self, job);
+				--self->nested_jobs_depth;
+				self->atomic_current_job_flags.store(flags);
+				self->atomic_job_start_time_in_ms.store(start_time);
+				self->atomic_disable_block_timing = false;
+				idle_count = 0;
+				continue;
+			}
+
+			if (++idle_count > spin_count + yield_count)
+				return false;
+
+			if (idle_count <= spin_count)
+				_cpu_pause();
+			else
+				thread_yield();
+		}
+		return true;
+	}
+
+
+	// assigns a cpu to each worker slot, the first SMT thread of each core is used before the second one, and the cores
+	// are ordered by node and last level cache so that consecutive workers are close to each other
+	inline static void
+	_fabric_place_workers(Fabric self)
+	{
+		auto topology = topology_new();
+		mn_defer(topology_free(topology));
+
+		auto cpus = buf_with_allocator<Topology_CPU>(memory::tmp());
+		auto smt_ranks = buf_with_allocator<size_t>(memory::tmp());
+		for (const auto& cpu: topology.cpus)
+		{
+			size_t smt_rank = 0;
+			for (const auto& other: topology.cpus)
+				if (other.id < cpu.id && topology_cpu_smt_siblings(cpu, other))
+					++smt_rank;
+			buf_push(cpus, cpu);
+			buf_push(smt_ranks, smt_rank);
+		}
+
+		auto order = buf_with_allocator<size_t>(memory::tmp());
+		for (size_t i = 0; i < cpus.count; ++i)
+			buf_push(order, i);
+		std::sort(order.ptr, order.ptr + order.count, [&](size_t a, size_t b) {
+			const auto& x = cpus[a];
+			const auto& y = cpus[b];
+			if (smt_ranks[a] != smt_ranks[b])
+				return smt_ranks[a] < smt_ranks[b];
+			if (x.node_id != y.node_id)
+				return x.node_id < y.node_id;
+			if (x.llc_id != y.llc_id)
+				return x.llc_id < y.llc_id;
+			return x.id < y.id;
+		});
+
+		self->workers_cpus = buf_with_allocator<Topology_CPU>(memory::clib());
+		for (size_t i = 0; i < self->settings.max_workers_count; ++i)
+			buf_push(self->workers_cpus, cpus[order[i % order.count]]);
+
+		if (self->settings.topology_aware_stealing == false)
+			return;
+
+		self->near_workers = buf_with_allocator<Buf<size_t>>(memory::clib());
+		for (size_t i = 0; i < self->workers_cpus.count; ++i)
+		{
+			auto near_workers = buf_with_allocator<size_t>(memory::clib());
+			const auto& cpu = self->workers_cpus[i];
+			for (size_t j = 0; j < self->workers_cpus.count; ++j)
+				if (j != i && self->workers_cpus[j].llc_id == cpu.llc_id)
+					buf_push(near_workers, j);
+			for (size_t j = 0; j < self->workers_cpus.count; ++j)
+				if (j != i && self->workers_cpus[j].llc_id != cpu.llc_id && self->workers_cpus[j].node_id == cpu.node_id)
+					buf_push(near_workers, j);
+			buf_push(self->near_workers, near_workers);
+		}
+	}
+
+	// fabric
+	Fabric
+	fabric_new(Fabric_Settings settings)
+	{
+		if (settings.name == nullptr)
+			settings.name = "fabric";
+
+		if (settings.workers_count == 0)
+			settings.workers_count = std::thread::hardware_concurrency();
+		if (settings.min_workers_count == 0 || settings.min_workers_count > settings.workers_count)
+			settings.min_workers_count = settings.workers_count;
+		if (settings.max_workers_count < settings.workers_count)
+			settings.max_workers_count = settings.workers_count;
+		if (settings.worker_idle_timeout_in_ms == 0)
+			settings.worker_idle_timeout_in_ms = DEFAULT_WORKER_IDLE_TIMEOUT_IN_MS;
+		if (settings.coop_blocking_threshold_in_ms == 0)
+			settings.coop_blocking_threshold_in_ms = DEFAULT_COOP_BLOCKING_THRESHOLD;
+		if (settings.external_blocking_threshold_in_ms == 0)
+			settings.external_blocking_threshold_in_ms = DEFAULT_EXTR_BLOCKING_THRESHOLD;
+		if (settings.put_aside_worker_count == 0)
+			settings.put_aside_worker_count = settings.workers_count / 2;
+		if (settings.blocking_workers_threshold == 0.0f)
+			settings.blocking_workers_threshold = 0.5f;
+		if (settings.max_threads_count == 0)
+			settings.max_threads_count = settings.max_workers_count * DEFAULT_MAX_THREADS_PER_WORKER;
+		if (settings.max_threads_count < settings.workers_count)
+			settings.max_threads_count = settings.workers_count;
+		if (settings.blocking_threads_count == 0)
+			settings.blocking_threads_count = settings.workers_count;
+		if (settings.injection_queue_capacity == 0)
+			settings.injection_queue_capacity = DEFAULT_INJECTION_QUEUE_CAPACITY;
+		if (settings.idle_spin_count == 0)
+			settings.idle_spin_count = DEFAULT_IDLE_SPIN_COUNT;
+		if (settings.idle_yield_count == 0)
+			settings.idle_yield_count = DEFAULT_IDLE_YIELD_COUNT;
+		if (settings.fiber_stack_size == 0)
+			settings.fiber_stack_size = DEFAULT_FIBER_STACK_SIZE;
+		if (MN_FIBERS_SUPPORTED == 0)
+			settings.enable_fibers = false;
+		if (settings.pin_workers == false)
+		{
+			settings.topology_aware_stealing = false;
+			settings.numa_local_memory = false;
+		}
+
+
+		auto self = alloc_zerod<IFabric>();
+		self->settings = settings;
+		self->name = strf("{}", settings.name);
+		self->sysmon_name = strf("{} sysmon thread", settings.name);
+		self->timer_name = strf("{} timer thread", settings.name);
+		self->io_name = strf("{} io thread", settings.name);
+		self->workers_mtx = mn_mutex_rw_new_with_srcloc(self->name.ptr);
+		self->workers = buf_with_capacity<Worker>(self->settings.max_workers_count);
+		buf_resize(self->workers, self->settings.workers_count);
+		self->sleepy_side_workers = buf_new<Worker>();
+		self->ready_side_workers = buf_new<Worker>();
+		self->surplus_workers = buf_new<Worker>();
+		self->side_workers_mtx = mn_mutex_new_with_srcloc(self->name.ptr);
+		self->atomic_blocking_evictions = 0;
+		self->atomic_skipped_evictions = 0;
+		self->atomic_threads_count = settings.workers_count;
+		self->blocking_name = strf("{} blocking thread", settings.name);
+		_blocking_pool_init(self->blocking_pool, self->blocking_name.ptr);
+		self->overload_signal = worker_signal_new();
+		self->atomic_blocked_submitters = 0;
+		self->atomic_overloaded_submissions = 0;
+		self->mtx = mn_mutex_new_with_srcloc(self->name.ptr);
+		self->cv = cond_var_new();
+		self->is_running = true;
+		for (size_t i = 0; i < FABRIC_TASK_PRIORITY_COUNT; ++i)
+			self->injection_q[i] = mpmc_ring_new<Fabric_Task*>(settings.injection_queue_capacity, memory::clib());
+		self->waiters_mtx = mn_mutex_new_with_srcloc(self->name.ptr);
+		self->waiters = buf_with_allocator<Fabric_Waiter>(memory::clib());
+		self->atomic_waiters_count = 0;
+		self->atomic_waiters_polling = false;
+		_timer_wheel_init(self->timer_wheel, self->name.ptr);
+		self->io_mtx = mn_mutex_new_with_srcloc(self->name.ptr);
+		self->io_poller = nullptr;
+		self->io_thread = nullptr;
+		self->atomic_io_running = true;
+		self->atomic_sysmon_sleeping = false;
+		self->atomic_available_jobs = 0;
+		self->sleeping_workers_bitmap_count = (settings.max_workers_count + 63) / 64;
+		self->sleeping_workers_bitmap = (std::atomic<uint64_t>*)alloc_from(
+			memory::clib(),
+			sizeof(std::atomic<uint64_t>) * self->sleeping_workers_bitmap_count,
+			alignof(std::atomic<uint64_t>)
+		).ptr;
+		for (size_t i = 0; i < self->sleeping_workers_bitmap_count; ++i)
+			::new (&self->sleeping_workers_bitmap[i]) std::atomic<uint64_t>(0);
+		self->atomic_next_worker = 0;
+		self->worker_id_generator = 0;
+		if (settings.pin_workers)
+			_fabric_place_workers(self);
+
+		mutex_write_lock(self->workers_mtx);
+		for (size_t i = 0; i < self->workers.count; ++i)
+		{
+			self->workers[i] = _worker_new(
+				strf("{} worker #{}", self->name, self->worker_id_generator++),
+				self,
+				i
+			);
+		}
+		mutex_write_unlock(self->workers_mtx);
+
+		self->sysmon = thread_new(_sysmon_main, self, self->sysmon_name.ptr);
+
+		return self;
+	}
+
+	void
+	fabric_free(Fabric self)
+	{
+		{
+			mutex_lock(self->mtx);
+			mn_defer(mutex_unlock(self->mtx));
+
+			self->is_running = false;
+			cond_var_notify(self->cv);
+		}
+
+		thread_join(self->sysmon);
+		thread_free(self->sysmon);
+
+		// the timer thread submits jobs so it's stopped before the workers
+		{
+			mutex_lock(self->timer_wheel.mtx);
+			self->timer_wheel.is_running = false;
+			cond_var_notify(self->timer_wheel.cv);
+			mutex_unlock(self->timer_wheel.mtx);
+		}
+		if (self->timer_wheel.thread)
+		{
+			thread_join(self->timer_wheel.thread);
+			thread_free(self->timer_wheel.thread);
+		}
+
+		// so does the io thread
+		if (self->io_thread)
+		{
+			self->atomic_io_running.store(false);
+			_fabric_poller_wake(self->io_poller);
+			thread_join(self->io_thread);
+			thread_free(self->io_thread);
+		}
+
+		// the blocking tasks might submit jobs too
+		_blocking_pool_free(self->blocking_pool);
+
+		for (auto worker : self->workers)
+			_worker_stop(worker);
+
+		for (auto worker : self->sleepy_side_workers)
+			_worker_stop(worker);
+
+		for (auto worker : self->ready_side_workers)
+			_worker_stop(worker);
+
+		for (auto worker : self->surplus_workers)
+			_worker_stop(worker);
+
+		// workers might be stealing from each other until they exit, so we join all of them before freeing any
+		for (auto worker : self->workers)
+			_worker_join(worker);
+
+		for (auto worker : self->workers)
+			_worker_free(worker);
+		buf_free(self->workers);
+
+		for (auto worker : self->sleepy_side_workers)
+			_worker_free(worker);
+		buf_free(self->sleepy_side_workers);
+
+		for (auto worker : self->ready_side_workers)
+			_worker_free(worker);
+		buf_free(self->ready_side_workers);
+
+		for (auto worker : self->surplus_workers)
+			_worker_free(worker);
+		buf_free(self->surplus_workers);
+
+		for (size_t i = 0; i < FABRIC_TASK_PRIORITY_COUNT; ++i)
+		{
+			Fabric_Task* job = nullptr;
+			while (mpmc_ring_pop_try(self->injection_q[i], job))
+				_fabric_task_node_free(job);
+			mpmc_ring_free(self->injection_q[i]);
+		}
+
+		for (auto& waiter: self->waiters)
+		{
+			task_free(waiter.ready);
+			_fabric_task_node_free(waiter.job);
+		}
+		buf_free(self->waiters);
+		mutex_free(self->waiters_mtx);
+		// the running periodic tasks are done by now so the remaining timers can be freed
+		_timer_wheel_free(self->timer_wheel);
+		// and the tasks whose handles never got ready are freed without running
+		if (self->io_poller)
+		{
+			auto pending = buf_with_allocator<Fabric_Task*>(memory::clib());
+			_fabric_poller_free(self->io_poller, pending);
+			for (auto job: pending)
+				_fabric_task_node_free(job);
+			buf_free(pending);
+		}
+		mutex_free(self->io_mtx);
+		free_from(memory::clib(), Block{ self->sleeping_workers_bitmap, sizeof(std::atomic<uint64_t>) * self->sleeping_workers_bitmap_count });
+		buf_free(self->workers_cpus);
+		destruct(self->near_workers);
+
+		mutex_rw_free(self->workers_mtx);
+		mutex_free(self->side_workers_mtx);
+		worker_signal_free(self->overload_signal);
+		cond_var_free(self->cv);
+		mutex_free(self->mtx);
+		str_free(self->name);
+		str_free(self->sysmon_name);
+		str_free(self->timer_name);
+		str_free(self->io_name);
+		str_free(self->blocking_name);
+		task_free(self->settings.after_each_job);
+		task_free(self->settings.on_worker_start);
+		free(self);
+	}
+
+	Allocator
+	fabric_task_allocator()
+	{
+		static Task_Pool_Allocator allocator;
+		return &allocator;
+	}
+
+	bool
+	fabric_task_do(Fabric self, const Fabric_Task& task)
+	{
+		return _fabric_submit_job_with_policy(self, _fabric_task_node_new(task));
+	}
+
+	bool
+	fabric_task_try_do(Fabric self, const Fabric_Task& task)
+	{
+		auto job = _fabric_task_node_new(task);
+		if (_fabric_try_submit_job(self, job))
+			return true;
+
+		self->atomic_overloaded_submissions.fetch_add(1, std::memory_order_relaxed);
+		// the caller keeps the ownership of the task so we only free the node
+		free_from(fabric_task_allocator(), (Fabric_Task_Node*)job);
+		return false;
+	}
+
+	void
+	fabric_task_do_blocking(Fabric self, const Fabric_Task& task)
+	{
+		auto job = _fabric_task_node_new(task);
+		auto& pool = self->blocking_pool;
+
+		mutex_lock(pool.mtx);
+		mn_defer(mutex_unlock(pool.mtx));
+
+		ring_push_back(pool.q, job);
+
+		// start a new thread only if the idle ones can't take all the queued tasks, the first thread is always allowed
+		// so that the blocking tasks can run even if the workers took all the threads
+		if (pool.idle_count < pool.q.count && pool.threads.count < self->settings.blocking_threads_count)
+		{
+			if (pool.threads.count == 0)
+				self->atomic_threads_count.fetch_add(1);
+			if (pool.threads.count == 0 || _fabric_reserve_thread(self))
+				buf_push(pool.threads, thread_new(_blocking_pool_main, self, self->blocking_name.ptr));
+		}
+		cond_var_notify(pool.cv);
+	}
+
+	void
+	fabric_task_do_when(Fabric self, Task<bool()> ready, const Fabric_Task& task)
+	{
+		if (ready())
+		{
+			task_free(ready);
+			_fabric_submit_job(self, _fabric_task_node_new(task));
+			return;
+		}
+
+		Fabric_Waiter waiter{};
+		waiter.ready = ready;
+		waiter.job = _fabric_task_node_new(task);
+
+		mutex_lock(self->waiters_mtx);
+		buf_push(self->waiters, waiter);
+		self->atomic_waiters_count.store(self->waiters.count);
+		mutex_unlock(self->waiters_mtx);
+
+		// parked workers don't poll, so we wake one up to take care of the waiting tasks
+		_fabric_wake_sleeping_worker(self);
+	}
+
+	void
+	fabric_task_do_when_io(Fabric self, int64_t handle, FABRIC_IO io, const Fabric_Task& task)
+	{
+		Fabric_Poller poller = nullptr;
+		{
+			mutex_lock(self->io_mtx);
+			mn_defer(mutex_unlock(self->io_mtx));
+
+			if (self->io_poller == nullptr)
+			{
+				self->io_poller = _fabric_poller_new();
+				self->io_thread = thread_new(_io_main, self, self->io_name.ptr);
+			}
+			poller = self->io_poller;
+		}
+
+		_fabric_poller_add(poller, handle, io, _fabric_task_node_new(task));
+	}
+
+	Fabric_Timer
+	fabric_task_do_after(Fabric self, uint64_t delay_in_ms, const Fabric_Task& task)
+	{
+		return _fabric_timer_new(self, delay_in_ms, 0, task);
+	}
+
+	Fabric_Timer
+	fabric_task_do_every(Fabric self, uint64_t period_in_ms, const Fabric_Task& task)
+	{
+		if (period_in_ms == 0)
+			period_in_ms = 1;
+		return _fabric_timer_new(self, period_in_ms, period_in_ms, task);
+	}
+
+	bool
+	fabric_timer_cancel(Fabric self, Fabric_Timer timer)
+	{
+		auto& wheel = self->timer_wheel;
+		mutex_lock(wheel.mtx);
+		mn_defer(mutex_unlock(wheel.mtx));
+
+		auto node = _timer_wheel_find(wheel, timer.handle);
+		if (node == nullptr || node->state == Fabric_Timer_Node::STATE_CANCELED)
+			return false;
+
+		// the running periodic task frees itself once it finishes
+		if (node->state == Fabric_Timer_Node::STATE_RUNNING)
+		{
+			node->state = Fabric_Timer_Node::STATE_CANCELED;
+			return true;
+		}
+
+		_timer_wheel_unlink(node);
+		fabric_task_free(node->task);
+		_timer_wheel_node_free(wheel, node);
+		return true;
+	}
+
+	// submits the batch without any limits, it's used by the fabric's internal tasks which wait for the batch anyway
+	static void
+	_fabric_submit_batch(Fabric self, const Fabric_Task* ptr, size_t count)
+	{
+		auto tasks = buf_with_allocator<Fabric_Task*>(memory::tmp());
+		buf_reserve(tasks, count);
+		for (size_t i = 0; i < count; ++i)
+			buf_push(tasks, _fabric_task_node_new(ptr[i]));
+
+		if (self->settings.enable_timing_stats)
+		{
+			auto now = _stats_now_in_us();
+			for (auto task: tasks)
+				_fabric_task_node_submit_time(task) = now;
+		}
+
+		auto local_worker = LOCAL_WORKER;
+		if (local_worker && (local_worker->fabric != self || local_worker->atomic_state.load() != IWorker::STATE_RUNNING))
+			local_worker = nullptr;
+
+		mutex_read_lock(self->workers_mtx);
+		mn_defer(mutex_read_unlock(self->workers_mtx));
+
+		// partition the batch across all the workers such that their queue depths even out, the less loaded
+		// workers get the bigger shares, each share is a contiguous range of the batch to keep the locality
+		auto workers_count = self->workers.count;
+		auto depths = buf_with_allocator<size_t>(memory::tmp());
+		buf_reserve(depths, workers_count);
+		size_t total_depth = count;
+		for (auto worker: self->workers)
+		{
+			auto depth = _worker_queue_depth(worker);
+			buf_push(depths, depth);
+			total_depth += depth;
+		}
+		auto target_depth = (total_depth + workers_count - 1) / workers_count;
 
-					mutex_lock(min_worker->mtx);
-					mn_defer(mutex_unlock(min_worker->mtx));
+		auto receivers = buf_with_allocator<Worker>(memory::tmp());
+		auto start = self->atomic_next_worker.fetch_add(1);
+		size_t offset = 0;
+		for (size_t i = 0; i < workers_count && offset < count; ++i)
+		{
+			auto index = (start + i) % workers_count;
+			if (depths[index] >= target_depth)
+				continue;
 
-					for (auto job: tmp_jobs)
-						ring_push_back(min_worker->job_q, job);
-					buf_clear(tmp_jobs);
+			auto share = target_depth - depths[index];
+			if (share > count - offset)
+				share = count - offset;
 
-					cond_var_notify(min_worker->cv);
-				}
+			auto worker = self->workers[index];
+			if (worker == local_worker)
+			{
+				// push the newest first so that the worker pops the jobs in the same order they were submitted
+				for (size_t j = 0; j < share; ++j)
+					_worker_local_push(worker, tasks[offset + share - j - 1]);
+			}
+			else
+			{
+				_worker_enqueue_batch(worker, tasks.ptr + offset, share);
+				buf_push(receivers, worker);
 			}
+			offset += share;
+		}
+		// depths are only an approximation so we might end up with a remainder, give it to the first worker
+		if (offset < count)
+		{
+			auto worker = self->workers[start % workers_count];
+			_worker_enqueue_batch(worker, tasks.ptr + offset, count - offset);
+			buf_push(receivers, worker);
+		}
 
-			// check if any sleepy worker is ready and move it either to the ready workers list
-			// or free it because we don't really need it
-			buf_remove_if(self->sleepy_side_workers, [self, &dead_workers](Worker worker) {
-				if (worker->atomic_job_start_time_in_ms.load() == 0)
-				{
-					if (self->ready_side_workers.count < self->settings.put_aside_worker_count)
-					{
-						buf_push(self->ready_side_workers, worker);
-					}
-					else
-					{
-						_worker_stop(worker);
-						buf_push(dead_workers, worker);
-					}
-					return true;
-				}
-				return false;
-			});
+		// a single wake up pass over the workers which received tasks after all the tasks are published
+		self->atomic_available_jobs.fetch_add(count);
+		for (auto worker: receivers)
+			_worker_wake(worker);
+		_fabric_notify_sysmon(self);
+	}
 
-			_sysmon_detect_blocking_workers(self, blocking_workers);
-			_sysmon_detect_long_running_workers(self, long_running_workers);
+	size_t
+	fabric_task_batch_do(Fabric self, const Fabric_Task* ptr, size_t count)
+	{
+		if (self->settings.max_pending_tasks == 0 && self->settings.max_worker_queue_size == 0)
+		{
+			_fabric_submit_batch(self, ptr, count);
+			return count;
 		}
-	}
 
+		size_t res = 0;
+		for (size_t i = 0; i < count; ++i)
+			if (fabric_task_do(self, ptr[i]))
+				++res;
+		return res;
+	}
 
-	// API
-	Worker
-	worker_new(const char* name)
+	Fabric
+	fabric_local()
 	{
-		return _worker_new(str_from_c(name), nullptr);
+		Fabric res = LOCAL_BLOCKING_FABRIC;
+		if (auto w = worker_local())
+			res = w->fabric;
+		return res;
 	}
 
-	void
-	worker_free(Worker self)
+	size_t
+	fabric_workers_count(Fabric self)
 	{
-		_worker_stop(self);
-		_worker_free(self);
+		mutex_read_lock(self->workers_mtx);
+		mn_defer(mutex_read_unlock(self->workers_mtx));
+
+		return self->workers.count;
 	}
 
-	void
-	worker_task_do(Worker self, const Fabric_Task& task)
+	Fabric_Stats
+	fabric_stats(Fabric self)
 	{
-		mutex_lock(self->mtx);
-		mn_defer(mutex_unlock(self->mtx));
+		Fabric_Stats res{};
+		res.workers = buf_new<Fabric_Worker_Stats>();
 
-		ring_push_back(self->job_q, task);
-		cond_var_notify(self->cv);
+		mutex_read_lock(self->workers_mtx);
+		mn_defer(mutex_read_unlock(self->workers_mtx));
+
+		buf_reserve(res.workers, self->workers.count);
+		for (auto worker: self->workers)
+		{
+			Fabric_Worker_Stats stats{};
+			_stats_accumulate(stats, worker->stats);
+			for (size_t i = 0; i < FABRIC_TASK_PRIORITY_COUNT; ++i)
+			{
+				stats.job_q_count[i] = worker->atomic_job_q_count[i].load(std::memory_order_relaxed);
+				stats.local_q_count[i] = _task_deque_count(worker->local_q[i]);
+				res.total.job_q_count[i] += stats.job_q_count[i];
+				res.total.local_q_count[i] += stats.local_q_count[i];
+			}
+			_stats_accumulate(res.total, worker->stats);
+			buf_push(res.workers, stats);
+		}
+
+		{
+			mutex_lock(self->side_workers_mtx);
+			mn_defer(mutex_unlock(self->side_workers_mtx));
+
+			for (auto worker: self->sleepy_side_workers)
+				_stats_accumulate(res.total, worker->stats);
+			for (auto worker: self->ready_side_workers)
+				_stats_accumulate(res.total, worker->stats);
+			for (auto worker: self->surplus_workers)
+				_stats_accumulate(res.total, worker->stats);
+
+			auto& retired = self->retired_stats;
+			res.total.tasks_executed += retired.tasks_executed;
+			res.total.steals += retired.steals;
+			res.total.parks += retired.parks;
+			res.total.unparks += retired.unparks;
+			for (size_t i = 0; i < FABRIC_STATS_HISTOGRAM_BUCKETS_COUNT; ++i)
+			{
+				res.total.queue_wait_histogram[i] += retired.queue_wait_histogram[i];
+				res.total.run_time_histogram[i] += retired.run_time_histogram[i];
+			}
+
+			res.sleepy_side_workers_count = self->sleepy_side_workers.count;
+			res.ready_side_workers_count = self->ready_side_workers.count;
+			res.surplus_workers_count = self->surplus_workers.count;
+		}
+
+		{
+			mutex_lock(self->blocking_pool.mtx);
+			mn_defer(mutex_unlock(self->blocking_pool.mtx));
+
+			res.blocking_threads_count = self->blocking_pool.threads.count;
+			res.blocking_q_count = self->blocking_pool.q.count;
+		}
+
+		for (size_t i = 0; i < FABRIC_TASK_PRIORITY_COUNT; ++i)
+			res.injection_q_count[i] = mpmc_ring_count(self->injection_q[i]);
+		res.blocking_evictions = self->atomic_blocking_evictions.load(std::memory_order_relaxed);
+		res.overloaded_submissions = self->atomic_overloaded_submissions.load(std::memory_order_relaxed);
+		res.skipped_evictions = self->atomic_skipped_evictions.load(std::memory_order_relaxed);
+		res.threads_count = self->atomic_threads_count.load(std::memory_order_relaxed);
+
+		return res;
 	}
 
-	void
-	worker_task_batch_do(Worker self, const Fabric_Task* ptr, size_t count)
+	struct Parallel_Chunks
 	{
-		mutex_lock(self->mtx);
-		mn_defer(mutex_unlock(self->mtx));
+		Task<void(size_t)> fn;
+		size_t chunks_count;
+		std::atomic<size_t> atomic_next_chunk;
+		// helpers which start after all the chunks are taken only touch this state and never the caller's fn,
+		// that's why it's reference counted instead of living on the caller's stack
+		std::atomic<int32_t> atomic_arc;
+		Waitgroup wg;
+	};
 
-		ring_reserve(self->job_q, count);
-		for (size_t i = 0; i < count; ++i)
-			ring_push_back(self->job_q, ptr[i]);
-		cond_var_notify(self->cv);
+	inline static void
+	_parallel_chunks_unref(Parallel_Chunks* self)
+	{
+		if (self->atomic_arc.fetch_sub(1) == 1)
+		{
+			waitgroup_free(self->wg);
+			free(self);
+		}
 	}
 
-	Worker
-	worker_local()
+	inline static void
+	_parallel_chunks_run(Parallel_Chunks* self)
 	{
-		return LOCAL_WORKER;
+		while (true)
+		{
+			auto chunk = self->atomic_next_chunk.fetch_add(1);
+			if (chunk >= self->chunks_count)
+				break;
+
+			self->fn(chunk);
+			waitgroup_done(self->wg);
+		}
 	}
 
 	void
-	worker_block_ahead()
+	_fabric_parallel_chunks(Fabric self, size_t chunks_count, Task<void(size_t)> fn)
 	{
-		if (LOCAL_WORKER == nullptr)
-			return;
+		auto helpers_count = fabric_workers_count(self);
+		if (helpers_count > chunks_count - 1)
+			helpers_count = chunks_count - 1;
+
+		auto state = alloc_zerod<Parallel_Chunks>();
+		state->fn = fn;
+		state->chunks_count = chunks_count;
+		state->atomic_arc = int32_t(helpers_count + 1);
+		state->wg = waitgroup_new();
+		waitgroup_add(state->wg, int(chunks_count));
+
+		// chunks are taken dynamically so faster workers end up doing more of them
+		auto batch = buf_with_allocator<Fabric_Task>(memory::tmp());
+		buf_reserve(batch, helpers_count);
+		for (size_t i = 0; i < helpers_count; ++i)
+		{
+			Fabric_Task entry{};
+			entry.task = fabric_task_make([state] {
+				_parallel_chunks_run(state);
+				_parallel_chunks_unref(state);
+			});
+			entry.flags = FABRIC_TASK_FLAG_COMPUTE;
+			buf_push(batch, entry);
+		}
+		_fabric_submit_batch(self, batch.ptr, batch.count);
 
-		if (LOCAL_WORKER->atomic_disable_block_timing.load() == true)
-			return;
+		_parallel_chunks_run(state);
+		waitgroup_wait(state->wg);
 
-		LOCAL_WORKER->atomic_block_start_time_in_ms.store(time_in_millis());
+		task_free(fn);
+		_parallel_chunks_unref(state);
 	}
 
-	void
-	worker_block_clear()
+	struct Fabric_Graph_Node
 	{
-		if (LOCAL_WORKER == nullptr)
-			return;
+		Fabric_Task task;
+		Buf<size_t> successors;
+		int32_t predecessors_count;
+		// the number of predecessors which haven't finished yet in the current run
+		std::atomic<int32_t> atomic_pending;
+	};
 
-		if (LOCAL_WORKER->atomic_disable_block_timing.load() == true)
-			return;
+	struct IFabric_Graph
+	{
+		Buf<Fabric_Graph_Node*> nodes;
+		Fabric fabric;
+		// the number of nodes which haven't finished yet in the current run
+		std::atomic<size_t> atomic_remaining;
+		Waitgroup wg;
+		// whether the graph was checked for cycles since its nodes and edges last changed
+		bool acyclic;
+	};
 
-		LOCAL_WORKER->atomic_block_start_time_in_ms.store(0);
-	}
+	static void
+	_fabric_graph_run_node(Fabric_Graph self, size_t index);
 
+	inline static Fabric_Task
+	_fabric_graph_node_task(Fabric_Graph self, size_t index)
+	{
+		auto node = self->nodes[index];
+		Fabric_Task res{};
+		res.task = fabric_task_make([self, index] { _fabric_graph_run_node(self, index); });
+		res.flags = node->task.flags;
+		res.priority = node->task.priority;
+		return res;
+	}
 
-	// fabric
-	Fabric
-	fabric_new(Fabric_Settings settings)
+	static void
+	_fabric_graph_run_node(Fabric_Graph self, size_t index)
 	{
-		if (settings.name == nullptr)
-			settings.name = "fabric";
+		// the last ready successor runs right away on this worker instead of going through the queues
+		while (true)
+		{
+			auto node = self->nodes[index];
+			node->task.task();
 
-		if (settings.workers_count == 0)
-			settings.workers_count = std::thread::hardware_concurrency();
-		if (settings.coop_blocking_threshold_in_ms == 0)
-			settings.coop_blocking_threshold_in_ms = DEFAULT_COOP_BLOCKING_THRESHOLD;
-		if (settings.external_blocking_threshold_in_ms == 0)
-			settings.external_blocking_threshold_in_ms = DEFAULT_EXTR_BLOCKING_THRESHOLD;
-		if (settings.put_aside_worker_count == 0)
-			settings.put_aside_worker_count = settings.workers_count / 2;
-		if (settings.blocking_workers_threshold == 0.0f)
-			settings.blocking_workers_threshold = 0.5f;
+			size_t next_index = SIZE_MAX;
+			for (auto successor: node->successors)
+			{
+				if (self->nodes[successor]->atomic_pending.fetch_sub(1) != 1)
+					continue;
 
+				if (next_index != SIZE_MAX)
+					_fabric_submit_job(self->fabric, _fabric_task_node_new(_fabric_graph_node_task(self, next_index)));
+				next_index = successor;
+			}
 
-		auto self = alloc_zerod<IFabric>();
-		self->settings = settings;
-		self->name = strf("{}", settings.name);
-		self->sysmon_name = strf("{} sysmon thread", settings.name);
-		self->workers = buf_with_count<Worker>(self->settings.workers_count);
-		self->sleepy_side_workers = buf_new<Worker>();
-		self->ready_side_workers = buf_new<Worker>();
-		self->mtx = mn_mutex_new_with_srcloc(self->name.ptr);
-		self->cv = cond_var_new();
-		self->is_running = true;
-		self->atomic_available_jobs = 0;
-		self->next_worker = 0;
-		self->worker_id_generator = 0;
+			// the graph can be freed by its waiter once the last node is done so we can't touch it afterwards
+			if (self->atomic_remaining.fetch_sub(1) == 1)
+			{
+				mn_assert(next_index == SIZE_MAX);
+				waitgroup_done(self->wg);
+				return;
+			}
 
-		for (size_t i = 0; i < self->workers.count; ++i)
-		{
-			self->workers[i] = _worker_new(
-				strf("{} worker #{}", self->name, self->worker_id_generator++),
-				self
-			);
+			if (next_index == SIZE_MAX)
+				return;
+			index = next_index;
 		}
+	}
 
-		self->sysmon = thread_new(_sysmon_main, self, self->sysmon_name.ptr);
-
+	Fabric_Graph
+	fabric_graph_new()
+	{
+		auto self = alloc_zerod<IFabric_Graph>();
+		self->nodes = buf_new<Fabric_Graph_Node*>();
+		self->wg = waitgroup_new();
 		return self;
 	}
 
 	void
-	fabric_free(Fabric self)
+	fabric_graph_free(Fabric_Graph self)
 	{
-		{
-			mutex_lock(self->mtx);
-			mn_defer(mutex_unlock(self->mtx));
+		mn_assert(self->atomic_remaining.load() == 0);
 
-			self->is_running = false;
-			cond_var_notify(self->cv);
+		for (auto node: self->nodes)
+		{
+			fabric_task_free(node->task);
+			buf_free(node->successors);
+			free(node);
 		}
-
-		thread_join(self->sysmon);
-		thread_free(self->sysmon);
-
-		for (auto worker : self->workers)
-			_worker_stop(worker);
-
-		for (auto worker : self->sleepy_side_workers)
-			_worker_stop(worker);
-
-		for (auto worker : self->ready_side_workers)
-			_worker_stop(worker);
-
-		for (auto worker : self->workers)
-			_worker_free(worker);
-		buf_free(self->workers);
-
-		for (auto worker : self->sleepy_side_workers)
-			_worker_free(worker);
-		buf_free(self->sleepy_side_workers);
-
-		for (auto worker : self->ready_side_workers)
-			_worker_free(worker);
-		buf_free(self->ready_side_workers);
-
-		cond_var_free(self->cv);
-		mutex_free(self->mtx);
-		str_free(self->name);
-		str_free(self->sysmon_name);
-		task_free(self->settings.after_each_job);
-		task_free(self->settings.on_worker_start);
+		buf_free(self->nodes);
+		waitgroup_free(self->wg);
 		free(self);
 	}
 
+	size_t
+	fabric_graph_task_add(Fabric_Graph self, const Fabric_Task& task)
+	{
+		mn_assert(self->atomic_remaining.load() == 0);
+
+		auto node = alloc_zerod<Fabric_Graph_Node>();
+		node->task = task;
+		node->successors = buf_new<size_t>();
+		buf_push(self->nodes, node);
+		self->acyclic = false;
+		return self->nodes.count - 1;
+	}
+
 	void
-	fabric_task_do(Fabric self, const Fabric_Task& task)
+	fabric_graph_edge_add(Fabric_Graph self, size_t from, size_t to)
 	{
-		mutex_lock(self->mtx);
-		mn_defer(mutex_unlock(self->mtx));
+		mn_assert(self->atomic_remaining.load() == 0);
+		mn_assert(from < self->nodes.count && to < self->nodes.count && from != to);
 
-		auto next_worker = self->next_worker++;
-		next_worker %= self->workers.count;
+		buf_push(self->nodes[from]->successors, to);
+		++self->nodes[to]->predecessors_count;
+		self->acyclic = false;
+	}
 
-		auto worker = self->workers[next_worker];
-		worker_task_do(worker, task);
+	// returns whether all the nodes of the graph are reachable from its roots, it goes over the graph in topological
+	// order (Kahn's algorithm) and a node which is part of a cycle (or comes after one) never runs out of predecessors
+	inline static bool
+	_fabric_graph_is_acyclic(Fabric_Graph self)
+	{
+		auto pending = buf_with_allocator<int32_t>(memory::tmp());
+		auto ready = buf_with_allocator<size_t>(memory::tmp());
+		buf_resize(pending, self->nodes.count);
+		for (size_t i = 0; i < self->nodes.count; ++i)
+		{
+			pending[i] = self->nodes[i]->predecessors_count;
+			if (pending[i] == 0)
+				buf_push(ready, i);
+		}
 
-		self->atomic_available_jobs.fetch_add(1);
-		cond_var_notify(self->cv);
+		size_t visited_count = 0;
+		while (ready.count > 0)
+		{
+			auto index = buf_top(ready);
+			buf_pop(ready);
+			++visited_count;
+			for (auto successor: self->nodes[index]->successors)
+				if (--pending[successor] == 0)
+					buf_push(ready, successor);
+		}
+		return visited_count == self->nodes.count;
 	}
 
-	void
-	fabric_task_batch_do(Fabric self, const Fabric_Task* ptr, size_t count)
+	bool
+	fabric_graph_submit(Fabric_Graph self, Fabric f)
 	{
-		mutex_lock(self->mtx);
-		mn_defer(mutex_unlock(self->mtx));
-
-		auto next_worker = self->next_worker++;
-		next_worker %= self->workers.count;
+		mn_assert(self->atomic_remaining.load() == 0);
+		if (self->nodes.count == 0)
+			return true;
 
-		auto worker = self->workers[next_worker];
-		worker_task_batch_do(worker, ptr, count);
+		// the nodes of a cycle would wait on each other forever and so would fabric_graph_wait
+		if (self->acyclic == false)
+		{
+			self->acyclic = _fabric_graph_is_acyclic(self);
+			if (self->acyclic == false)
+				return false;
+		}
 
-		self->atomic_available_jobs.fetch_add(count);
-		cond_var_notify(self->cv);
+		// reset the state of the run before any of the nodes is scheduled
+		self->fabric = f;
+		for (auto node: self->nodes)
+			node->atomic_pending.store(node->predecessors_count);
+		self->atomic_remaining.store(self->nodes.count);
+		waitgroup_add(self->wg, 1);
+
+		auto roots = buf_with_allocator<Fabric_Task>(memory::tmp());
+		for (size_t i = 0; i < self->nodes.count; ++i)
+			if (self->nodes[i]->predecessors_count == 0)
+				buf_push(roots, _fabric_graph_node_task(self, i));
+		_fabric_submit_batch(f, roots.ptr, roots.count);
+		return true;
 	}
 
-	Fabric
-	fabric_local()
+	void
+	fabric_graph_wait(Fabric_Graph self)
 	{
-		Fabric res = nullptr;
-		if (auto w = worker_local())
-			res = w->fabric;
-		return res;
+		waitgroup_wait(self->wg);
 	}
 
 	void
@@ -730,7 +4324,7 @@ namespace mn
 				for (size_t x = 0; x < global.x; ++x)
 				{
 					Fabric_Task entry{};
-					entry.task = Task<void()>::make([global_x = x, global_y = y, global_z = z, global, local, &wg, &fn]
+					entry.task = fabric_task_make([global_x = x, global_y = y, global_z = z, global, local, &wg, &fn]
 					{
 						for (size_t z = 0; z < local.z; ++z)
 						{
@@ -749,8 +4343,9 @@ namespace mn
 										global_y * local.y + y,
 										global_z * local.z + z,
 									};
+									auto tmp_checkpoint = memory::tmp()->checkpoint();
 									fn(args);
-									memory::tmp()->clear_all();
+									memory::tmp()->restore(tmp_checkpoint);
 								}
 							}
 						}
@@ -763,7 +4358,7 @@ namespace mn
 		}
 
 		wg.add((int)batch.count);
-		fabric_task_batch_do(self, batch.ptr, batch.count);
+		_fabric_submit_batch(self, batch.ptr, batch.count);
 		wg.wait();
 		task_free(fn);
 	}
@@ -781,7 +4376,7 @@ namespace mn
 				for (size_t x = 0; x < global.x; ++x)
 				{
 					Fabric_Task entry{};
-					entry.task = Task<void()>::make([global_x = x, global_y = y, global_z = z, global, size, local, &wg, &fn]
+					entry.task = fabric_task_make([global_x = x, global_y = y, global_z = z, global, size, local, &wg, &fn]
 					{
 						for (size_t z = 0; z < local.z; ++z)
 						{
@@ -802,8 +4397,9 @@ namespace mn
 									};
 									if (args.global_invocation_id.x >= size.x || args.global_invocation_id.y >= size.y || args.global_invocation_id.z >= size.z)
 										continue;
+									auto tmp_checkpoint = memory::tmp()->checkpoint();
 									fn(args);
-									memory::tmp()->clear_all();
+									memory::tmp()->restore(tmp_checkpoint);
 								}
 							}
 						}
@@ -816,7 +4412,7 @@ namespace mn
 		}
 
 		wg.add((int)batch.count);
-		fabric_task_batch_do(self, batch.ptr, batch.count);
+		_fabric_submit_batch(self, batch.ptr, batch.count);
 		wg.wait();
 		task_free(fn);
 	}
@@ -834,7 +4430,7 @@ namespace mn
 				for (size_t global_x = 0; global_x < total_size.x; ++global_x)
 				{
 					Fabric_Task entry{};
-					entry.task = Task<void()>::make([global_x, global_y, global_z, total_size, tile_size, &wg, &fn] {
+					entry.task = fabric_task_make([global_x, global_y, global_z, total_size, tile_size, &wg, &fn] {
 						Compute_Args args{};
 						args.workgroup_size = tile_size;
 						args.workgroup_num = total_size;
@@ -854,13 +4450,111 @@ namespace mn
 			}
 		}
 
-		wg.add((int)batch.count);
-		fabric_task_batch_do(self, batch.ptr, batch.count);
-		wg.wait();
-		task_free(fn);
+		wg.add((int)batch.count);
+		_fabric_submit_batch(self, batch.ptr, batch.count);
+		wg.wait();
+		task_free(fn);
+	}
+
+	// channel stream
+	inline static size_t
+	_chan_stream_available(Chan_Stream self)
+	{
+		return self->data_blob.size + self->ring_count + self->blocks_size;
+	}
+
+	inline static bool
+	_chan_stream_blocks_full(Chan_Stream self)
+	{
+		// in unbuffered mode a single pending block is considered full
+		return self->blocks.count > 0 && self->blocks_size >= self->ring_blob.size;
+	}
+
+	// copies at most data_out.size bytes out of the byte ring, the mutex should be locked
+	inline static size_t
+	_chan_stream_ring_read(Chan_Stream self, Block data_out)
+	{
+		auto cap = self->ring_blob.size;
+		auto ring = (char*)self->ring_blob.ptr;
+		auto read_size = data_out.size < self->ring_count ? data_out.size : self->ring_count;
+		auto first_size = cap - self->ring_head;
+		if (first_size > read_size)
+			first_size = read_size;
+		::memcpy(data_out.ptr, ring + self->ring_head, first_size);
+		::memcpy((char*)data_out.ptr + first_size, ring, read_size - first_size);
+		self->ring_head = (self->ring_head + read_size) % cap;
+		self->ring_count -= read_size;
+		return read_size;
+	}
+
+	// copies as much as it can of the given data into the byte ring, the mutex should be locked
+	inline static size_t
+	_chan_stream_ring_write(Chan_Stream self, Block data_in)
+	{
+		auto cap = self->ring_blob.size;
+		auto ring = (char*)self->ring_blob.ptr;
+		auto write_size = cap - self->ring_count;
+		if (write_size > data_in.size)
+			write_size = data_in.size;
+		auto tail = (self->ring_head + self->ring_count) % cap;
+		auto first_size = cap - tail;
+		if (first_size > write_size)
+			first_size = write_size;
+		::memcpy(ring + tail, data_in.ptr, first_size);
+		::memcpy(ring, (char*)data_in.ptr + first_size, write_size - first_size);
+		self->ring_count += write_size;
+		return write_size;
+	}
+
+	// copies at most data_out.size bytes out of the transferred blocks and frees the fully read ones, the mutex
+	// should be locked
+	inline static size_t
+	_chan_stream_blocks_read(Chan_Stream self, Block data_out)
+	{
+		size_t read_size = 0;
+		while (read_size < data_out.size && self->blocks.count > 0)
+		{
+			auto& block = ring_front(self->blocks);
+			auto size = block.size - self->blocks_offset;
+			if (size > data_out.size - read_size)
+				size = data_out.size - read_size;
+			::memcpy((char*)data_out.ptr + read_size, (char*)block.ptr + self->blocks_offset, size);
+			read_size += size;
+			self->blocks_offset += size;
+			self->blocks_size -= size;
+			if (self->blocks_offset == block.size)
+			{
+				free_from(memory::clib(), block);
+				ring_pop_front(self->blocks);
+				self->blocks_offset = 0;
+			}
+		}
+		return read_size;
+	}
+
+	// copies at most data_out.size bytes out of the blocked unbuffered writer, the mutex should be locked
+	inline static size_t
+	_chan_stream_blob_read(Chan_Stream self, Block data_out)
+	{
+		auto read_size = data_out.size < self->data_blob.size ? data_out.size : self->data_blob.size;
+		::memcpy(data_out.ptr, self->data_blob.ptr, read_size);
+		self->data_blob.ptr = (char*)self->data_blob.ptr + read_size;
+		self->data_blob.size -= read_size;
+		return read_size;
+	}
+
+	// waits until there's data to read or the stream is closed, the mutex should be locked
+	inline static void
+	_chan_stream_wait_readable(Chan_Stream self)
+	{
+		if (_chan_stream_available(self) > 0 || chan_stream_closed(self))
+			return;
+
+		cond_var_wait(self->read_cv, self->mtx, [self]{
+			return _chan_stream_available(self) > 0 || chan_stream_closed(self);
+		});
 	}
 
-	// channel stream
 	void
 	IChan_Stream::dispose()
 	{
@@ -868,6 +4562,11 @@ namespace mn
 		{
 			chan_stream_close(this);
 
+			for (size_t i = 0; i < this->blocks.count; ++i)
+				free_from(memory::clib(), this->blocks[i]);
+			ring_free(this->blocks);
+			if (this->ring_blob.ptr)
+				free_from(memory::clib(), this->ring_blob);
 			mutex_free(this->mtx);
 			cond_var_free(this->read_cv);
 			cond_var_free(this->write_cv);
@@ -882,34 +4581,21 @@ namespace mn
 		mn_defer(chan_stream_unref(this));
 
 		mutex_lock(this->mtx);
-		if (this->data_blob.size == 0)
-		{
-			if (chan_stream_closed(this))
-			{
-				mutex_unlock(this->mtx);
-				return 0;
-			}
-
-			cond_var_wait(this->read_cv, this->mtx, [this]{
-				return this->data_blob.size > 0 || chan_stream_closed(this);
-			});
-		}
+		_chan_stream_wait_readable(this);
 
-		auto read_size = data_out.size;
-		if (this->data_blob.size < read_size)
-			read_size = this->data_blob.size;
-
-		::memcpy(data_out.ptr, this->data_blob.ptr, read_size);
-		auto ptr = (char*)this->data_blob.ptr;
-		ptr += read_size;
-		this->data_blob.ptr = ptr;
-		this->data_blob.size -= read_size;
-		bool ready_to_write = this->data_blob.size == 0;
+		// pending data lives in exactly one of the blocks, the byte ring, or the unbuffered writer's blob
+		size_t read_size = 0;
+		if (this->blocks.count > 0)
+			read_size = _chan_stream_blocks_read(this, data_out);
+		else if (this->ring_count > 0)
+			read_size = _chan_stream_ring_read(this, data_out);
+		else
+			read_size = _chan_stream_blob_read(this, data_out);
 
 		mutex_unlock(this->mtx);
 
-		if (ready_to_write)
-			cond_var_notify(this->write_cv);
+		if (read_size > 0)
+			cond_var_notify_all(this->write_cv);
 
 		return read_size;
 	}
@@ -920,15 +4606,34 @@ namespace mn
 		chan_stream_ref(this);
 		mn_defer(chan_stream_unref(this));
 
-		// wait until there's available space
 		mutex_lock(this->mtx);
-		if (this->data_blob.size > 0)
+
+		// buffered mode, copy into the ring and only wait when it's full
+		if (this->ring_blob.size > 0)
 		{
-			cond_var_wait(this->write_cv, this->mtx, [this] {
-				return this->data_blob.size == 0 || chan_stream_closed(this);
-			});
+			size_t res = 0;
+			while (res < data_in.size)
+			{
+				// we also wait for the transferred blocks to be read to keep the bytes in order
+				cond_var_wait(this->write_cv, this->mtx, [this] {
+					return (this->blocks.count == 0 && this->ring_count < this->ring_blob.size) || chan_stream_closed(this);
+				});
+
+				if (chan_stream_closed(this))
+					panic("cannot write in a closed Chan_Stream");
+
+				res += _chan_stream_ring_write(this, Block{(char*)data_in.ptr + res, data_in.size - res});
+				cond_var_notify(this->read_cv);
+			}
+			mutex_unlock(this->mtx);
+			return res;
 		}
 
+		// wait until there's available space
+		cond_var_wait(this->write_cv, this->mtx, [this] {
+			return (this->data_blob.size == 0 && this->blocks.count == 0) || chan_stream_closed(this);
+		});
+
 		if (chan_stream_closed(this))
 			panic("cannot write in a closed Chan_Stream");
 
@@ -941,15 +4646,19 @@ namespace mn
 			return this->data_blob.size == 0 || chan_stream_closed(this);
 		});
 		auto res = data_in.size - this->data_blob.size;
+		this->data_blob = Block{};
 		mutex_unlock(this->mtx);
 
 		return res;
 	}
 
 	Chan_Stream
-	chan_stream_new()
+	chan_stream_new(size_t buffer_size)
 	{
 		auto self = alloc_construct<IChan_Stream>();
+		if (buffer_size > 0)
+			self->ring_blob = alloc_from(memory::clib(), buffer_size, alignof(char));
+		self->blocks = ring_with_allocator<Block>(memory::clib());
 		self->mtx = mn_mutex_new_with_srcloc("chan stream mutex");
 		self->read_cv = cond_var_new();
 		self->write_cv = cond_var_new();
@@ -1005,4 +4714,513 @@ namespace mn
 
 		return self->atomic_closed.load();
 	}
+
+	void
+	chan_stream_write_block(Chan_Stream self, Block block)
+	{
+		if (block.size == 0)
+		{
+			if (block.ptr)
+				free_from(memory::clib(), block);
+			return;
+		}
+
+		chan_stream_ref(self);
+		mn_defer(chan_stream_unref(self));
+
+		mutex_lock(self->mtx);
+		// we also wait for the copied bytes to be read to keep the bytes in order
+		cond_var_wait(self->write_cv, self->mtx, [self] {
+			return (self->data_blob.size == 0 && self->ring_count == 0 && _chan_stream_blocks_full(self) == false) ||
+				chan_stream_closed(self);
+		});
+
+		if (chan_stream_closed(self))
+		{
+			mutex_unlock(self->mtx);
+			free_from(memory::clib(), block);
+			panic("cannot write in a closed Chan_Stream");
+		}
+
+		ring_push_back(self->blocks, block);
+		self->blocks_size += block.size;
+		mutex_unlock(self->mtx);
+
+		cond_var_notify(self->read_cv);
+	}
+
+	Block
+	chan_stream_read_block(Chan_Stream self)
+	{
+		chan_stream_ref(self);
+		mn_defer(chan_stream_unref(self));
+
+		mutex_lock(self->mtx);
+		_chan_stream_wait_readable(self);
+
+		Block res{};
+		if (self->blocks.count > 0 && self->blocks_offset == 0)
+		{
+			// hand over the block itself without copying
+			res = ring_front(self->blocks);
+			ring_pop_front(self->blocks);
+			self->blocks_size -= res.size;
+		}
+		else if (self->blocks.count > 0)
+		{
+			// the front block was partially read using stream_read, so we copy its remaining bytes
+			res = alloc_from(memory::clib(), ring_front(self->blocks).size - self->blocks_offset, alignof(char));
+			_chan_stream_blocks_read(self, res);
+		}
+		else if (self->ring_count > 0)
+		{
+			res = alloc_from(memory::clib(), self->ring_count, alignof(char));
+			_chan_stream_ring_read(self, res);
+		}
+		else if (self->data_blob.size > 0)
+		{
+			res = alloc_from(memory::clib(), self->data_blob.size, alignof(char));
+			_chan_stream_blob_read(self, res);
+		}
+
+		mutex_unlock(self->mtx);
+
+		if (res.size > 0)
+			cond_var_notify_all(self->write_cv);
+
+		return res;
+	}
+
+	void
+	_chan_select_waiters_notify(Buf<Chan_Select_Waiter*>& waiters)
+	{
+		for (auto waiter: waiters)
+			_worker_waiter_signal(waiter);
+	}
+
+	size_t
+	chan_select(const Chan_Select_Case* cases, size_t count, Timeout timeout)
+	{
+		// start from a different case each time so that a busy channel doesn't starve the rest
+		thread_local size_t start_index = 0;
+		auto start = start_index++;
+		auto try_cases = [&]() -> size_t {
+			for (size_t i = 0; i < count; ++i)
+			{
+				auto index = (start + i) % count;
+				if (cases[index].try_op(cases[index].chan, cases[index].value))
+					return index;
+			}
+			return CHAN_SELECT_TIMEOUT;
+		};
+
+		auto res = try_cases();
+		if (res != CHAN_SELECT_TIMEOUT || timeout == NO_TIMEOUT)
+			return res;
+
+		auto deadline = UINT64_MAX;
+		if (timeout != INFINITE_TIMEOUT)
+			deadline = time_in_millis() + timeout.milliseconds;
+
+		Chan_Select_Waiter waiter{};
+		while (true)
+		{
+			// register before trying the cases again so that we don't miss the changes which happen in between
+			_worker_waiter_reset(&waiter);
+			for (size_t i = 0; i < count; ++i)
+				cases[i].waiter_add(cases[i].chan, &waiter);
+
+			res = try_cases();
+			if (res == CHAN_SELECT_TIMEOUT)
+				_worker_waiter_wait(&waiter, deadline);
+
+			// the channels touch the waiter while they hold their mutexes so it's safe to go out of scope after this
+			for (size_t i = 0; i < count; ++i)
+				cases[i].waiter_remove(cases[i].chan, &waiter);
+
+			if (res != CHAN_SELECT_TIMEOUT || time_in_millis() >= deadline)
+				return res;
+		}
+	}
+
+	void
+	_future_continuation_add(std::atomic<Future_Continuation*>& continuations, Task<void()> fn)
+	{
+		auto node = alloc_from<Future_Continuation>(memory::clib());
+		node->fn = fn;
+		node->next = continuations.load(std::memory_order_acquire);
+		while (node->next != FUTURE_CONTINUATIONS_CLOSED)
+		{
+			if (continuations.compare_exchange_weak(node->next, node, std::memory_order_acq_rel, std::memory_order_acquire))
+				return;
+		}
+
+		// the future is already completed
+		free_from(memory::clib(), node);
+		fn();
+		task_free(fn);
+	}
+
+	void
+	_future_complete(std::atomic<int32_t>& state, std::atomic<Future_Continuation*>& continuations)
+	{
+		// the continuations are taken before the future is published as ready, once it's ready the waiters might free
+		// it so we can't touch it anymore, the continuations hold their own references to the future
+		auto it = continuations.exchange(FUTURE_CONTINUATIONS_CLOSED, std::memory_order_acq_rel);
+		mn_assert_msg(it != FUTURE_CONTINUATIONS_CLOSED, "future is already completed");
+
+		auto old_state = state.exchange(FUTURE_STATE_READY, std::memory_order_acq_rel);
+		if (old_state == FUTURE_STATE_PENDING_WITH_SLEEPERS)
+			futex_wake_all(&state);
+
+		// the continuations are pushed to the front so we reverse them to run them in order
+		Future_Continuation* ordered = nullptr;
+		while (it)
+		{
+			auto next = it->next;
+			it->next = ordered;
+			ordered = it;
+			it = next;
+		}
+
+		while (ordered)
+		{
+			auto next = ordered->next;
+			ordered->fn();
+			task_free(ordered->fn);
+			free_from(memory::clib(), ordered);
+			ordered = next;
+		}
+	}
+
+	void
+	_future_wait(std::atomic<int32_t>& state, std::atomic<Future_Continuation*>& continuations)
+	{
+		if (state.load(std::memory_order_acquire) == FUTURE_STATE_READY)
+			return;
+
+		// fibers are resumed by a continuation, it runs right away if the future is already completed
+		if (worker_on_fiber())
+		{
+			Worker_Waiter waiter{};
+			_future_continuation_add(continuations, fabric_task_make([waiter = &waiter] {
+				_worker_waiter_signal(waiter);
+			}));
+			_worker_waiter_wait(&waiter);
+			return;
+		}
+
+		auto ready = [](void* arg) -> bool {
+			return ((std::atomic<int32_t>*)arg)->load(std::memory_order_acquire) == FUTURE_STATE_READY;
+		};
+		if (_worker_help_until(ready, &state))
+			return;
+
+		worker_block_ahead();
+		while (true)
+		{
+			auto value = state.load(std::memory_order_acquire);
+			if (value == FUTURE_STATE_READY)
+				break;
+
+			// announce that there's a sleeper so that the completer wakes us up
+			if (value == FUTURE_STATE_PENDING &&
+				state.compare_exchange_weak(value, FUTURE_STATE_PENDING_WITH_SLEEPERS, std::memory_order_acq_rel) == false)
+				continue;
+
+			futex_wait(&state, FUTURE_STATE_PENDING_WITH_SLEEPERS);
+		}
+		worker_block_clear();
+	}
+
+	// strand
+	// how many tasks a strand runs before it gives the worker back to the rest of the fabric's tasks
+	constexpr static size_t STRAND_RUN_BUDGET = 64;
+
+	struct Strand_Node
+	{
+		std::atomic<Strand_Node*> next;
+		Task<void()> task;
+	};
+
+	struct IStrand
+	{
+		Fabric fabric;
+		FABRIC_TASK_PRIORITY priority;
+		// intrusive multi-producer single-consumer queue, the producers push at the tail and only the running strand
+		// pops from the head, the stub node is used to keep the queue non-empty
+		std::atomic<Strand_Node*> tail;
+		Strand_Node* head;
+		Strand_Node stub;
+		// number of the posted tasks which haven't finished yet, the strand is scheduled in the fabric while it's not 0
+		// and the posting thread which moves it from 0 to 1 is the one which schedules it
+		std::atomic<size_t> atomic_pending;
+		std::atomic<int32_t> atomic_arc;
+	};
+
+	inline static void
+	_strand_unref(Strand self)
+	{
+		if (self->atomic_arc.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			free(self);
+	}
+
+	inline static void
+	_strand_push(Strand self, Strand_Node* node)
+	{
+		node->next.store(nullptr, std::memory_order_relaxed);
+		auto prev = self->tail.exchange(node, std::memory_order_acq_rel);
+		prev->next.store(node, std::memory_order_release);
+	}
+
+	// returns nullptr if the queue is empty or if a producer is in the middle of pushing a node
+	inline static Strand_Node*
+	_strand_pop(Strand self)
+	{
+		auto head = self->head;
+		auto next = head->next.load(std::memory_order_acquire);
+		if (head == &self->stub)
+		{
+			if (next == nullptr)
+				return nullptr;
+			self->head = next;
+			head = next;
+			next = next->next.load(std::memory_order_acquire);
+		}
+
+		if (next)
+		{
+			self->head = next;
+			return head;
+		}
+
+		if (head != self->tail.load(std::memory_order_acquire))
+			return nullptr;
+
+		// head is the last node, we push the stub behind it so that we can pop it without losing the tail
+		_strand_push(self, &self->stub);
+		next = head->next.load(std::memory_order_acquire);
+		if (next)
+		{
+			self->head = next;
+			return head;
+		}
+		return nullptr;
+	}
+
+	inline static void
+	_strand_schedule(Strand self);
+
+	inline static void
+	_strand_run(Strand self)
+	{
+		for (size_t i = 0; i < STRAND_RUN_BUDGET; ++i)
+		{
+			// the pending count says there's a task, but its producer (or a producer before it) might not have
+			// linked its node yet, it's a couple of instructions away so we just wait for it
+			auto node = _strand_pop(self);
+			for (size_t spin = 0; node == nullptr; ++spin)
+			{
+				if (spin < 64)
+					_cpu_pause();
+				else
+					thread_yield();
+				node = _strand_pop(self);
+			}
+
+			node->task();
+			task_free(node->task);
+			free_from(memory::clib(), node);
+
+			if (self->atomic_pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			{
+				// the strand isn't scheduled anymore, so it releases the reference it held while it was scheduled
+				_strand_unref(self);
+				return;
+			}
+		}
+
+		// let the rest of the fabric's tasks run and continue later
+		_strand_schedule(self);
+	}
+
+	inline static void
+	_strand_schedule(Strand self)
+	{
+		Fabric_Task entry{};
+		entry.task = fabric_task_make([self] { _strand_run(self); });
+		entry.priority = self->priority;
+		_fabric_submit_job(self->fabric, _fabric_task_node_new(entry));
+	}
+
+	Strand
+	strand_new(Fabric f, FABRIC_TASK_PRIORITY priority)
+	{
+		auto self = alloc_construct<IStrand>();
+		self->fabric = f;
+		self->priority = priority;
+		self->tail = &self->stub;
+		self->head = &self->stub;
+		self->atomic_arc = 1;
+		return self;
+	}
+
+	void
+	strand_free(Strand self)
+	{
+		if (self == nullptr)
+			return;
+		_strand_unref(self);
+	}
+
+	void
+	strand_task_do(Strand self, Task<void()> task)
+	{
+		auto node = alloc_from<Strand_Node>(memory::clib());
+		::new (node) Strand_Node{};
+		node->task = task;
+		_strand_push(self, node);
+
+		if (self->atomic_pending.fetch_add(1, std::memory_order_acq_rel) == 0)
+		{
+			// the scheduled strand holds a reference so that it can outlive strand_free
+			self->atomic_arc.fetch_add(1, std::memory_order_relaxed);
+			_strand_schedule(self);
+		}
+	}
+
+	// Task Group
+	struct ITask_Group
+	{
+		Fabric fabric;
+		// the parent is kept alive by the child's reference so that the child can check its cancellation
+		Task_Group parent;
+		// time_in_millis() at which the group is cancelled, it's 0 if the group has no deadline
+		uint64_t deadline_in_ms;
+		std::atomic<bool> atomic_cancelled;
+		Waitgroup wg;
+		std::atomic<int32_t> atomic_arc;
+	};
+
+	inline static Task_Group
+	_task_group_new(Fabric f, Task_Group parent, Timeout timeout)
+	{
+		auto self = alloc_construct<ITask_Group>();
+		self->fabric = f;
+		self->parent = parent;
+		if (timeout != INFINITE_TIMEOUT)
+			self->deadline_in_ms = time_in_millis() + timeout.milliseconds;
+		if (parent && parent->deadline_in_ms != 0 && (self->deadline_in_ms == 0 || parent->deadline_in_ms < self->deadline_in_ms))
+			self->deadline_in_ms = parent->deadline_in_ms;
+		self->wg = waitgroup_new();
+		self->atomic_arc = 1;
+		if (parent)
+			parent->atomic_arc.fetch_add(1, std::memory_order_relaxed);
+		return self;
+	}
+
+	inline static void
+	_task_group_unref(Task_Group self)
+	{
+		while (self && self->atomic_arc.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		{
+			auto parent = self->parent;
+			waitgroup_free(self->wg);
+			free_destruct(self);
+			self = parent;
+		}
+	}
+
+	// API
+	Task_Group
+	task_group_new(Fabric f, Timeout timeout)
+	{
+		return _task_group_new(f, nullptr, timeout);
+	}
+
+	Task_Group
+	task_group_new_child(Task_Group parent, Timeout timeout)
+	{
+		return _task_group_new(parent->fabric, parent, timeout);
+	}
+
+	void
+	task_group_free(Task_Group self)
+	{
+		if (self == nullptr)
+			return;
+
+		waitgroup_wait(self->wg);
+		_task_group_unref(self);
+	}
+
+	void
+	task_group_task_do(Task_Group self, Task<void()> task)
+	{
+		// there's no point in scheduling the tasks of a cancelled group
+		if (task_group_cancelled(self))
+		{
+			task_free(task);
+			return;
+		}
+
+		waitgroup_add(self->wg, 1);
+
+		Fabric_Task entry{};
+		entry.task = fabric_task_make([self, task]() mutable {
+			if (task_group_cancelled(self) == false)
+				task();
+			task_free(task);
+			waitgroup_done(self->wg);
+		});
+
+		// the fabric frees the wrapper if it rejects it, but the wrapper doesn't own our copy of the task
+		if (fabric_task_do(self->fabric, entry) == false)
+		{
+			task_free(task);
+			waitgroup_done(self->wg);
+		}
+	}
+
+	void
+	task_group_wait(Task_Group self)
+	{
+		waitgroup_wait(self->wg);
+	}
+
+	void
+	task_group_cancel(Task_Group self)
+	{
+		self->atomic_cancelled.store(true, std::memory_order_relaxed);
+	}
+
+	bool
+	task_group_cancelled(Task_Group self)
+	{
+		// the children check their parents instead of the parents keeping track of their children
+		for (auto it = self; it != nullptr; it = it->parent)
+			if (it->atomic_cancelled.load(std::memory_order_relaxed))
+				return true;
+
+		// the deadline already includes the parents' deadlines
+		if (self->deadline_in_ms != 0 && time_in_millis() >= self->deadline_in_ms)
+		{
+			self->atomic_cancelled.store(true, std::memory_order_relaxed);
+			return true;
+		}
+		return false;
+	}
+
+	Timeout
+	task_group_timeout(Task_Group self)
+	{
+		if (task_group_cancelled(self))
+			return NO_TIMEOUT;
+
+		if (self->deadline_in_ms == 0)
+			return INFINITE_TIMEOUT;
+
+		auto now = time_in_millis();
+		return Timeout{ self->deadline_in_ms > now ? self->deadline_in_ms - now : 0 };
+	}
 }
@@ -0,0 +1,208 @@
+#include "mn/Fabric.h"
+#include "mn/Map.h"
+#include "mn/Memory.h"
+#include "mn/Defer.h"
+#include "mn/Assert.h"
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <errno.h>
+
+namespace mn
+{
+	// the jobs which are waiting on a single file descriptor, epoll has one registration per descriptor so the read and
+	// write waits are merged into it
+	struct Fabric_Poller_Entry
+	{
+		Fabric_Task* jobs[FABRIC_IO_COUNT];
+		// the descriptor stays registered after its waits fire (one shot registrations are only disabled) so that the
+		// next wait on it is a single EPOLL_CTL_MOD
+		bool registered;
+	};
+
+	struct IFabric_Poller
+	{
+		int epoll;
+		int wake_fd;
+		Mutex mtx;
+		Map<int, Fabric_Poller_Entry> entries;
+		// the jobs which were ready when they were added, they're handed out by the next wait
+		Buf<Fabric_Task*> ready;
+	};
+
+	constexpr static int FABRIC_POLLER_EVENTS_COUNT = 64;
+
+	inline static bool
+	_fabric_poller_arm(Fabric_Poller self, int fd, Fabric_Poller_Entry& entry)
+	{
+		epoll_event event{};
+		event.events = EPOLLONESHOT;
+		if (entry.jobs[FABRIC_IO_READ])
+			event.events |= EPOLLIN | EPOLLRDHUP;
+		if (entry.jobs[FABRIC_IO_WRITE])
+			event.events |= EPOLLOUT;
+		event.data.fd = fd;
+
+		auto op = entry.registered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+		if (epoll_ctl(self->epoll, op, fd, &event) == 0)
+		{
+			entry.registered = true;
+			return true;
+		}
+
+		// closing a descriptor removes it from epoll, so the number might have been reused by a new descriptor
+		if (errno == ENOENT || errno == EEXIST)
+		{
+			op = (op == EPOLL_CTL_MOD) ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
+			if (epoll_ctl(self->epoll, op, fd, &event) == 0)
+			{
+				entry.registered = true;
+				return true;
+			}
+		}
+
+		entry.registered = false;
+		return false;
+	}
+
+	// moves the jobs of the given entry to the ready list, it's used for the descriptors which epoll doesn't support
+	inline static void
+	_fabric_poller_entry_ready(Fabric_Poller self, Fabric_Poller_Entry& entry)
+	{
+		for (size_t i = 0; i < FABRIC_IO_COUNT; ++i)
+		{
+			if (entry.jobs[i])
+				buf_push(self->ready, entry.jobs[i]);
+			entry.jobs[i] = nullptr;
+		}
+	}
+
+	Fabric_Poller
+	_fabric_poller_new()
+	{
+		auto self = alloc_zerod_from<IFabric_Poller>(memory::clib());
+		self->epoll = epoll_create1(EPOLL_CLOEXEC);
+		mn_assert_msg(self->epoll != -1, "epoll_create1 failed");
+		self->wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+		mn_assert_msg(self->wake_fd != -1, "eventfd failed");
+
+		epoll_event event{};
+		event.events = EPOLLIN;
+		event.data.fd = self->wake_fd;
+		[[maybe_unused]] auto res = epoll_ctl(self->epoll, EPOLL_CTL_ADD, self->wake_fd, &event);
+		mn_assert(res == 0);
+
+		self->mtx = mn_mutex_new_with_srcloc("fabric poller mutex");
+		self->entries = map_with_allocator<int, Fabric_Poller_Entry>(memory::clib());
+		self->ready = buf_with_allocator<Fabric_Task*>(memory::clib());
+		return self;
+	}
+
+	void
+	_fabric_poller_free(Fabric_Poller self, Buf<Fabric_Task*>& pending)
+	{
+		for (auto& it: self->entries)
+		{
+			for (auto job: it.value.jobs)
+				if (job)
+					buf_push(pending, job);
+		}
+		for (auto job: self->ready)
+			buf_push(pending, job);
+
+		::close(self->wake_fd);
+		::close(self->epoll);
+		mutex_free(self->mtx);
+		map_free(self->entries);
+		buf_free(self->ready);
+		free_from(memory::clib(), self);
+	}
+
+	void
+	_fabric_poller_add(Fabric_Poller self, int64_t handle, FABRIC_IO io, Fabric_Task* job)
+	{
+		auto fd = int(handle);
+
+		mutex_lock(self->mtx);
+		mn_defer(mutex_unlock(self->mtx));
+
+		auto it = map_lookup(self->entries, fd);
+		if (it == nullptr)
+			it = map_insert(self->entries, fd, Fabric_Poller_Entry{});
+
+		auto& entry = it->value;
+		mn_assert_msg(entry.jobs[io] == nullptr, "the handle already has a pending task for this io");
+		entry.jobs[io] = job;
+
+		// epoll refuses the descriptors which are always ready (e.g. regular files)
+		if (_fabric_poller_arm(self, fd, entry) == false)
+		{
+			_fabric_poller_entry_ready(self, entry);
+			_fabric_poller_wake(self);
+		}
+	}
+
+	void
+	_fabric_poller_wait(Fabric_Poller self, Buf<Fabric_Task*>& ready)
+	{
+		epoll_event events[FABRIC_POLLER_EVENTS_COUNT];
+		auto count = epoll_wait(self->epoll, events, FABRIC_POLLER_EVENTS_COUNT, -1);
+
+		mutex_lock(self->mtx);
+		mn_defer(mutex_unlock(self->mtx));
+
+		for (auto job: self->ready)
+			buf_push(ready, job);
+		buf_clear(self->ready);
+
+		for (int i = 0; i < count; ++i)
+		{
+			auto fd = events[i].data.fd;
+			if (fd == self->wake_fd)
+			{
+				uint64_t value = 0;
+				[[maybe_unused]] auto res = ::read(self->wake_fd, &value, sizeof(value));
+				continue;
+			}
+
+			auto it = map_lookup(self->entries, fd);
+			if (it == nullptr)
+				continue;
+
+			// errors and hang ups wake up both sides so that their io calls report them
+			auto& entry = it->value;
+			auto flags = events[i].events;
+			auto failed = (flags & (EPOLLERR | EPOLLHUP)) != 0;
+			if (entry.jobs[FABRIC_IO_READ] && (failed || (flags & (EPOLLIN | EPOLLRDHUP))))
+			{
+				buf_push(ready, entry.jobs[FABRIC_IO_READ]);
+				entry.jobs[FABRIC_IO_READ] = nullptr;
+			}
+			if (entry.jobs[FABRIC_IO_WRITE] && (failed || (flags & EPOLLOUT)))
+			{
+				buf_push(ready, entry.jobs[FABRIC_IO_WRITE]);
+				entry.jobs[FABRIC_IO_WRITE] = nullptr;
+			}
+
+			// the one shot registration is disabled now, so it's armed again for the side which is still waiting
+			if (entry.jobs[FABRIC_IO_READ] || entry.jobs[FABRIC_IO_WRITE])
+			{
+				if (_fabric_poller_arm(self, fd, entry) == false)
+				{
+					_fabric_poller_entry_ready(self, entry);
+					for (auto job: self->ready)
+						buf_push(ready, job);
+					buf_clear(self->ready);
+				}
+			}
+		}
+	}
+
+	void
+	_fabric_poller_wake(Fabric_Poller self)
+	{
+		uint64_t value = 1;
+		[[maybe_unused]] auto res = ::write(self->wake_fd, &value, sizeof(value));
+	}
+}
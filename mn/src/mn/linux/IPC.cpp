@@ -249,6 +249,15 @@ namespace mn::ipc
 		return res;
 	}
 
+	bool
+	sputnik_can_read(Sputnik self)
+	{
+		pollfd pfd{};
+		pfd.fd = self->linux_domain_socket;
+		pfd.events = POLLIN;
+		return poll(&pfd, 1, 0) != 0;
+	}
+
 	bool
 	sputnik_disconnect(Sputnik self)
 	{
@@ -157,6 +157,7 @@ namespace mn
 		int res = ::getaddrinfo(nullptr, port.ptr, &hints, &info);
 		if (res != 0)
 			return false;
+		mn_defer(::freeaddrinfo(info));
 
 		res = ::bind(self->handle, info->ai_addr, int(info->ai_addrlen));
 		if (res == -1)
@@ -232,6 +233,17 @@ namespace mn
 		else
 			milliseconds = int(timeout.milliseconds);
 
+		// fabric fibers are suspended until the socket is readable instead of blocking the worker thread
+		if (milliseconds != 0 && worker_on_fiber())
+		{
+			auto deadline = milliseconds == -1 ? UINT64_MAX : time_in_millis() + uint64_t(milliseconds);
+			worker_suspend_until([&] {
+				auto pfd = pfd_read;
+				return ::poll(&pfd, 1, 0) != 0 || time_in_millis() >= deadline;
+			});
+			milliseconds = 0;
+		}
+
 		ssize_t res = 0;
 		worker_block_ahead();
 		mn_defer(worker_block_clear());
@@ -270,4 +282,22 @@ namespace mn
 	{
 		return self->handle;
 	}
+
+	bool
+	socket_can_read(Socket self)
+	{
+		pollfd pfd{};
+		pfd.fd = self->handle;
+		pfd.events = POLLIN;
+		return ::poll(&pfd, 1, 0) != 0;
+	}
+
+	bool
+	socket_can_write(Socket self)
+	{
+		pollfd pfd{};
+		pfd.fd = self->handle;
+		pfd.events = POLLOUT;
+		return ::poll(&pfd, 1, 0) != 0;
+	}
 }
\ No newline at end of file
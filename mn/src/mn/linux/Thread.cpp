@@ -9,8 +9,13 @@
 #include "mn/Assert.h"
 
 #include <pthread.h>
+#include <sched.h>
 #include <unistd.h>
 #include <sys/types.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <errno.h>
+#include <time.h>
 
 #include <chrono>
 
@@ -56,11 +61,18 @@ namespace mn
 		return &mtx.self;
 	}
 
+	// pthread_cond_timedwait expects an absolute time on the condition variable's clock which is CLOCK_REALTIME
 	static void
-	ms2ts(struct timespec *ts, unsigned long ms)
+	ms2deadline(struct timespec *ts, unsigned long ms)
 	{
-		ts->tv_sec = ms / 1000;
-		ts->tv_nsec = (ms % 1000) * 1000000;
+		clock_gettime(CLOCK_REALTIME, ts);
+		ts->tv_sec += ms / 1000;
+		ts->tv_nsec += (ms % 1000) * 1000000;
+		if (ts->tv_nsec >= 1000000000)
+		{
+			ts->tv_sec += 1;
+			ts->tv_nsec -= 1000000000;
+		}
 	}
 
 	// Deadlock detector
@@ -619,6 +631,64 @@ namespace mn
 		usleep(milliseconds * 1000);
 	}
 
+	void
+	thread_yield()
+	{
+		sched_yield();
+	}
+
+	bool
+	thread_pin_current(int32_t cpu)
+	{
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		if (cpu < 0)
+		{
+			auto count = sysconf(_SC_NPROCESSORS_CONF);
+			for (long i = 0; i < count && i < CPU_SETSIZE; ++i)
+				CPU_SET(i, &set);
+		}
+		else
+		{
+			if (cpu >= CPU_SETSIZE)
+				return false;
+			CPU_SET(cpu, &set);
+		}
+		return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+	}
+
+	bool
+	futex_wait(std::atomic<int32_t>* address, int32_t expected, Timeout timeout)
+	{
+		static_assert(sizeof(std::atomic<int32_t>) == sizeof(int32_t), "futex word should be a plain 32-bit integer");
+
+		timespec ts{};
+		timespec* ts_ptr = nullptr;
+		if (timeout != INFINITE_TIMEOUT)
+		{
+			ts.tv_sec = timeout.milliseconds / 1000;
+			ts.tv_nsec = (timeout.milliseconds % 1000) * 1000000;
+			ts_ptr = &ts;
+		}
+
+		worker_block_ahead();
+		auto res = syscall(SYS_futex, (int32_t*)address, FUTEX_WAIT_PRIVATE, expected, ts_ptr, nullptr, 0);
+		worker_block_clear();
+		return res == 0 || errno != ETIMEDOUT;
+	}
+
+	void
+	futex_wake_one(std::atomic<int32_t>* address)
+	{
+		syscall(SYS_futex, (int32_t*)address, FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+	}
+
+	void
+	futex_wake_all(std::atomic<int32_t>* address)
+	{
+		syscall(SYS_futex, (int32_t*)address, FUTEX_WAKE_PRIVATE, INT32_MAX, nullptr, nullptr, 0);
+	}
+
 
 	uint64_t
 	time_in_millis()
@@ -665,7 +735,7 @@ namespace mn
 	cond_var_wait_timeout(Cond_Var self, Mutex mtx, uint32_t millis)
 	{
 		timespec ts{};
-		ms2ts(&ts, millis);
+		ms2deadline(&ts, millis);
 
 		worker_block_ahead();
 		_deadlock_detector_mutex_unset_owner(mtx);
@@ -700,6 +770,8 @@ namespace mn
 		int count;
 		pthread_mutex_t mtx;
 		pthread_cond_t cv;
+		// fabric fibers wait on the signal so that they're resumed once the count reaches zero instead of being polled
+		Worker_Signal signal;
 	};
 
 	Waitgroup
@@ -711,6 +783,7 @@ namespace mn
 		mn_assert(res == 0);
 		res = pthread_cond_init(&self->cv, NULL);
 		mn_assert(res == 0);
+		self->signal = worker_signal_new();
 		return self;
 	}
 
@@ -721,12 +794,25 @@ namespace mn
 		mn_assert(res == 0);
 		res = pthread_cond_destroy(&self->cv);
 		mn_assert(res == 0);
+		worker_signal_free(self->signal);
 		free(self);
 	}
 
 	void
 	waitgroup_wait(Waitgroup self)
 	{
+		// fabric fibers are suspended instead of blocking the worker thread
+		if (worker_on_fiber())
+		{
+			worker_block_on_signal(self->signal, [self] {
+				pthread_mutex_lock(&self->mtx);
+				auto res = self->count == 0;
+				pthread_mutex_unlock(&self->mtx);
+				return res;
+			});
+			return;
+		}
+
 		worker_block_ahead();
 		mn_defer(worker_block_clear());
 
@@ -760,6 +846,24 @@ namespace mn
 		mn_assert(self->count >= 0);
 
 		if (self->count == 0)
+		{
 			pthread_cond_broadcast(&self->cv);
+			worker_signal_notify(self->signal);
+		}
+	}
+
+	int
+	waitgroup_count(Waitgroup self)
+	{
+		pthread_mutex_lock(&self->mtx);
+		mn_defer(pthread_mutex_unlock(&self->mtx));
+
+		return self->count;
+	}
+
+	Worker_Signal
+	_waitgroup_signal(Waitgroup self)
+	{
+		return self->signal;
 	}
 }
@@ -0,0 +1,200 @@
+#include "mn/Topology.h"
+#include "mn/Defer.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <dirent.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+namespace mn
+{
+	// sysfs files report a size of 4096 no matter what they contain, so we read them using stdio
+	// instead of file_content_str
+	inline static bool
+	_topology_read_line(const char* path, char* line, size_t size)
+	{
+		auto f = ::fopen(path, "r");
+		if (f == nullptr)
+			return false;
+		mn_defer(::fclose(f));
+
+		if (::fgets(line, int(size), f) == nullptr)
+			return false;
+		line[::strcspn(line, "\n")] = '\0';
+		return true;
+	}
+
+	inline static int32_t
+	_topology_read_int(const char* path, int32_t default_value)
+	{
+		char line[64];
+		int value = 0;
+		if (_topology_read_line(path, line, sizeof(line)) == false || ::sscanf(line, "%d", &value) != 1)
+			return default_value;
+		return int32_t(value);
+	}
+
+	// parses sysfs cpu lists like "0-3,8-11" and calls the given function for each cpu in it
+	template<typename TFunc>
+	inline static bool
+	_topology_read_cpu_list(const char* path, TFunc&& fn)
+	{
+		char line[4096];
+		if (_topology_read_line(path, line, sizeof(line)) == false)
+			return false;
+
+		char* state = nullptr;
+		for (auto it = ::strtok_r(line, ",", &state); it != nullptr; it = ::strtok_r(nullptr, ",", &state))
+		{
+			int first = 0, last = 0;
+			auto count = ::sscanf(it, "%d-%d", &first, &last);
+			if (count == 1)
+				last = first;
+			else if (count != 2)
+				continue;
+
+			for (int cpu = first; cpu <= last; ++cpu)
+				fn(int32_t(cpu));
+		}
+		return true;
+	}
+
+	// reads the cache size of the given sysfs cache index folder, sizes are in the form of "32K"
+	inline static size_t
+	_topology_read_cache_size(const char* path)
+	{
+		char line[64];
+		size_t value = 0;
+		char unit = 0;
+		if (_topology_read_line(path, line, sizeof(line)) == false)
+			return 0;
+
+		auto count = ::sscanf(line, "%zu%c", &value, &unit);
+		if (count < 1)
+			return 0;
+		if (count == 2 && unit == 'K')
+			value *= 1024;
+		else if (count == 2 && unit == 'M')
+			value *= 1024 * 1024;
+		return value;
+	}
+
+	inline static Topology_CPU*
+	_topology_find_cpu(Topology& self, int32_t id)
+	{
+		for (auto& cpu: self.cpus)
+			if (cpu.id == id)
+				return &cpu;
+		return nullptr;
+	}
+
+	inline static void
+	_topology_fallback(Topology& self)
+	{
+		auto count = ::sysconf(_SC_NPROCESSORS_ONLN);
+		if (count < 1)
+			count = 1;
+		for (int32_t i = 0; i < int32_t(count); ++i)
+			buf_push(self.cpus, Topology_CPU{ i, i, 0, 0, 0 });
+	}
+
+	// API
+	Topology
+	topology_new()
+	{
+		Topology self{};
+		self.cpus = buf_new<Topology_CPU>();
+
+		char path[256];
+		auto has_cpus = _topology_read_cpu_list("/sys/devices/system/cpu/online", [&](int32_t id) {
+			buf_push(self.cpus, Topology_CPU{ id, id, 0, 0, id });
+		});
+		if (has_cpus == false || self.cpus.count == 0)
+			_topology_fallback(self);
+
+		for (auto& cpu: self.cpus)
+		{
+			::snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/core_id", cpu.id);
+			cpu.core_id = _topology_read_int(path, cpu.id);
+			::snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/physical_package_id", cpu.id);
+			cpu.package_id = _topology_read_int(path, 0);
+			if (cpu.package_id < 0)
+				cpu.package_id = 0;
+
+			// the last level cache is the highest level data/unified cache, its shared cpu list starts with the
+			// same cpu for all the cpus which share it so we use it as the id
+			int32_t llc_level = 0;
+			for (int index = 0; ; ++index)
+			{
+				::snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cache/index%d/level", cpu.id, index);
+				auto level = _topology_read_int(path, -1);
+				if (level < 0)
+					break;
+
+				char type[32];
+				::snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cache/index%d/type", cpu.id, index);
+				if (_topology_read_line(path, type, sizeof(type)) && ::strcmp(type, "Instruction") == 0)
+					continue;
+
+				if (level >= llc_level)
+				{
+					::snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cache/index%d/shared_cpu_list", cpu.id, index);
+					auto llc_id = _topology_read_int(path, cpu.id);
+					llc_level = level;
+					cpu.llc_id = llc_id;
+				}
+
+				if (&cpu == self.cpus.ptr)
+				{
+					::snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cache/index%d/size", cpu.id, index);
+					auto size = _topology_read_cache_size(path);
+					if (level == 1)
+						self.l1d_cache_size = size;
+					else if (level == 2)
+						self.l2_cache_size = size;
+					else if (level == 3)
+						self.l3_cache_size = size;
+
+					::snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cache/index%d/coherency_line_size", cpu.id, index);
+					if (self.cache_line_size == 0)
+						self.cache_line_size = size_t(_topology_read_int(path, 0));
+				}
+			}
+		}
+
+		// numa nodes list their cpus, systems without numa support don't have the node folder at all
+		if (auto dir = ::opendir("/sys/devices/system/node"))
+		{
+			mn_defer(::closedir(dir));
+			while (auto entry = ::readdir(dir))
+			{
+				int node_id = 0;
+				if (::strncmp(entry->d_name, "node", 4) != 0 || ::sscanf(entry->d_name + 4, "%d", &node_id) != 1)
+					continue;
+
+				::snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node_id);
+				_topology_read_cpu_list(path, [&](int32_t id) {
+					if (auto cpu = _topology_find_cpu(self, id))
+						cpu->node_id = node_id;
+				});
+			}
+		}
+
+		// count the distinct cores, packages and nodes
+		auto ids = buf_with_allocator<int64_t>(memory::tmp());
+		auto count_distinct = [&ids](const Buf<Topology_CPU>& cpus, auto&& key) {
+			buf_clear(ids);
+			for (const auto& cpu: cpus)
+				buf_push(ids, key(cpu));
+			std::sort(ids.ptr, ids.ptr + ids.count);
+			return size_t(std::unique(ids.ptr, ids.ptr + ids.count) - ids.ptr);
+		};
+		self.cores_count = count_distinct(self.cpus, [](const Topology_CPU& cpu) { return (int64_t(cpu.package_id) << 32) | uint32_t(cpu.core_id); });
+		self.packages_count = count_distinct(self.cpus, [](const Topology_CPU& cpu) { return int64_t(cpu.package_id); });
+		self.nodes_count = count_distinct(self.cpus, [](const Topology_CPU& cpu) { return int64_t(cpu.node_id); });
+
+		return self;
+	}
+} // namespace mn
\ No newline at end of file
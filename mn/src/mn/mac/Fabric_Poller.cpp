@@ -0,0 +1,129 @@
+#include "mn/Fabric.h"
+#include "mn/Map.h"
+#include "mn/Memory.h"
+#include "mn/Defer.h"
+#include "mn/Assert.h"
+
+#include <sys/types.h>
+#include <sys/event.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+namespace mn
+{
+	struct IFabric_Poller
+	{
+		int kq;
+		Mutex mtx;
+		// the waiting jobs keyed by the descriptor and the io (fd * FABRIC_IO_COUNT + io), kqueue has a separate one shot
+		// registration for each filter so the read and write waits on the same descriptor are independent
+		Map<int64_t, Fabric_Task*> jobs;
+		// the jobs which were ready when they were added, they're handed out by the next wait
+		Buf<Fabric_Task*> ready;
+	};
+
+	constexpr static int FABRIC_POLLER_EVENTS_COUNT = 64;
+	// the identifier of the user event which wakes the waiting thread up
+	constexpr static uintptr_t FABRIC_POLLER_WAKE_IDENT = 0;
+
+	inline static int64_t
+	_fabric_poller_key(int64_t fd, FABRIC_IO io)
+	{
+		return fd * FABRIC_IO_COUNT + io;
+	}
+
+	Fabric_Poller
+	_fabric_poller_new()
+	{
+		auto self = alloc_zerod_from<IFabric_Poller>(memory::clib());
+		self->kq = kqueue();
+		mn_assert_msg(self->kq != -1, "kqueue failed");
+
+		struct kevent change{};
+		EV_SET(&change, FABRIC_POLLER_WAKE_IDENT, EVFILT_USER, EV_ADD | EV_CLEAR, 0, 0, nullptr);
+		[[maybe_unused]] auto res = kevent(self->kq, &change, 1, nullptr, 0, nullptr);
+		mn_assert(res == 0);
+
+		self->mtx = mn_mutex_new_with_srcloc("fabric poller mutex");
+		self->jobs = map_with_allocator<int64_t, Fabric_Task*>(memory::clib());
+		self->ready = buf_with_allocator<Fabric_Task*>(memory::clib());
+		return self;
+	}
+
+	void
+	_fabric_poller_free(Fabric_Poller self, Buf<Fabric_Task*>& pending)
+	{
+		for (auto& it: self->jobs)
+			buf_push(pending, it.value);
+		for (auto job: self->ready)
+			buf_push(pending, job);
+
+		::close(self->kq);
+		mutex_free(self->mtx);
+		map_free(self->jobs);
+		buf_free(self->ready);
+		free_from(memory::clib(), self);
+	}
+
+	void
+	_fabric_poller_add(Fabric_Poller self, int64_t handle, FABRIC_IO io, Fabric_Task* job)
+	{
+		mutex_lock(self->mtx);
+		mn_defer(mutex_unlock(self->mtx));
+
+		auto key = _fabric_poller_key(handle, io);
+		mn_assert_msg(map_lookup(self->jobs, key) == nullptr, "the handle already has a pending task for this io");
+
+		struct kevent change{};
+		auto filter = io == FABRIC_IO_READ ? EVFILT_READ : EVFILT_WRITE;
+		EV_SET(&change, uintptr_t(handle), filter, EV_ADD | EV_ONESHOT, 0, 0, nullptr);
+		if (kevent(self->kq, &change, 1, nullptr, 0, nullptr) == 0)
+		{
+			map_insert(self->jobs, key, job);
+		}
+		else
+		{
+			// kqueue refuses the descriptors which are always ready (e.g. writing to regular files)
+			buf_push(self->ready, job);
+			_fabric_poller_wake(self);
+		}
+	}
+
+	void
+	_fabric_poller_wait(Fabric_Poller self, Buf<Fabric_Task*>& ready)
+	{
+		struct kevent events[FABRIC_POLLER_EVENTS_COUNT];
+		auto count = kevent(self->kq, nullptr, 0, events, FABRIC_POLLER_EVENTS_COUNT, nullptr);
+
+		mutex_lock(self->mtx);
+		mn_defer(mutex_unlock(self->mtx));
+
+		for (auto job: self->ready)
+			buf_push(ready, job);
+		buf_clear(self->ready);
+
+		for (int i = 0; i < count; ++i)
+		{
+			if (events[i].filter == EVFILT_USER)
+				continue;
+
+			// the one shot registration is deleted once it fires, errors and end of file are reported as ready so that
+			// the io calls report them
+			auto io = events[i].filter == EVFILT_READ ? FABRIC_IO_READ : FABRIC_IO_WRITE;
+			auto key = _fabric_poller_key(int64_t(events[i].ident), io);
+			if (auto it = map_lookup(self->jobs, key))
+			{
+				buf_push(ready, it->value);
+				map_remove(self->jobs, key);
+			}
+		}
+	}
+
+	void
+	_fabric_poller_wake(Fabric_Poller self)
+	{
+		struct kevent change{};
+		EV_SET(&change, FABRIC_POLLER_WAKE_IDENT, EVFILT_USER, 0, NOTE_TRIGGER, 0, nullptr);
+		kevent(self->kq, &change, 1, nullptr, 0, nullptr);
+	}
+}
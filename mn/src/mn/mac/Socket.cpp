@@ -157,6 +157,7 @@ namespace mn
 		int res = ::getaddrinfo(nullptr, port.ptr, &hints, &info);
 		if (res != 0)
 			return false;
+		mn_defer(::freeaddrinfo(info));
 
 		res = ::bind(self->handle, info->ai_addr, int(info->ai_addrlen));
 		if (res == -1)
@@ -270,4 +271,22 @@ namespace mn
 	{
 		return self->handle;
 	}
+
+	bool
+	socket_can_read(Socket self)
+	{
+		pollfd pfd{};
+		pfd.fd = self->handle;
+		pfd.events = POLLIN;
+		return ::poll(&pfd, 1, 0) != 0;
+	}
+
+	bool
+	socket_can_write(Socket self)
+	{
+		pollfd pfd{};
+		pfd.fd = self->handle;
+		pfd.events = POLLOUT;
+		return ::poll(&pfd, 1, 0) != 0;
+	}
 }
@@ -9,11 +9,20 @@
 #include "mn/Assert.h"
 
 #include <pthread.h>
+#include <sched.h>
 #include <unistd.h>
 #include <sys/types.h>
+#include <errno.h>
 
 #include <chrono>
 
+// darwin's futex-like primitives which libc++'s std::atomic::wait uses, they are not part of the public headers
+extern "C" int __ulock_wait(uint32_t operation, void* address, uint64_t value, uint32_t timeout_in_us);
+extern "C" int __ulock_wake(uint32_t operation, void* address, uint64_t wake_value);
+#define UL_COMPARE_AND_WAIT 1
+#define ULF_WAKE_ALL 0x00000100
+#define ULF_NO_ERRNO 0x01000000
+
 namespace mn
 {
 	struct IMutex
@@ -621,6 +630,50 @@ namespace mn
 		usleep(milliseconds * 1000);
 	}
 
+	void
+	thread_yield()
+	{
+		sched_yield();
+	}
+
+	bool
+	thread_pin_current(int32_t)
+	{
+		// macOS doesn't support pinning threads to cpus, thread_policy_set affinity tags are only hints
+		return false;
+	}
+
+	bool
+	futex_wait(std::atomic<int32_t>* address, int32_t expected, Timeout timeout)
+	{
+		static_assert(sizeof(std::atomic<int32_t>) == sizeof(int32_t), "futex word should be a plain 32-bit integer");
+
+		uint32_t timeout_in_us = 0;
+		if (timeout != INFINITE_TIMEOUT)
+		{
+			// zero means infinite in __ulock_wait, so we wait for at least 1 microsecond
+			auto us = timeout.milliseconds * 1000;
+			timeout_in_us = us > UINT32_MAX ? UINT32_MAX : (us == 0 ? 1 : uint32_t(us));
+		}
+
+		worker_block_ahead();
+		auto res = __ulock_wait(UL_COMPARE_AND_WAIT | ULF_NO_ERRNO, (void*)address, uint64_t(uint32_t(expected)), timeout_in_us);
+		worker_block_clear();
+		return res >= 0 || res != -ETIMEDOUT;
+	}
+
+	void
+	futex_wake_one(std::atomic<int32_t>* address)
+	{
+		__ulock_wake(UL_COMPARE_AND_WAIT | ULF_NO_ERRNO, (void*)address, 0);
+	}
+
+	void
+	futex_wake_all(std::atomic<int32_t>* address)
+	{
+		__ulock_wake(UL_COMPARE_AND_WAIT | ULF_WAKE_ALL | ULF_NO_ERRNO, (void*)address, 0);
+	}
+
 
 	uint64_t
 	time_in_millis()
@@ -671,7 +724,8 @@ namespace mn
 
 		worker_block_ahead();
 		_deadlock_detector_mutex_unset_owner(mtx);
-		auto res = pthread_cond_timedwait(&self->cv, &mtx->handle, &ts);
+		// pthread_cond_timedwait expects an absolute time, so we use the relative variant instead
+		auto res = pthread_cond_timedwait_relative_np(&self->cv, &mtx->handle, &ts);
 		_deadlock_detector_mutex_set_exclusive_owner(mtx);
 		worker_block_clear();
 
@@ -702,6 +756,8 @@ namespace mn
 		int count;
 		pthread_mutex_t mtx;
 		pthread_cond_t cv;
+		// fabric fibers wait on the signal so that they're resumed once the count reaches zero instead of being polled
+		Worker_Signal signal;
 	};
 
 	Waitgroup
@@ -713,6 +769,7 @@ namespace mn
 		mn_assert(res == 0);
 		res = pthread_cond_init(&self->cv, NULL);
 		mn_assert(res == 0);
+		self->signal = worker_signal_new();
 		return self;
 	}
 
@@ -723,12 +780,25 @@ namespace mn
 		mn_assert(res == 0);
 		res = pthread_cond_destroy(&self->cv);
 		mn_assert(res == 0);
+		worker_signal_free(self->signal);
 		free(self);
 	}
 
 	void
 	waitgroup_wait(Waitgroup self)
 	{
+		// fabric fibers are suspended instead of blocking the worker thread
+		if (worker_on_fiber())
+		{
+			worker_block_on_signal(self->signal, [self] {
+				pthread_mutex_lock(&self->mtx);
+				auto res = self->count == 0;
+				pthread_mutex_unlock(&self->mtx);
+				return res;
+			});
+			return;
+		}
+
 		worker_block_ahead();
 		mn_defer(worker_block_clear());
 
@@ -762,6 +832,24 @@ namespace mn
 		mn_assert(self->count >= 0);
 
 		if (self->count == 0)
+		{
 			pthread_cond_broadcast(&self->cv);
+			worker_signal_notify(self->signal);
+		}
+	}
+
+	int
+	waitgroup_count(Waitgroup self)
+	{
+		pthread_mutex_lock(&self->mtx);
+		mn_defer(pthread_mutex_unlock(&self->mtx));
+
+		return self->count;
+	}
+
+	Worker_Signal
+	_waitgroup_signal(Waitgroup self)
+	{
+		return self->signal;
 	}
 }
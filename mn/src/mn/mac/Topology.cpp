@@ -0,0 +1,48 @@
+#include "mn/Topology.h"
+
+#include <sys/types.h>
+#include <sys/sysctl.h>
+
+namespace mn
+{
+	template<typename T>
+	inline static T
+	_topology_sysctl(const char* name, T default_value)
+	{
+		T value{};
+		size_t size = sizeof(value);
+		if (::sysctlbyname(name, &value, &size, nullptr, 0) != 0)
+			return default_value;
+		return value;
+	}
+
+	// API
+	Topology
+	topology_new()
+	{
+		Topology self{};
+		self.cpus = buf_new<Topology_CPU>();
+
+		// macOS doesn't expose which logical cpu belongs to which core, so we assume the SMT siblings are
+		// numbered next to each other, and there's a single package, node and last level cache
+		auto logical_count = _topology_sysctl<int32_t>("hw.logicalcpu", 1);
+		auto physical_count = _topology_sysctl<int32_t>("hw.physicalcpu", logical_count);
+		if (logical_count < 1)
+			logical_count = 1;
+		if (physical_count < 1 || physical_count > logical_count)
+			physical_count = logical_count;
+
+		auto smt_count = logical_count / physical_count;
+		for (int32_t i = 0; i < logical_count; ++i)
+			buf_push(self.cpus, Topology_CPU{ i, i / smt_count, 0, 0, 0 });
+
+		self.cores_count = size_t(physical_count);
+		self.packages_count = size_t(_topology_sysctl<int32_t>("hw.packages", 1));
+		self.nodes_count = 1;
+		self.l1d_cache_size = size_t(_topology_sysctl<int64_t>("hw.l1dcachesize", 0));
+		self.l2_cache_size = size_t(_topology_sysctl<int64_t>("hw.l2cachesize", 0));
+		self.l3_cache_size = size_t(_topology_sysctl<int64_t>("hw.l3cachesize", 0));
+		self.cache_line_size = size_t(_topology_sysctl<int64_t>("hw.cachelinesize", 0));
+		return self;
+	}
+} // namespace mn
\ No newline at end of file
@@ -16,6 +16,11 @@ namespace mn::memory
 		this->clear_all_readjust_threshold = 4ULL * 1024ULL * 1024ULL;
 		this->clear_all_current_highwater = 0;
 		this->clear_all_previous_highwater = 0;
+		this->retained = nullptr;
+		this->retained_mem = 0;
+		this->trim_highwater_mem = 0;
+		this->trim_peak_mem = 0;
+		this->generation = 0;
 	}
 
 	Arena::~Arena()
@@ -53,14 +58,31 @@ namespace mn::memory
 				return;
 		}
 
-		size_t request_size = size > this->block_size ? size : this->block_size;
-		request_size += sizeof(Node);
+		// reuse the first retained block which fits
+		Node* new_node = nullptr;
+		for (Node** it = &this->retained; *it != nullptr; it = &(*it)->next)
+		{
+			if ((*it)->mem.size >= size)
+			{
+				new_node = *it;
+				*it = new_node->next;
+				this->retained_mem -= new_node->mem.size;
+				break;
+			}
+		}
 
-		Node* new_node = (Node*)meta->alloc(request_size, alignof(int)).ptr;
-		this->total_mem += request_size - sizeof(Node);
+		if (new_node == nullptr)
+		{
+			size_t request_size = size > this->block_size ? size : this->block_size;
+			request_size += sizeof(Node);
+
+			new_node = (Node*)meta->alloc(request_size, alignof(int)).ptr;
+			new_node->mem.ptr = &new_node[1];
+			new_node->mem.size = request_size - sizeof(Node);
+		}
 
-		new_node->mem.ptr = &new_node[1];
-		new_node->mem.size = request_size - sizeof(Node);
+		this->total_mem += new_node->mem.size;
+		this->trim_peak_mem = this->trim_peak_mem > this->total_mem ? this->trim_peak_mem : this->total_mem;
 		new_node->alloc_head = (uint8_t*)new_node->mem.ptr;
 		new_node->next = this->head;
 		this->head = new_node;
@@ -78,6 +100,15 @@ namespace mn::memory
 		this->head = nullptr;
 		this->total_mem = 0;
 		this->used_mem = 0;
+
+		while (this->retained)
+		{
+			Node* next = this->retained->next;
+			meta->free(Block{ this->retained, this->retained->mem.size + sizeof(Node) });
+			this->retained = next;
+		}
+		this->retained_mem = 0;
+		++this->generation;
 	}
 
 	void
@@ -103,6 +134,7 @@ namespace mn::memory
 			this->head->alloc_head = (uint8_t*)this->head->mem.ptr;
 			this->used_mem = 0;
 			this->clear_all_current_highwater = 0;
+			++this->generation;
 		}
 	}
 
@@ -124,26 +156,49 @@ namespace mn::memory
 	{
 		State s{};
 		s.head = this->head;
-		s.alloc_head = this->head->alloc_head;
+		s.alloc_head = this->head ? this->head->alloc_head : nullptr;
 		s.total_mem = this->total_mem;
 		s.used_mem = this->used_mem;
 		s.highwater_mem = this->highwater_mem;
+		s.generation = this->generation;
 		return s;
 	}
 
 	void
 	Arena::restore(State s)
 	{
+		// the blocks of the checkpoint were already cleared
+		if (s.generation != this->generation)
+			return;
+
 		while (this->head != s.head)
 		{
 			Node* next = this->head->next;
-			meta->free(Block{ this->head, this->head->mem.size + sizeof(Node) });
+			this->head->next = this->retained;
+			this->retained = this->head;
+			this->retained_mem += this->head->mem.size;
 			this->head = next;
 		}
 		mn_assert(this->head == s.head);
-		this->head = s.head;
-		this->head->alloc_head = s.alloc_head;
+		if (this->head)
+			this->head->alloc_head = s.alloc_head;
 		this->total_mem = s.total_mem;
 		this->used_mem = s.used_mem;
 	}
+
+	void
+	Arena::trim()
+	{
+		auto decayed_highwater = this->trim_highwater_mem - (this->trim_highwater_mem >> 6);
+		this->trim_highwater_mem = this->trim_peak_mem > decayed_highwater ? this->trim_peak_mem : decayed_highwater;
+		this->trim_peak_mem = this->total_mem;
+
+		while (this->retained && this->total_mem + this->retained_mem > this->trim_highwater_mem)
+		{
+			Node* next = this->retained->next;
+			this->retained_mem -= this->retained->mem.size;
+			meta->free(Block{ this->retained, this->retained->mem.size + sizeof(Node) });
+			this->retained = next;
+		}
+	}
 }
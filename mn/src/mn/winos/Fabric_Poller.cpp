@@ -0,0 +1,321 @@
+#include "mn/Fabric.h"
+#include "mn/Memory.h"
+#include "mn/Defer.h"
+#include "mn/Assert.h"
+
+#include <WinSock2.h>
+#include <WS2tcpip.h>
+
+namespace mn
+{
+	// a socket and the jobs which are waiting on it, WSAPoll takes the read and write events of a socket in one entry
+	struct Fabric_Poller_Socket
+	{
+		SOCKET socket;
+		Fabric_Task* jobs[FABRIC_IO_COUNT];
+	};
+
+	// a zero byte overlapped read on a named pipe, it completes once the pipe has data (or is broken) without consuming
+	// anything, and a thread pool wait on its event hands the job to the poller
+	struct Fabric_Poller_Pipe
+	{
+		struct IFabric_Poller* poller;
+		HANDLE pipe;
+		OVERLAPPED overlapped;
+		HANDLE wait;
+		Fabric_Task* job;
+	};
+
+	struct IFabric_Poller
+	{
+		Mutex mtx;
+		// a non blocking udp socket bound to the loopback, the poller sends a byte to it to wake the waiting thread up
+		SOCKET wake_socket;
+		sockaddr_in wake_address;
+		Buf<Fabric_Poller_Socket> sockets;
+		// the pipes whose reads are pending, and the ones whose reads completed which the waiting thread frees
+		Buf<Fabric_Poller_Pipe*> pipes;
+		Buf<Fabric_Poller_Pipe*> completed_pipes;
+		// the jobs which are ready but not handed out yet
+		Buf<Fabric_Task*> ready;
+		// the poll entries of the waiting thread, the first one is the wake socket
+		Buf<WSAPOLLFD> pollfds;
+	};
+
+	inline static bool
+	_fabric_poller_is_socket(int64_t handle)
+	{
+		int type = 0;
+		int len = sizeof(type);
+		return getsockopt(SOCKET(handle), SOL_SOCKET, SO_TYPE, (char*)&type, &len) == 0;
+	}
+
+	inline static void
+	_fabric_poller_pipe_free(Fabric_Poller_Pipe* self)
+	{
+		// the os writes to the overlapped struct until the read is done, so it's canceled and waited on first
+		if (HasOverlappedIoCompleted(&self->overlapped) == FALSE)
+		{
+			CancelIoEx(self->pipe, &self->overlapped);
+			DWORD transferred = 0;
+			GetOverlappedResult(self->pipe, &self->overlapped, &transferred, TRUE);
+		}
+		CloseHandle(self->overlapped.hEvent);
+		free_from(memory::clib(), self);
+	}
+
+	static void CALLBACK
+	_fabric_poller_pipe_callback(void* arg, BOOLEAN)
+	{
+		auto pipe = (Fabric_Poller_Pipe*)arg;
+		auto self = pipe->poller;
+
+		mutex_lock(self->mtx);
+		// the pipe isn't in the list if the poller is being freed, in which case the poller takes care of it
+		bool found = false;
+		for (size_t i = 0; i < self->pipes.count; ++i)
+		{
+			if (self->pipes[i] == pipe)
+			{
+				buf_remove(self->pipes, i);
+				found = true;
+				break;
+			}
+		}
+		if (found)
+		{
+			buf_push(self->ready, pipe->job);
+			pipe->job = nullptr;
+			buf_push(self->completed_pipes, pipe);
+		}
+		mutex_unlock(self->mtx);
+
+		if (found)
+			_fabric_poller_wake(self);
+	}
+
+	Fabric_Poller
+	_fabric_poller_new()
+	{
+		auto self = alloc_zerod_from<IFabric_Poller>(memory::clib());
+		self->mtx = mn_mutex_new_with_srcloc("fabric poller mutex");
+
+		self->wake_socket = ::socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+		mn_assert_msg(self->wake_socket != INVALID_SOCKET, "failed to create the poller's wake socket");
+		self->wake_address.sin_family = AF_INET;
+		self->wake_address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		self->wake_address.sin_port = 0;
+		[[maybe_unused]] auto res = ::bind(self->wake_socket, (sockaddr*)&self->wake_address, sizeof(self->wake_address));
+		mn_assert(res == 0);
+		int len = sizeof(self->wake_address);
+		res = ::getsockname(self->wake_socket, (sockaddr*)&self->wake_address, &len);
+		mn_assert(res == 0);
+		u_long non_blocking = 1;
+		res = ::ioctlsocket(self->wake_socket, FIONBIO, &non_blocking);
+		mn_assert(res == 0);
+
+		self->sockets = buf_with_allocator<Fabric_Poller_Socket>(memory::clib());
+		self->pipes = buf_with_allocator<Fabric_Poller_Pipe*>(memory::clib());
+		self->completed_pipes = buf_with_allocator<Fabric_Poller_Pipe*>(memory::clib());
+		self->ready = buf_with_allocator<Fabric_Task*>(memory::clib());
+		self->pollfds = buf_with_allocator<WSAPOLLFD>(memory::clib());
+		return self;
+	}
+
+	void
+	_fabric_poller_free(Fabric_Poller self, Buf<Fabric_Task*>& pending)
+	{
+		// once their waits are unregistered the callbacks can't touch the pending pipes
+		auto pipes = buf_with_allocator<Fabric_Poller_Pipe*>(memory::clib());
+		mn_defer(buf_free(pipes));
+		mutex_lock(self->mtx);
+		std::swap(pipes, self->pipes);
+		mutex_unlock(self->mtx);
+
+		for (auto pipe: pipes)
+		{
+			UnregisterWaitEx(pipe->wait, INVALID_HANDLE_VALUE);
+			buf_push(pending, pipe->job);
+			_fabric_poller_pipe_free(pipe);
+		}
+
+		for (auto pipe: self->completed_pipes)
+		{
+			UnregisterWaitEx(pipe->wait, INVALID_HANDLE_VALUE);
+			_fabric_poller_pipe_free(pipe);
+		}
+
+		for (auto& socket: self->sockets)
+		{
+			for (auto job: socket.jobs)
+				if (job)
+					buf_push(pending, job);
+		}
+		for (auto job: self->ready)
+			buf_push(pending, job);
+
+		::closesocket(self->wake_socket);
+		mutex_free(self->mtx);
+		buf_free(self->sockets);
+		buf_free(self->pipes);
+		buf_free(self->completed_pipes);
+		buf_free(self->ready);
+		buf_free(self->pollfds);
+		free_from(memory::clib(), self);
+	}
+
+	void
+	_fabric_poller_add(Fabric_Poller self, int64_t handle, FABRIC_IO io, Fabric_Task* job)
+	{
+		if (_fabric_poller_is_socket(handle))
+		{
+			mutex_lock(self->mtx);
+			mn_defer(mutex_unlock(self->mtx));
+
+			Fabric_Poller_Socket* entry = nullptr;
+			for (auto& socket: self->sockets)
+			{
+				if (socket.socket == SOCKET(handle))
+				{
+					entry = &socket;
+					break;
+				}
+			}
+			if (entry == nullptr)
+			{
+				buf_push(self->sockets, Fabric_Poller_Socket{SOCKET(handle)});
+				entry = &buf_top(self->sockets);
+			}
+
+			mn_assert_msg(entry->jobs[io] == nullptr, "the handle already has a pending task for this io");
+			entry->jobs[io] = job;
+			// the waiting thread picks the new socket up once it wakes up
+			_fabric_poller_wake(self);
+			return;
+		}
+
+		// named pipes have no readiness notification for writes, their writes only block while the pipe buffer is full
+		if (io == FABRIC_IO_WRITE)
+		{
+			mutex_lock(self->mtx);
+			buf_push(self->ready, job);
+			mutex_unlock(self->mtx);
+			_fabric_poller_wake(self);
+			return;
+		}
+
+		auto pipe = alloc_zerod_from<Fabric_Poller_Pipe>(memory::clib());
+		pipe->poller = self;
+		pipe->pipe = (HANDLE)(intptr_t)handle;
+		pipe->overlapped.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+		pipe->job = job;
+
+		{
+			// the wait is registered while holding the mutex so that its callback can't run before the pipe is listed
+			mutex_lock(self->mtx);
+			mn_defer(mutex_unlock(self->mtx));
+
+			char buffer = 0;
+			auto res = ReadFile(pipe->pipe, &buffer, 0, NULL, &pipe->overlapped);
+			if (res == FALSE && GetLastError() == ERROR_IO_PENDING &&
+				RegisterWaitForSingleObject(&pipe->wait, pipe->overlapped.hEvent, _fabric_poller_pipe_callback, pipe, INFINITE, WT_EXECUTEONLYONCE))
+			{
+				buf_push(self->pipes, pipe);
+				return;
+			}
+
+			// the pipe has data already or it's broken, either way the read call won't block
+			buf_push(self->ready, job);
+		}
+
+		_fabric_poller_pipe_free(pipe);
+		_fabric_poller_wake(self);
+	}
+
+	void
+	_fabric_poller_wait(Fabric_Poller self, Buf<Fabric_Task*>& ready)
+	{
+		buf_clear(self->pollfds);
+		{
+			mutex_lock(self->mtx);
+			mn_defer(mutex_unlock(self->mtx));
+
+			WSAPOLLFD wake{};
+			wake.fd = self->wake_socket;
+			wake.events = POLLRDNORM;
+			buf_push(self->pollfds, wake);
+
+			for (const auto& socket: self->sockets)
+			{
+				WSAPOLLFD pfd{};
+				pfd.fd = socket.socket;
+				pfd.events = SHORT((socket.jobs[FABRIC_IO_READ] ? POLLRDNORM : 0) | (socket.jobs[FABRIC_IO_WRITE] ? POLLWRNORM : 0));
+				buf_push(self->pollfds, pfd);
+			}
+		}
+
+		WSAPoll(self->pollfds.ptr, ULONG(self->pollfds.count), -1);
+
+		auto completed_pipes = buf_with_allocator<Fabric_Poller_Pipe*>(memory::clib());
+		mn_defer(buf_free(completed_pipes));
+		{
+			mutex_lock(self->mtx);
+			mn_defer(mutex_unlock(self->mtx));
+
+			char buffer[64];
+			while (::recv(self->wake_socket, buffer, sizeof(buffer), 0) > 0)
+			{}
+
+			// the sockets which were added while we were waiting come after the polled ones so the indices still match
+			for (size_t i = 1; i < self->pollfds.count; ++i)
+			{
+				auto flags = self->pollfds[i].revents;
+				if (flags == 0)
+					continue;
+
+				// errors and hang ups wake up both sides so that their io calls report them
+				auto& socket = self->sockets[i - 1];
+				auto failed = (flags & (POLLERR | POLLHUP | POLLNVAL)) != 0;
+				if (socket.jobs[FABRIC_IO_READ] && (failed || (flags & POLLRDNORM)))
+				{
+					buf_push(ready, socket.jobs[FABRIC_IO_READ]);
+					socket.jobs[FABRIC_IO_READ] = nullptr;
+				}
+				if (socket.jobs[FABRIC_IO_WRITE] && (failed || (flags & POLLWRNORM)))
+				{
+					buf_push(ready, socket.jobs[FABRIC_IO_WRITE]);
+					socket.jobs[FABRIC_IO_WRITE] = nullptr;
+				}
+			}
+
+			size_t waiting_count = 0;
+			for (size_t i = 0; i < self->sockets.count; ++i)
+			{
+				const auto& socket = self->sockets[i];
+				if (socket.jobs[FABRIC_IO_READ] || socket.jobs[FABRIC_IO_WRITE])
+					self->sockets[waiting_count++] = socket;
+			}
+			buf_resize(self->sockets, waiting_count);
+
+			for (auto job: self->ready)
+				buf_push(ready, job);
+			buf_clear(self->ready);
+
+			std::swap(completed_pipes, self->completed_pipes);
+		}
+
+		// the callbacks of the completed pipes might still be running so we wait for them before freeing the pipes
+		for (auto pipe: completed_pipes)
+		{
+			UnregisterWaitEx(pipe->wait, INVALID_HANDLE_VALUE);
+			_fabric_poller_pipe_free(pipe);
+		}
+	}
+
+	void
+	_fabric_poller_wake(Fabric_Poller self)
+	{
+		char value = 1;
+		::sendto(self->wake_socket, &value, 1, 0, (const sockaddr*)&self->wake_address, sizeof(self->wake_address));
+	}
+}
@@ -253,6 +253,15 @@ namespace mn::ipc
 		return bytes_written;
 	}
 
+	bool
+	sputnik_can_read(Sputnik self)
+	{
+		DWORD available = 0;
+		if (PeekNamedPipe((HANDLE)self->winos_named_pipe, NULL, 0, NULL, &available, NULL) == FALSE)
+			return true;
+		return available > 0;
+	}
+
 	bool
 	sputnik_disconnect(Sputnik self)
 	{
@@ -178,6 +178,7 @@ namespace mn
 		int res = ::getaddrinfo(nullptr, port.ptr, &hints, &info);
 		if (res != 0)
 			return false;
+		mn_defer(::freeaddrinfo(info));
 
 		res = ::bind(self->handle, info->ai_addr, int(info->ai_addrlen));
 		if (res == SOCKET_ERROR)
@@ -328,4 +329,22 @@ namespace mn
 	{
 		return self->handle;
 	}
+
+	bool
+	socket_can_read(Socket self)
+	{
+		WSAPOLLFD pfd{};
+		pfd.fd = self->handle;
+		pfd.events = POLLRDNORM;
+		return WSAPoll(&pfd, 1, 0) != 0;
+	}
+
+	bool
+	socket_can_write(Socket self)
+	{
+		WSAPOLLFD pfd{};
+		pfd.fd = self->handle;
+		pfd.events = POLLWRNORM;
+		return WSAPoll(&pfd, 1, 0) != 0;
+	}
 }
\ No newline at end of file
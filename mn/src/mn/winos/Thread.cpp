@@ -653,6 +653,58 @@ namespace mn
 		Sleep(DWORD(milliseconds));
 	}
 
+	void
+	thread_yield()
+	{
+		SwitchToThread();
+	}
+
+	bool
+	thread_pin_current(int32_t cpu)
+	{
+		DWORD_PTR mask = 0;
+		if (cpu < 0)
+		{
+			DWORD_PTR system_mask = 0;
+			if (GetProcessAffinityMask(GetCurrentProcess(), &mask, &system_mask) == FALSE)
+				return false;
+		}
+		else
+		{
+			if (cpu >= int32_t(sizeof(mask) * 8))
+				return false;
+			mask = DWORD_PTR(1) << cpu;
+		}
+		return SetThreadAffinityMask(GetCurrentThread(), mask) != 0;
+	}
+
+	bool
+	futex_wait(std::atomic<int32_t>* address, int32_t expected, Timeout timeout)
+	{
+		static_assert(sizeof(std::atomic<int32_t>) == sizeof(int32_t), "futex word should be a plain 32-bit integer");
+
+		DWORD millis = INFINITE;
+		if (timeout != INFINITE_TIMEOUT)
+			millis = timeout.milliseconds >= INFINITE ? INFINITE - 1 : DWORD(timeout.milliseconds);
+
+		worker_block_ahead();
+		auto res = WaitOnAddress((volatile void*)address, &expected, sizeof(expected), millis);
+		worker_block_clear();
+		return res == TRUE || GetLastError() != ERROR_TIMEOUT;
+	}
+
+	void
+	futex_wake_one(std::atomic<int32_t>* address)
+	{
+		WakeByAddressSingle((void*)address);
+	}
+
+	void
+	futex_wake_all(std::atomic<int32_t>* address)
+	{
+		WakeByAddressAll((void*)address);
+	}
+
 
 	// time
 	uint64_t
@@ -735,6 +787,8 @@ namespace mn
 		int count;
 		CRITICAL_SECTION cs;
 		CONDITION_VARIABLE cv;
+		// fabric fibers wait on the signal so that they're resumed once the count reaches zero instead of being polled
+		Worker_Signal signal;
 	};
 
 	Waitgroup
@@ -744,6 +798,7 @@ namespace mn
 		self->count = 0;
 		InitializeCriticalSectionAndSpinCount(&self->cs, 1<<14);
 		InitializeConditionVariable(&self->cv);
+		self->signal = worker_signal_new();
 		return self;
 	}
 
@@ -751,12 +806,25 @@ namespace mn
 	waitgroup_free(Waitgroup self)
 	{
 		DeleteCriticalSection(&self->cs);
+		worker_signal_free(self->signal);
 		free(self);
 	}
 
 	void
 	waitgroup_wait(Waitgroup self)
 	{
+		// fabric fibers are suspended instead of blocking the worker thread
+		if (worker_on_fiber())
+		{
+			worker_block_on_signal(self->signal, [self] {
+				EnterCriticalSection(&self->cs);
+				auto res = self->count == 0;
+				LeaveCriticalSection(&self->cs);
+				return res;
+			});
+			return;
+		}
+
 		worker_block_ahead();
 		mn_defer(worker_block_clear());
 
@@ -790,6 +858,24 @@ namespace mn
 		mn_assert(self->count >= 0);
 
 		if (self->count == 0)
+		{
 			WakeAllConditionVariable(&self->cv);
+			worker_signal_notify(self->signal);
+		}
+	}
+
+	int
+	waitgroup_count(Waitgroup self)
+	{
+		EnterCriticalSection(&self->cs);
+		mn_defer(LeaveCriticalSection(&self->cs));
+
+		return self->count;
+	}
+
+	Worker_Signal
+	_waitgroup_signal(Waitgroup self)
+	{
+		return self->signal;
 	}
 }
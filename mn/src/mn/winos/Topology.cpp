@@ -0,0 +1,124 @@
+#include "mn/Topology.h"
+#include "mn/Memory.h"
+
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+
+#include <algorithm>
+
+namespace mn
+{
+	template<typename TFunc>
+	inline static void
+	_topology_for_each_cpu(ULONG_PTR mask, TFunc&& fn)
+	{
+		for (int32_t i = 0; i < int32_t(sizeof(mask) * 8); ++i)
+			if (mask & (ULONG_PTR(1) << i))
+				fn(i);
+	}
+
+	inline static Topology_CPU*
+	_topology_find_cpu(Topology& self, int32_t id)
+	{
+		for (auto& cpu: self.cpus)
+			if (cpu.id == id)
+				return &cpu;
+		return nullptr;
+	}
+
+	// API
+	Topology
+	topology_new()
+	{
+		Topology self{};
+		self.cpus = buf_new<Topology_CPU>();
+
+		// this only covers the processor group of the calling thread (up to 64 cpus) which is also
+		// the limit of the thread affinity masks that thread_pin_current uses
+		DWORD size = 0;
+		::GetLogicalProcessorInformation(nullptr, &size);
+		auto infos = buf_with_allocator<SYSTEM_LOGICAL_PROCESSOR_INFORMATION>(memory::tmp());
+		buf_resize(infos, size / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION));
+		if (size == 0 || ::GetLogicalProcessorInformation(infos.ptr, &size) == FALSE)
+		{
+			SYSTEM_INFO info{};
+			::GetSystemInfo(&info);
+			for (int32_t i = 0; i < int32_t(info.dwNumberOfProcessors); ++i)
+				buf_push(self.cpus, Topology_CPU{ i, i, 0, 0, 0 });
+			self.cores_count = self.cpus.count;
+			self.packages_count = 1;
+			self.nodes_count = 1;
+			return self;
+		}
+
+		// add the cpus first using the core relations, then fill the rest of their info
+		int32_t core_id = 0;
+		for (const auto& info: infos)
+		{
+			if (info.Relationship != RelationProcessorCore)
+				continue;
+
+			_topology_for_each_cpu(info.ProcessorMask, [&](int32_t id) {
+				buf_push(self.cpus, Topology_CPU{ id, core_id, 0, 0, 0 });
+			});
+			++core_id;
+		}
+		std::sort(self.cpus.ptr, self.cpus.ptr + self.cpus.count, [](const Topology_CPU& a, const Topology_CPU& b) {
+			return a.id < b.id;
+		});
+		self.cores_count = size_t(core_id);
+
+		int32_t package_id = 0;
+		int32_t llc_level = 0;
+		for (const auto& info: infos)
+		{
+			if (info.Relationship == RelationProcessorPackage)
+			{
+				_topology_for_each_cpu(info.ProcessorMask, [&](int32_t id) {
+					if (auto cpu = _topology_find_cpu(self, id))
+						cpu->package_id = package_id;
+				});
+				++package_id;
+			}
+			else if (info.Relationship == RelationNumaNode)
+			{
+				_topology_for_each_cpu(info.ProcessorMask, [&](int32_t id) {
+					if (auto cpu = _topology_find_cpu(self, id))
+						cpu->node_id = int32_t(info.NumaNode.NodeNumber);
+				});
+				++self.nodes_count;
+			}
+			else if (info.Relationship == RelationCache && info.Cache.Type != CacheInstruction)
+			{
+				auto level = int32_t(info.Cache.Level);
+				if (level == 1 && self.l1d_cache_size == 0)
+					self.l1d_cache_size = info.Cache.Size;
+				else if (level == 2 && self.l2_cache_size == 0)
+					self.l2_cache_size = info.Cache.Size;
+				else if (level == 3 && self.l3_cache_size == 0)
+					self.l3_cache_size = info.Cache.Size;
+
+				if (self.cache_line_size == 0)
+					self.cache_line_size = info.Cache.LineSize;
+
+				// the first cpu which shares the cache is used as the id of the last level cache
+				if (level >= llc_level)
+				{
+					llc_level = level;
+					int32_t llc_id = -1;
+					_topology_for_each_cpu(info.Cache.ProcessorMask, [&](int32_t id) {
+						if (llc_id == -1)
+							llc_id = id;
+						if (auto cpu = _topology_find_cpu(self, id))
+							cpu->llc_id = llc_id;
+					});
+				}
+			}
+		}
+		self.packages_count = package_id > 0 ? size_t(package_id) : 1;
+		if (self.nodes_count == 0)
+			self.nodes_count = 1;
+		return self;
+	}
+} // namespace mn
\ No newline at end of file
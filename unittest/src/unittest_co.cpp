@@ -0,0 +1,265 @@
+#include <doctest/doctest.h>
+
+#include <mn/Co_Task.h>
+#include <mn/Fabric.h>
+#include <mn/Socket.h>
+#include <mn/OS.h>
+#include <mn/Defer.h>
+
+#include <atomic>
+
+static mn::Co_Task<int>
+co_add(int a, int b)
+{
+	co_return a + b;
+}
+
+static mn::Co_Task<int>
+co_sum(int count)
+{
+	int res = 0;
+	for (int i = 0; i < count; ++i)
+		res += co_await co_add(i, 1);
+	co_return res;
+}
+
+TEST_CASE("co_wait")
+{
+	auto f = mn::fabric_new({});
+	mn_defer(mn::fabric_free(f));
+
+	CHECK(mn::co_wait(f, co_add(1, 2)) == 3);
+	CHECK(mn::co_wait(f, co_sum(10)) == 55);
+}
+
+// notifies the waitgroup once the coroutine frame which holds it is destroyed
+struct Frame_Guard
+{
+	mn::Waitgroup wg;
+
+	explicit Frame_Guard(mn::Waitgroup w)
+		:wg(w)
+	{}
+
+	Frame_Guard(const Frame_Guard&) = delete;
+
+	Frame_Guard(Frame_Guard&& other)
+		:wg(other.wg)
+	{
+		other.wg = nullptr;
+	}
+
+	~Frame_Guard()
+	{
+		if (wg)
+			mn::waitgroup_done(wg);
+	}
+};
+
+static mn::Co_Task<int>
+co_detached(Frame_Guard, std::atomic<int>& runs)
+{
+	runs.fetch_add(1);
+	co_return 0;
+}
+
+TEST_CASE("co_go detached coroutines free themselves")
+{
+	auto f = mn::fabric_new({});
+	mn_defer(mn::fabric_free(f));
+
+	// the parameters live in the coroutine frame so the guard is destroyed with it
+	constexpr int COUNT = 100;
+	mn::Auto_Waitgroup frames;
+	frames.add(COUNT);
+	std::atomic<int> runs = 0;
+	for (int i = 0; i < COUNT; ++i)
+		mn::co_go(f, co_detached(Frame_Guard{frames.handle}, runs));
+
+	frames.wait();
+	CHECK(runs == COUNT);
+}
+
+TEST_CASE("co_go rejected coroutines free themselves")
+{
+	mn::Fabric_Settings settings{};
+	settings.workers_count = 1;
+	settings.max_pending_tasks = 1;
+	settings.overload_policy = mn::FABRIC_OVERLOAD_POLICY_REJECT;
+	auto f = mn::fabric_new(settings);
+	mn_defer(mn::fabric_free(f));
+
+	// the gated task fills the fabric so the coroutine is rejected, and its frame is freed without running it
+	std::atomic<bool> gate = false;
+	mn::Auto_Waitgroup gated;
+	gated.add(1);
+	REQUIRE(mn::go(f, [&] {
+		while (gate.load() == false)
+			mn::thread_sleep(1);
+		gated.done();
+	}));
+
+	mn::Auto_Waitgroup frames;
+	frames.add(1);
+	std::atomic<int> runs = 0;
+	CHECK(mn::co_go(f, co_detached(Frame_Guard{frames.handle}, runs)) == false);
+	frames.wait();
+	CHECK(runs == 0);
+
+	gate = true;
+	gated.wait();
+}
+
+static mn::Co_Task<void>
+co_producer(mn::Chan<int> c, int count)
+{
+	for (int i = 1; i <= count; ++i)
+		co_await mn::co_chan_send(c, i);
+	mn::chan_close(c);
+}
+
+static mn::Co_Task<int>
+co_consumer(mn::Chan<int> c)
+{
+	int res = 0;
+	while (true)
+	{
+		auto [value, more] = co_await mn::co_chan_recv(c);
+		if (more == false)
+			break;
+		res += value;
+	}
+	co_return res;
+}
+
+TEST_CASE("co channels")
+{
+	mn::Fabric_Settings settings{};
+	settings.workers_count = 2;
+	auto f = mn::fabric_new(settings);
+	mn_defer(mn::fabric_free(f));
+
+	// the channel has room for a single value so both sides keep suspending on each other
+	auto c = mn::chan_new<int>(1);
+	mn_defer(mn::chan_free(c));
+
+	mn::co_go(f, co_producer(c, 1000));
+	CHECK(mn::co_wait(f, co_consumer(c)) == 500500);
+}
+
+TEST_CASE("co channels from threads")
+{
+	mn::Fabric_Settings settings{};
+	settings.workers_count = 1;
+	auto f = mn::fabric_new(settings);
+	mn_defer(mn::fabric_free(f));
+
+	// the suspended coroutine is resumed by a plain thread which sends to the channel
+	auto c = mn::chan_new<int>(1);
+	mn_defer(mn::chan_free(c));
+
+	auto producer = mn::thread_new([](void* arg) {
+		auto c = (mn::Chan<int>)arg;
+		mn::thread_sleep(20);
+		for (int i = 1; i <= 100; ++i)
+			mn::chan_send(c, i);
+		mn::chan_close(c);
+	}, c, "co channels producer");
+
+	CHECK(mn::co_wait(f, co_consumer(c)) == 5050);
+	mn::thread_join(producer);
+	mn::thread_free(producer);
+}
+
+static mn::Co_Task<int>
+co_wait_group(mn::Waitgroup wg, std::atomic<int>& value)
+{
+	co_await mn::co_waitgroup_wait(wg);
+	co_return value.load();
+}
+
+TEST_CASE("co waitgroup")
+{
+	auto f = mn::fabric_new({});
+	mn_defer(mn::fabric_free(f));
+
+	mn::Auto_Waitgroup wg;
+	wg.add(3);
+	std::atomic<int> value = 0;
+	for (int i = 0; i < 3; ++i)
+	{
+		mn::go(f, [&] {
+			mn::thread_sleep(10);
+			value.fetch_add(1);
+			wg.done();
+		});
+	}
+
+	CHECK(mn::co_wait(f, co_wait_group(wg.handle, value)) == 3);
+}
+
+static mn::Co_Task<uint64_t>
+co_sleeper(uint64_t milliseconds)
+{
+	auto start = mn::time_in_millis();
+	co_await mn::co_sleep(milliseconds);
+	co_return mn::time_in_millis() - start;
+}
+
+TEST_CASE("co sleep")
+{
+	auto f = mn::fabric_new({});
+	mn_defer(mn::fabric_free(f));
+
+	CHECK(mn::co_wait(f, co_sleeper(30)) >= 30);
+	CHECK(mn::co_wait(f, co_sleeper(0)) < 30);
+}
+
+static mn::Co_Task<size_t>
+co_read(mn::Socket socket)
+{
+	co_await mn::co_socket_readable(socket);
+	char buffer[16] = {};
+	auto [read_bytes, err] = mn::socket_read(socket, mn::block_from(buffer), mn::NO_TIMEOUT);
+	if (err)
+		co_return 0;
+	co_return read_bytes;
+}
+
+TEST_CASE("co socket readable")
+{
+	mn::Fabric_Settings settings{};
+	settings.workers_count = 1;
+	auto f = mn::fabric_new(settings);
+	mn_defer(mn::fabric_free(f));
+
+	auto server = mn::socket_open(mn::SOCKET_FAMILY_IPV4, mn::SOCKET_TYPE_TCP);
+	REQUIRE(server != nullptr);
+	mn_defer(mn::socket_close(server));
+	REQUIRE(mn::socket_bind(server, "47813"));
+	REQUIRE(mn::socket_listen(server));
+
+	auto client = mn::socket_open(mn::SOCKET_FAMILY_IPV4, mn::SOCKET_TYPE_TCP);
+	REQUIRE(client != nullptr);
+	REQUIRE(mn::socket_connect(client, "127.0.0.1", "47813"));
+
+	auto accepted = mn::socket_accept(server, mn::INFINITE_TIMEOUT);
+	REQUIRE(accepted != nullptr);
+	// the client closes first so that the connection's time wait doesn't hold the server's port in the next run
+	mn_defer({
+		mn::socket_close(client);
+		char buffer[16];
+		mn::socket_read(accepted, mn::block_from(buffer), mn::Timeout{1000});
+		mn::socket_close(accepted);
+	});
+
+	// the coroutine sleeps on the fabric's io thread until the data arrives, so the single worker is free to run the
+	// task which sends it
+	mn::go(f, [client] {
+		mn::thread_sleep(20);
+		const char data[] = "hello";
+		mn::socket_write(client, mn::block_from(data));
+	});
+
+	CHECK(mn::co_wait(f, co_read(accepted)) == sizeof("hello"));
+}
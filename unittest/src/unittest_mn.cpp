@@ -10,6 +10,7 @@
 #include <mn/IO.h>
 #include <mn/Str_Intern.h>
 #include <mn/Ring.h>
+#include <mn/MPMC_Ring.h>
 #include <mn/OS.h>
 #include <mn/memory/Leak.h>
 #include <mn/Task.h>
@@ -19,6 +20,8 @@
 #include <mn/Deque.h>
 #include <mn/Result.h>
 #include <mn/Fabric.h>
+#include <mn/Parallel.h>
+#include <mn/Topology.h>
 #include <mn/Block_Stream.h>
 #include <mn/Handle_Table.h>
 #include <mn/UUID.h>
@@ -938,6 +941,832 @@ TEST_CASE("buffered channel from coroutine")
 	mn::chan_free(c);
 }
 
+TEST_CASE("channel select")
+{
+	mn::Fabric_Settings settings{};
+	settings.workers_count = 3;
+	auto f = mn::fabric_new(settings);
+	auto numbers = mn::chan_new<size_t>(10);
+	auto names = mn::chan_new<mn::Str>(10);
+	auto done = mn::chan_new<bool>();
+
+	// nothing is ready so the default case is taken right away
+	mn::Recv_Result<size_t> number{};
+	mn::Recv_Result<mn::Str> name{};
+	CHECK(mn::chan_select({mn::chan_select_recv(numbers, &number), mn::chan_select_recv(names, &name)}, mn::NO_TIMEOUT) == mn::CHAN_SELECT_TIMEOUT);
+
+	// nothing is sent so it times out
+	auto start = mn::time_in_millis();
+	CHECK(mn::chan_select({mn::chan_select_recv(numbers, &number)}, mn::Timeout{20}) == mn::CHAN_SELECT_TIMEOUT);
+	CHECK(mn::time_in_millis() - start >= 20);
+
+	// a select send case is done as soon as the channel has room
+	size_t value = 7;
+	CHECK(mn::chan_select({mn::chan_select_send(numbers, &value)}) == 0);
+	CHECK(mn::chan_select({mn::chan_select_recv(names, &name), mn::chan_select_recv(numbers, &number)}) == 1);
+	CHECK(number.more);
+	CHECK(number.res == 7);
+
+	// a single task recieves from both channels as the producers send to them
+	mn::go(f, [numbers] {
+		for (size_t i = 1; i <= 100; ++i)
+			mn::chan_send(numbers, i);
+	});
+	mn::go(f, [names] {
+		for (size_t i = 0; i < 100; ++i)
+			mn::chan_send(names, mn::str_from_c("name"));
+	});
+
+	size_t sum = 0, names_count = 0;
+	mn::Auto_Waitgroup wg;
+	wg.add(1);
+	mn::go(f, [&] {
+		mn::Recv_Result<size_t> number{};
+		mn::Recv_Result<mn::Str> name{};
+		mn::Recv_Result<bool> stop{};
+		while (true)
+		{
+			auto index = mn::chan_select({
+				mn::chan_select_recv(numbers, &number),
+				mn::chan_select_recv(names, &name),
+				mn::chan_select_recv(done, &stop),
+			});
+			if (index == 0)
+			{
+				sum += number.res;
+			}
+			else if (index == 1)
+			{
+				CHECK(name.res == "name");
+				mn::str_free(name.res);
+				++names_count;
+			}
+			else if (index == 2)
+			{
+				// a closed channel is always ready with more set to false
+				CHECK(stop.more == false);
+				break;
+			}
+
+			if (sum == 5050 && names_count == 100)
+				mn::chan_close(done);
+		}
+		wg.done();
+	});
+	wg.wait();
+	CHECK(sum == 5050);
+	CHECK(names_count == 100);
+
+	mn::fabric_free(f);
+	mn::chan_free(numbers);
+	mn::chan_free(names);
+	mn::chan_free(done);
+}
+
+TEST_CASE("channel batches")
+{
+	mn::Fabric_Settings settings{};
+	settings.workers_count = 4;
+	auto f = mn::fabric_new(settings);
+	auto c = mn::chan_new<size_t>(64);
+
+	// the try functions never block
+	CHECK(mn::chan_can_send(c));
+	CHECK(mn::chan_can_recv(c) == false);
+	CHECK(mn::chan_send_try(c, size_t(1)));
+	CHECK(mn::chan_can_recv(c));
+	auto res = mn::chan_recv_try(c);
+	CHECK(res.more);
+	CHECK(res.res == 1);
+	CHECK(mn::chan_recv_try(c).more == false);
+
+	constexpr size_t PRODUCERS_COUNT = 4;
+	constexpr size_t VALUES_COUNT = 10000;
+	mn::Auto_Waitgroup producers;
+	for (size_t i = 0; i < PRODUCERS_COUNT; ++i)
+	{
+		producers.add(1);
+		mn::go(f, [c, &producers] {
+			size_t values[100];
+			for (size_t j = 0; j < VALUES_COUNT; j += 100)
+			{
+				for (size_t k = 0; k < 100; ++k)
+					values[k] = j + k;
+				mn::chan_send_n(c, values, 100);
+			}
+			producers.done();
+		});
+	}
+	mn::go(f, [c, &producers] {
+		producers.wait();
+		mn::chan_close(c);
+	});
+
+	std::atomic<size_t> sum = 0;
+	std::atomic<size_t> count = 0;
+	mn::Auto_Waitgroup consumers;
+	for (size_t i = 0; i < 2; ++i)
+	{
+		consumers.add(1);
+		mn::go(f, [c, &sum, &count, &consumers] {
+			size_t values[32];
+			while (auto values_count = mn::chan_recv_n(c, values, 32))
+			{
+				for (size_t j = 0; j < values_count; ++j)
+					sum += values[j];
+				count += values_count;
+			}
+			consumers.done();
+		});
+	}
+	consumers.wait();
+	CHECK(count == PRODUCERS_COUNT * VALUES_COUNT);
+	CHECK(sum == PRODUCERS_COUNT * (VALUES_COUNT * (VALUES_COUNT - 1) / 2));
+
+	mn::fabric_free(f);
+	mn::chan_free(c);
+}
+
+TEST_CASE("channel limit")
+{
+	// the ring rounds the limit up to a power of 2 but the channel still holds exactly limit values
+	auto c = mn::chan_new<int>(1);
+	mn_defer(mn::chan_free(c));
+	CHECK(mn::chan_send_try(c, 1));
+	CHECK(mn::chan_send_try(c, 2) == false);
+	CHECK(mn::chan_can_send(c) == false);
+	CHECK(mn::chan_recv_try(c).res == 1);
+	CHECK(mn::chan_send_try(c, 2));
+
+	auto c3 = mn::chan_new<int>(3);
+	mn_defer(mn::chan_free(c3));
+	for (int i = 0; i < 3; ++i)
+		CHECK(mn::chan_send_try(c3, i));
+	CHECK(mn::chan_send_try(c3, 3) == false);
+}
+
+TEST_CASE("channel send try on a closed channel")
+{
+	auto c = mn::chan_new<int>(4);
+	mn_defer(mn::chan_free(c));
+	CHECK(mn::chan_send_try(c, 1));
+	mn::chan_close(c);
+
+	// the closed channel has room but nothing can be sent to it, and the values sent before the close still arrive
+	CHECK(mn::chan_can_send(c) == false);
+	CHECK(mn::chan_send_try(c, 2) == false);
+	auto [value, more] = mn::chan_recv_try(c);
+	CHECK(value == 1);
+	CHECK(more);
+	CHECK(mn::chan_recv_try(c).more == false);
+}
+
+TEST_CASE("channel stream")
+{
+	mn::Fabric_Settings settings{};
+	settings.workers_count = 3;
+	auto f = mn::fabric_new(settings);
+
+	// buffered stream, the writer doesn't wait for the reader
+	{
+		auto s = mn::chan_stream_new(16);
+		CHECK(mn::stream_write(s, mn::block_from("abc")) == sizeof("abc"));
+		char out[16] = {};
+		CHECK(mn::stream_read(s, mn::Block{out, sizeof(out)}) == sizeof("abc"));
+		CHECK(::strcmp(out, "abc") == 0);
+		mn::chan_stream_free(s);
+	}
+
+	// bytes keep their order through a small ring and a pipeline of lazy streams
+	{
+		auto input = mn::memory_stream_new();
+		for (int i = 0; i < 10000; ++i)
+		{
+			uint8_t v = uint8_t(i);
+			mn::memory_stream_write(input, mn::Block{&v, 1});
+		}
+		mn::memory_stream_cursor_to_start(input);
+
+		auto add_one = [](mn::Stream in, mn::Stream out) {
+			uint8_t buffer[7];
+			while (auto count = mn::stream_read(in, mn::Block{buffer, sizeof(buffer)}))
+			{
+				for (size_t i = 0; i < count; ++i)
+					++buffer[i];
+				mn::stream_write(out, mn::Block{buffer, count});
+			}
+		};
+		auto first = mn::lazy_stream_with_buffer_size(f, 16, add_one, input);
+		auto second = mn::lazy_stream(f, add_one, first.handle);
+
+		int i = 0;
+		bool in_order = true;
+		uint8_t buffer[5];
+		while (auto count = mn::stream_read(second.handle, mn::Block{buffer, sizeof(buffer)}))
+		{
+			for (size_t j = 0; j < count; ++j, ++i)
+				in_order &= buffer[j] == uint8_t(i + 2);
+		}
+		CHECK(in_order);
+		CHECK(i == 10000);
+		mn::memory_stream_free(input);
+	}
+
+	// blocks are transferred without copying
+	{
+		mn::Auto_Chan_Stream s;
+		mn::Auto_Waitgroup g;
+		void* ptrs[10] = {};
+		g.add(1);
+		mn::go(f, [s, &ptrs, &g] {
+			for (size_t i = 0; i < 10; ++i)
+			{
+				auto block = mn::alloc_from(mn::memory::clib(), 8, alignof(char));
+				ptrs[i] = block.ptr;
+				mn::chan_stream_write_block(s, block);
+			}
+			mn::chan_stream_close(s);
+			g.done();
+		});
+
+		size_t blocks_count = 0;
+		bool same_blocks = true;
+		while (true)
+		{
+			auto block = mn::chan_stream_read_block(s);
+			if (block.size == 0)
+				break;
+			same_blocks &= block.size == 8 && block.ptr == ptrs[blocks_count];
+			mn::free_from(mn::memory::clib(), block);
+			++blocks_count;
+		}
+		g.wait();
+		CHECK(blocks_count == 10);
+		CHECK(same_blocks);
+	}
+
+	mn::fabric_free(f);
+}
+
+TEST_CASE("fabric strands")
+{
+	mn::Fabric_Settings settings{};
+	settings.workers_count = 4;
+	auto f = mn::fabric_new(settings);
+
+	constexpr size_t STRANDS_COUNT = 4;
+	constexpr size_t PRODUCERS_COUNT = 4;
+	constexpr size_t TASKS_COUNT = 1000;
+
+	struct Entity
+	{
+		mn::Strand strand;
+		std::atomic<int> running;
+		size_t next[PRODUCERS_COUNT];
+		size_t executed;
+	};
+	Entity entities[STRANDS_COUNT] = {};
+	for (auto& entity: entities)
+		entity.strand = mn::strand_new(f);
+
+	std::atomic<bool> overlapped = false;
+	std::atomic<bool> out_of_order = false;
+	mn::Auto_Waitgroup g;
+	g.add(int(STRANDS_COUNT * PRODUCERS_COUNT * TASKS_COUNT));
+	for (size_t producer = 0; producer < PRODUCERS_COUNT; ++producer)
+	{
+		mn::go(f, [&, producer] {
+			for (size_t i = 0; i < TASKS_COUNT; ++i)
+			{
+				for (auto& entity: entities)
+				{
+					mn::go(entity.strand, [&entity, &overlapped, &out_of_order, &g, producer, i] {
+						if (entity.running.fetch_add(1) != 0)
+							overlapped = true;
+						if (entity.next[producer] != i)
+							out_of_order = true;
+						entity.next[producer] = i + 1;
+						++entity.executed;
+						entity.running.fetch_sub(1);
+						g.done();
+					});
+				}
+			}
+		});
+	}
+	g.wait();
+
+	CHECK(overlapped == false);
+	CHECK(out_of_order == false);
+	for (auto& entity: entities)
+	{
+		CHECK(entity.executed == PRODUCERS_COUNT * TASKS_COUNT);
+		mn::strand_free(entity.strand);
+	}
+
+	// the strand outlives strand_free until its posted tasks finish
+	auto strand = mn::strand_new(f);
+	std::atomic<size_t> count = 0;
+	g.add(100);
+	for (size_t i = 0; i < 100; ++i)
+		mn::go(strand, [&count, &g] { ++count; g.done(); });
+	mn::strand_free(strand);
+	g.wait();
+	CHECK(count == 100);
+
+	mn::fabric_free(f);
+}
+
+TEST_CASE("fabric task pool")
+{
+	auto allocator = mn::fabric_task_allocator();
+
+	// freed blocks are reused by the same thread
+	auto block = mn::alloc_from(allocator, 100, alignof(size_t));
+	mn::free_from(allocator, block);
+	CHECK(mn::alloc_from(allocator, 100, alignof(size_t)).ptr == block.ptr);
+	mn::free_from(allocator, block);
+
+	// big and over aligned blocks are still served
+	auto big = mn::alloc_from(allocator, 4096, alignof(size_t));
+	auto aligned = mn::alloc_from(allocator, 64, 64);
+	CHECK(((uintptr_t)aligned.ptr % 64) == 0);
+	::memset(big.ptr, 0, big.size);
+	::memset(aligned.ptr, 0, aligned.size);
+	mn::free_from(allocator, big);
+	mn::free_from(allocator, aligned);
+
+	// big closures are allocated by the submitting thread and freed by the workers
+	mn::Fabric_Settings settings{};
+	settings.workers_count = 4;
+	auto f = mn::fabric_new(settings);
+
+	std::atomic<size_t> sum = 0;
+	mn::Auto_Waitgroup g;
+	for (size_t i = 0; i < 1000; ++i)
+	{
+		size_t values[32];
+		for (size_t j = 0; j < 32; ++j)
+			values[j] = i;
+		g.add(1);
+		mn::go(f, [values, &sum, &g, &f] {
+			// and by the workers and freed by each other
+			g.add(1);
+			mn::go(f, [values, &sum, &g] {
+				sum += values[31];
+				g.done();
+			});
+			sum += values[0];
+			g.done();
+		});
+	}
+	g.wait();
+	CHECK(sum == 2 * (999 * 1000 / 2));
+
+	mn::fabric_free(f);
+}
+
+TEST_CASE("worker signal")
+{
+	auto ping = mn::worker_signal_new();
+	auto pong = mn::worker_signal_new();
+
+	// timeouts
+	std::atomic<bool> flag = false;
+	CHECK(mn::worker_block_on_signal_with_timeout(ping, mn::NO_TIMEOUT, [&] { return flag.load(); }) == false);
+	CHECK(mn::worker_block_on_signal_with_timeout(ping, mn::Timeout{10}, [&] { return flag.load(); }) == false);
+
+	// ping pong between threads is driven by the notifications instead of polling every 1 ms
+	for (auto enable_fibers: {false, true})
+	{
+		mn::Fabric_Settings settings{};
+		settings.workers_count = 2;
+		settings.enable_fibers = enable_fibers;
+		auto f = mn::fabric_new(settings);
+
+		constexpr int ROUNDS = 1000;
+		std::atomic<int> pings = 0;
+		std::atomic<int> pongs = 0;
+		mn::Auto_Waitgroup g;
+		g.add(1);
+		mn::go(f, [&] {
+			for (int i = 1; i <= ROUNDS; ++i)
+			{
+				mn::worker_block_on_signal(ping, [&] { return pings.load() >= i; });
+				pongs.store(i);
+				mn::worker_signal_notify(pong);
+			}
+			g.done();
+		});
+
+		auto start = mn::time_in_millis();
+		for (int i = 1; i <= ROUNDS; ++i)
+		{
+			pings.store(i);
+			mn::worker_signal_notify(ping);
+			mn::worker_block_on_signal(pong, [&] { return pongs.load() >= i; });
+		}
+		g.wait();
+		auto elapsed = mn::time_in_millis() - start;
+		CHECK(pongs == ROUNDS);
+		// polling would take at least 1 ms per round
+		CHECK(elapsed < ROUNDS);
+
+		mn::fabric_free(f);
+	}
+
+	mn::worker_signal_free(ping);
+	mn::worker_signal_free(pong);
+}
+
+TEST_CASE("fabric backpressure")
+{
+	constexpr size_t MAX_PENDING = 4;
+	for (auto policy: {mn::FABRIC_OVERLOAD_POLICY_REJECT, mn::FABRIC_OVERLOAD_POLICY_RUN_INLINE, mn::FABRIC_OVERLOAD_POLICY_BLOCK})
+	{
+		mn::Fabric_Settings settings{};
+		settings.workers_count = 2;
+		settings.max_pending_tasks = MAX_PENDING;
+		settings.overload_policy = policy;
+		auto f = mn::fabric_new(settings);
+
+		// fill the fabric with tasks which wait for the gate to open
+		std::atomic<bool> gate = false;
+		std::atomic<int> done = 0;
+		for (size_t i = 0; i < MAX_PENDING; ++i)
+		{
+			CHECK(mn::fabric_do(f, [&] {
+				while (gate.load() == false)
+					mn::thread_sleep(1);
+				done.fetch_add(1);
+			}));
+		}
+
+		// try_do never blocks or runs inline
+		bool ran = false;
+		CHECK(mn::fabric_try_do(f, [&] { ran = true; }) == false);
+		CHECK(ran == false);
+
+		auto opener = mn::fabric_new(mn::Fabric_Settings{});
+		switch (policy)
+		{
+		case mn::FABRIC_OVERLOAD_POLICY_REJECT:
+			CHECK(mn::fabric_do(f, [&] { ran = true; }) == false);
+			CHECK(ran == false);
+			gate = true;
+			break;
+		case mn::FABRIC_OVERLOAD_POLICY_RUN_INLINE:
+			CHECK(mn::fabric_do(f, [&] { ran = true; }));
+			CHECK(ran == true);
+			gate = true;
+			break;
+		case mn::FABRIC_OVERLOAD_POLICY_BLOCK:
+			mn::go(opener, [&] {
+				mn::thread_sleep(50);
+				gate = true;
+			});
+			// blocks until one of the gated tasks finishes
+			CHECK(mn::fabric_do(f, [&] { done.fetch_add(1); }));
+			CHECK(gate.load() == true);
+			break;
+		default:
+			break;
+		}
+		mn::fabric_free(opener);
+
+		while (done.load() < int(MAX_PENDING) + (policy == mn::FABRIC_OVERLOAD_POLICY_BLOCK ? 1 : 0))
+			mn::thread_sleep(1);
+		auto stats = mn::fabric_stats(f);
+		CHECK(stats.overloaded_submissions == 2);
+		mn::fabric_stats_free(stats);
+		mn::fabric_free(f);
+	}
+}
+
+TEST_CASE("fabric run inline depth")
+{
+	mn::Fabric_Settings settings{};
+	settings.workers_count = 1;
+	settings.max_pending_tasks = 1;
+	settings.overload_policy = mn::FABRIC_OVERLOAD_POLICY_RUN_INLINE;
+	auto f = mn::fabric_new(settings);
+
+	// each task submits the next one while the fabric is full, so they run inline on top of each other until they're
+	// deep enough to be queued instead
+	constexpr int TASKS_COUNT = 100;
+	std::atomic<int> depth = 0;
+	std::atomic<int> max_depth = 0;
+	mn::Auto_Waitgroup g;
+	g.add(TASKS_COUNT);
+	mn::Task<void(int)> submit;
+	submit = mn::Task<void(int)>::make([&](int i) {
+		mn::go(f, [&, i] {
+			auto d = depth.fetch_add(1) + 1;
+			if (d > max_depth.load())
+				max_depth = d;
+			if (i + 1 < TASKS_COUNT)
+				submit(i + 1);
+			depth.fetch_sub(1);
+			g.done();
+		});
+	});
+	mn_defer(mn::task_free(submit));
+	submit(0);
+	g.wait();
+
+	CHECK(max_depth.load() > 1);
+	CHECK(max_depth.load() <= 16);
+
+	// the inline tasks are counted like the queued ones, and they're counted after they finish
+	auto stats = mn::fabric_stats(f);
+	for (int i = 0; i < 1000 && stats.total.tasks_executed < TASKS_COUNT; ++i)
+	{
+		mn::fabric_stats_free(stats);
+		mn::thread_sleep(1);
+		stats = mn::fabric_stats(f);
+	}
+	CHECK(stats.total.tasks_executed == TASKS_COUNT);
+	mn::fabric_stats_free(stats);
+	mn::fabric_free(f);
+}
+
+TEST_CASE("fabric blocking pool")
+{
+	mn::Fabric_Settings settings{};
+	settings.workers_count = 2;
+	settings.blocking_threads_count = 4;
+	auto f = mn::fabric_new(settings);
+
+	// the blocking tasks run on the pool threads and can still submit to their fabric
+	constexpr int TASKS_COUNT = 8;
+	std::atomic<int> local_fabric = 0;
+	mn::Auto_Waitgroup g;
+	g.add(TASKS_COUNT * 2);
+	auto start = mn::time_in_millis();
+	for (int i = 0; i < TASKS_COUNT; ++i)
+	{
+		mn::fabric_do_blocking(f, [&] {
+			mn::thread_sleep(50);
+			if (mn::fabric_local() == f)
+				local_fabric.fetch_add(1);
+			mn::go([&] { g.done(); });
+			g.done();
+		});
+	}
+	g.wait();
+	CHECK(local_fabric == TASKS_COUNT);
+	CHECK(mn::time_in_millis() - start < TASKS_COUNT * 50);
+
+	auto stats = mn::fabric_stats(f);
+	CHECK(stats.blocking_threads_count <= 4);
+	CHECK(stats.blocking_q_count == 0);
+	CHECK(stats.threads_count <= 2 * 4);
+	mn::fabric_stats_free(stats);
+	mn::fabric_free(f);
+
+	// sysmon evicts the workers which hold up queued tasks unless the fabric is out of threads
+	for (size_t max_threads_count: {size_t(0), size_t(2)})
+	{
+		settings = mn::Fabric_Settings{};
+		settings.workers_count = 2;
+		settings.external_blocking_threshold_in_ms = 20;
+		settings.max_threads_count = max_threads_count;
+		f = mn::fabric_new(settings);
+
+		// a long running task with nothing waiting behind it is left alone
+		std::atomic<int> done = 0;
+		mn::go(f, [&] { mn::thread_sleep(200); done.fetch_add(1); });
+		while (done.load() < 1)
+			mn::thread_sleep(1);
+		stats = mn::fabric_stats(f);
+		CHECK(stats.blocking_evictions == 0);
+		mn::fabric_stats_free(stats);
+
+		// the queued tasks are submitted once both workers are busy
+		std::atomic<int> running = 0;
+		for (int i = 0; i < 2; ++i)
+			mn::go(f, [&] { running.fetch_add(1); mn::thread_sleep(200); done.fetch_add(1); });
+		while (running.load() < 2)
+			mn::thread_sleep(1);
+		for (int i = 0; i < 4; ++i)
+			mn::go(f, [&] { done.fetch_add(1); });
+		while (done.load() < 7)
+			mn::thread_sleep(1);
+
+		stats = mn::fabric_stats(f);
+		if (max_threads_count == 0)
+		{
+			CHECK(stats.blocking_evictions > 0);
+		}
+		else
+		{
+			CHECK(stats.blocking_evictions == 0);
+			CHECK(stats.skipped_evictions > 0);
+			CHECK(stats.threads_count == 2);
+		}
+		mn::fabric_stats_free(stats);
+		mn::fabric_free(f);
+	}
+}
+
+TEST_CASE("elastic fabric")
+{
+	mn::Fabric_Settings settings{};
+	settings.workers_count = 2;
+	settings.min_workers_count = 1;
+	settings.max_workers_count = 4;
+	settings.worker_idle_timeout_in_ms = 20;
+	settings.external_blocking_threshold_in_ms = 10000;
+	auto f = mn::fabric_new(settings);
+	mn_defer(mn::fabric_free(f));
+
+	auto wait_for_workers_count = [f](size_t count) {
+		for (int i = 0; i < 5000 && mn::fabric_workers_count(f) != count; ++i)
+			mn::thread_sleep(1);
+		return mn::fabric_workers_count(f);
+	};
+
+	// an idle fabric shrinks down to its min workers count
+	CHECK(wait_for_workers_count(1) == 1);
+	auto stats = mn::fabric_stats(f);
+	CHECK(stats.surplus_workers_count == 1);
+	mn::fabric_stats_free(stats);
+
+	// the tasks waiting behind the busy workers grow it up to its max workers count
+	constexpr int TASKS_COUNT = 8;
+	std::atomic<bool> gate = false;
+	std::atomic<int> done = 0;
+	for (int i = 0; i < TASKS_COUNT; ++i)
+	{
+		mn::go(f, [&] {
+			while (gate.load() == false)
+				mn::thread_sleep(1);
+			done.fetch_add(1);
+		});
+	}
+	CHECK(wait_for_workers_count(4) == 4);
+	gate = true;
+	while (done.load() < TASKS_COUNT)
+		mn::thread_sleep(1);
+
+	// and it shrinks again once the load is gone
+	CHECK(wait_for_workers_count(1) == 1);
+	stats = mn::fabric_stats(f);
+	CHECK(stats.surplus_workers_count == 3);
+	CHECK(stats.blocking_evictions == 0);
+	mn::fabric_stats_free(stats);
+}
+
+TEST_CASE("elastic fabric shrinks around busy workers")
+{
+	mn::Fabric_Settings settings{};
+	settings.workers_count = 2;
+	settings.min_workers_count = 1;
+	settings.max_workers_count = 2;
+	settings.worker_idle_timeout_in_ms = 200;
+	settings.external_blocking_threshold_in_ms = 10000;
+	settings.idle_strategy = mn::FABRIC_IDLE_STRATEGY_PARK;
+	auto f = mn::fabric_new(settings);
+	mn_defer(mn::fabric_free(f));
+
+	// the parked workers are woken up in slot order so the second task lands on the last worker while the first
+	// one keeps the first worker busy
+	std::atomic<mn::Worker> first_worker = nullptr;
+	std::atomic<mn::Worker> last_worker = nullptr;
+	std::atomic<bool> release_last = false;
+	mn::Auto_Waitgroup done;
+	done.add(2);
+	mn::go(f, [&] {
+		first_worker = mn::worker_local();
+		while (last_worker.load() == nullptr)
+			mn::thread_sleep(1);
+		done.done();
+	});
+	while (first_worker.load() == nullptr)
+		mn::thread_sleep(1);
+	mn::go(f, [&] {
+		last_worker = mn::worker_local();
+		while (release_last.load() == false)
+			mn::thread_sleep(1);
+		done.done();
+	});
+	while (last_worker.load() == nullptr)
+		mn::thread_sleep(1);
+	CHECK(first_worker.load() != last_worker.load());
+
+	// the fabric shrinks while the last worker is still busy, so it should take the parked first worker out instead
+	for (int i = 0; i < 5000 && mn::fabric_workers_count(f) != 1; ++i)
+		mn::thread_sleep(1);
+	CHECK(mn::fabric_workers_count(f) == 1);
+	auto stats = mn::fabric_stats(f);
+	CHECK(stats.surplus_workers_count == 1);
+	mn::fabric_stats_free(stats);
+
+	// the busy worker is the one which stays in the fabric
+	release_last = true;
+	done.wait();
+	for (int i = 0; i < 10; ++i)
+	{
+		std::atomic<mn::Worker> worker = nullptr;
+		mn::Auto_Waitgroup task_done;
+		task_done.add(1);
+		mn::go(f, [&] { worker = mn::worker_local(); task_done.done(); });
+		task_done.wait();
+		CHECK(worker.load() == last_worker.load());
+	}
+}
+
+TEST_CASE("task groups")
+{
+	mn::Fabric_Settings settings{};
+	settings.workers_count = 2;
+	auto f = mn::fabric_new(settings);
+	mn_defer(mn::fabric_free(f));
+
+	// plain fan out
+	{
+		auto g = mn::task_group_new(f);
+		std::atomic<int> count = 0;
+		for (int i = 0; i < 100; ++i)
+			mn::task_group_spawn(g, [&] { count.fetch_add(1); });
+		mn::task_group_wait(g);
+		CHECK(count == 100);
+		CHECK(mn::task_group_cancelled(g) == false);
+		CHECK(mn::task_group_timeout(g) == mn::INFINITE_TIMEOUT);
+		mn::task_group_free(g);
+	}
+
+	// the first branch which finds the answer cancels the rest of the search
+	{
+		constexpr int BRANCHES_COUNT = 1000;
+		auto g = mn::task_group_new(f);
+		std::atomic<int> ran = 0;
+		std::atomic<int> found = -1;
+		for (int i = 0; i < BRANCHES_COUNT; ++i)
+		{
+			mn::task_group_spawn(g, [&, g, i] {
+				ran.fetch_add(1);
+				mn::thread_sleep(1);
+				if (i == 10)
+				{
+					found = i;
+					mn::task_group_cancel(g);
+				}
+			});
+		}
+		mn::task_group_wait(g);
+		CHECK(found == 10);
+		CHECK(ran < BRANCHES_COUNT);
+		CHECK(mn::task_group_cancelled(g));
+
+		// the tasks spawned into a cancelled group are skipped
+		bool late = false;
+		mn::task_group_spawn(g, [&] { late = true; });
+		mn::task_group_free(g);
+		CHECK(late == false);
+	}
+
+	// the deadline stops the running tasks which poll it, and it's inherited by the children
+	{
+		auto g = mn::task_group_new(f, mn::Timeout{50});
+		auto child = mn::task_group_new_child(g, mn::Timeout{60000});
+		CHECK(mn::task_group_timeout(child).milliseconds <= 50);
+
+		std::atomic<int> stopped = 0;
+		for (int i = 0; i < 4; ++i)
+		{
+			mn::task_group_spawn(child, [&, child] {
+				while (mn::task_group_cancelled(child) == false)
+					mn::thread_sleep(1);
+				stopped.fetch_add(1);
+			});
+		}
+		auto start = mn::time_in_millis();
+		mn::task_group_wait(child);
+		// the tasks which didn't start before the deadline are skipped
+		CHECK(stopped > 0);
+		CHECK(stopped <= 4);
+		CHECK(mn::time_in_millis() - start < 10000);
+		CHECK(mn::task_group_timeout(g) == mn::NO_TIMEOUT);
+		mn::task_group_free(child);
+		mn::task_group_free(g);
+	}
+
+	// cancelling a parent cancels its children, but not the other way around
+	{
+		auto g = mn::task_group_new(f);
+		auto child = mn::task_group_new_child(g);
+		auto grandchild = mn::task_group_new_child(child);
+		mn::task_group_cancel(child);
+		CHECK(mn::task_group_cancelled(grandchild));
+		CHECK(mn::task_group_cancelled(g) == false);
+		// the parent can be freed before its children
+		mn::task_group_free(g);
+		mn::task_group_free(child);
+		mn::task_group_free(grandchild);
+	}
+}
+
 TEST_CASE("coroutine launching coroutines")
 {
 	mn::Fabric_Settings settings{};
@@ -991,6 +1820,802 @@ TEST_CASE("stress")
 	mn::chan_free(c);
 }
 
+TEST_CASE("fabric work stealing")
+{
+	mn::Fabric_Settings settings{};
+	settings.workers_count = 4;
+	auto f = mn::fabric_new(settings);
+
+	// the first task of the batch blocks its worker until the rest of the batch is done, this only
+	// finishes if the other workers take the remaining tasks
+	constexpr size_t TASKS_COUNT = 1000;
+	std::atomic<size_t> sum = 0;
+	mn::Auto_Waitgroup rest;
+	mn::Auto_Waitgroup all;
+	rest.add(int(TASKS_COUNT));
+	all.add(1);
+
+	auto batch = mn::buf_new<mn::Fabric_Task>();
+	mn::Fabric_Task blocker{};
+	blocker.task = mn::Task<void()>::make([&rest, &all] { rest.wait(); all.done(); });
+	mn::buf_push(batch, blocker);
+	for (size_t i = 0; i < TASKS_COUNT; ++i)
+	{
+		mn::Fabric_Task entry{};
+		entry.task = mn::Task<void()>::make([&sum, &rest, i] { sum += i; rest.done(); });
+		mn::buf_push(batch, entry);
+	}
+	mn::fabric_task_batch_do(f, batch.ptr, batch.count);
+	mn::buf_free(batch);
+
+	all.wait();
+	CHECK(sum == TASKS_COUNT * (TASKS_COUNT - 1) / 2);
+
+	mn::fabric_free(f);
+}
+
+TEST_CASE("fabric batch spread")
+{
+	constexpr size_t WORKERS_COUNT = 4;
+	mn::Fabric_Settings settings{};
+	settings.workers_count = WORKERS_COUNT;
+	auto f = mn::fabric_new(settings);
+
+	// each task waits for all the others to start, so the batch must run on all the workers at once
+	std::atomic<size_t> started = 0;
+	mn::Auto_Waitgroup wg;
+	wg.add(int(WORKERS_COUNT));
+
+	auto batch = mn::buf_new<mn::Fabric_Task>();
+	for (size_t i = 0; i < WORKERS_COUNT; ++i)
+	{
+		mn::Fabric_Task entry{};
+		entry.task = mn::Task<void()>::make([&started, &wg] {
+			started++;
+			while (started < WORKERS_COUNT)
+				mn::thread_sleep(1);
+			wg.done();
+		});
+		mn::buf_push(batch, entry);
+	}
+	mn::fabric_task_batch_do(f, batch.ptr, batch.count);
+	mn::buf_free(batch);
+
+	wg.wait();
+	CHECK(started == WORKERS_COUNT);
+
+	mn::fabric_free(f);
+}
+
+TEST_CASE("fabric idle strategies")
+{
+	mn::FABRIC_IDLE_STRATEGY strategies[] = {
+		mn::FABRIC_IDLE_STRATEGY_SPIN_THEN_PARK,
+		mn::FABRIC_IDLE_STRATEGY_PARK,
+	};
+
+	for (auto strategy: strategies)
+	{
+		mn::Fabric_Settings settings{};
+		settings.workers_count = 4;
+		settings.idle_strategy = strategy;
+		auto f = mn::fabric_new(settings);
+
+		// ping pong with the fabric so that the workers keep going idle between the tasks
+		std::atomic<int> count = 0;
+		for (int i = 0; i < 100; ++i)
+		{
+			mn::Auto_Waitgroup wg;
+			wg.add(1);
+			mn::go(f, [&count, &wg] { count++; wg.done(); });
+			wg.wait();
+			if (i % 10 == 0)
+				mn::thread_sleep(1);
+		}
+		CHECK(count == 100);
+
+		mn::fabric_free(f);
+	}
+}
+
+TEST_CASE("futex")
+{
+	std::atomic<int32_t> word = 0;
+	CHECK(mn::futex_wait(&word, 1) == true);
+	CHECK(mn::futex_wait(&word, 0, mn::Timeout{10}) == false);
+
+	auto waker = mn::thread_new([](void* arg) {
+		auto word = (std::atomic<int32_t>*)arg;
+		mn::thread_sleep(10);
+		word->store(1);
+		mn::futex_wake_all(word);
+	}, &word, "futex waker");
+
+	while (word.load() == 0)
+		mn::futex_wait(&word, 0);
+	CHECK(word == 1);
+
+	mn::thread_join(waker);
+	mn::thread_free(waker);
+}
+
+TEST_CASE("fabric fibers")
+{
+	mn::Fabric_Settings settings{};
+	settings.workers_count = 1;
+	settings.enable_fibers = true;
+	auto f = mn::fabric_new(settings);
+
+	// with a single worker the receivers can only finish if they suspend and let the sender run on the same thread
+	constexpr int TASKS_COUNT = 100;
+	auto c = mn::chan_new<int>();
+	mn_defer(mn::chan_free(c));
+	std::atomic<int> sum = 0;
+	std::atomic<int> same_worker_count = 0;
+	mn::Auto_Waitgroup done;
+	done.add(TASKS_COUNT + 1);
+
+	mn::Worker worker = nullptr;
+	mn::Auto_Waitgroup started;
+	started.add(1);
+	mn::go(f, [&] { worker = mn::worker_local(); started.done(); });
+	started.wait();
+
+	for (int i = 0; i < TASKS_COUNT; ++i)
+	{
+		mn::go(f, [&] {
+			auto [v, more] = mn::chan_recv(c);
+			if (more)
+				sum += v;
+			if (mn::worker_local() == worker)
+				same_worker_count++;
+			done.done();
+		});
+	}
+
+	mn::go(f, [&] {
+		mn::Auto_Waitgroup inner;
+		inner.add(1);
+		mn::go(f, [&] {
+			for (int i = 0; i < TASKS_COUNT; ++i)
+				mn::chan_send(c, i);
+			inner.done();
+		});
+		inner.wait();
+		done.done();
+	});
+
+	done.wait();
+	CHECK(sum == TASKS_COUNT * (TASKS_COUNT - 1) / 2);
+	CHECK(same_worker_count == TASKS_COUNT);
+
+	mn::fabric_free(f);
+}
+
+TEST_CASE("fabric fibers wake up")
+{
+	mn::Fabric_Settings settings{};
+	settings.workers_count = 1;
+	settings.enable_fibers = true;
+	auto f = mn::fabric_new(settings);
+	mn_defer(mn::fabric_free(f));
+
+	// the fibers which wait on the channel, the waitgroup, the signal, and the future are resumed by the code which
+	// makes them ready, so the worker sleeps while they wait instead of waking up to poll them
+	auto c = mn::chan_new<int>();
+	mn_defer(mn::chan_free(c));
+	mn::Auto_Waitgroup gate;
+	gate.add(1);
+	auto signal = mn::worker_signal_new();
+	mn_defer(mn::worker_signal_free(signal));
+	std::atomic<bool> flag = false;
+	auto promise = mn::promise_new<int>();
+	mn_defer(mn::promise_free(promise));
+
+	std::atomic<int> sum = 0;
+	mn::Auto_Waitgroup done;
+	done.add(4);
+	mn::go(f, [&] { sum += mn::chan_recv(c).res; done.done(); });
+	mn::go(f, [&] { gate.wait(); sum += 2; done.done(); });
+	mn::go(f, [&] {
+		mn::worker_block_on_signal(signal, [&] { return flag.load(); });
+		sum += 3;
+		done.done();
+	});
+	mn::go(f, [&, future = mn::promise_future(promise)] {
+		sum += mn::future_wait(future);
+		mn::future_free(future);
+		done.done();
+	});
+
+	auto parks_count = [f] {
+		auto stats = mn::fabric_stats(f);
+		auto res = stats.total.parks;
+		mn::fabric_stats_free(stats);
+		return res;
+	};
+	mn::thread_sleep(50);
+	auto parks_before = parks_count();
+	mn::thread_sleep(100);
+	CHECK(parks_count() - parks_before < 10);
+	CHECK(sum == 0);
+
+	mn::chan_send(c, 1);
+	gate.done();
+	flag = true;
+	mn::worker_signal_notify(signal);
+	mn::promise_set(promise, 4);
+	done.wait();
+	CHECK(sum == 10);
+}
+
+TEST_CASE("mpmc ring")
+{
+	auto ring = mn::mpmc_ring_new<int>(5);
+	mn_defer(mn::mpmc_ring_free(ring));
+	CHECK(mn::mpmc_ring_capacity(ring) == 8);
+
+	for (int i = 0; i < 8; ++i)
+		CHECK(mn::mpmc_ring_push_try(ring, i));
+	CHECK(mn::mpmc_ring_push_try(ring, 8) == false);
+	CHECK(mn::mpmc_ring_count(ring) == 8);
+
+	int v = 0;
+	for (int i = 0; i < 8; ++i)
+	{
+		CHECK(mn::mpmc_ring_pop_try(ring, v));
+		CHECK(v == i);
+	}
+	CHECK(mn::mpmc_ring_pop_try(ring, v) == false);
+}
+
+TEST_CASE("fabric many producers")
+{
+	mn::Fabric_Settings settings{};
+	settings.workers_count = 4;
+	settings.injection_queue_capacity = 64;
+	auto f = mn::fabric_new(settings);
+
+	// external threads submit through the injection queue (and overflow it), and every task
+	// submits a child task from inside the fabric which goes to the local worker queue
+	constexpr int PRODUCERS_COUNT = 4;
+	constexpr int TASKS_COUNT = 1000;
+	std::atomic<int> count = 0;
+	mn::Auto_Waitgroup wg;
+	wg.add(PRODUCERS_COUNT * TASKS_COUNT * 2);
+
+	struct Producer_Context
+	{
+		mn::Fabric f;
+		std::atomic<int>* count;
+		mn::Auto_Waitgroup* wg;
+	};
+	Producer_Context ctx{f, &count, &wg};
+
+	mn::Thread producers[PRODUCERS_COUNT];
+	for (auto& producer: producers)
+	{
+		producer = mn::thread_new([](void* arg) {
+			auto ctx = (Producer_Context*)arg;
+			for (int i = 0; i < TASKS_COUNT; ++i)
+			{
+				mn::go(ctx->f, [ctx] {
+					mn::go(ctx->f, [ctx] { (*ctx->count)++; ctx->wg->done(); });
+					(*ctx->count)++;
+					ctx->wg->done();
+				});
+			}
+		}, &ctx, "producer");
+	}
+
+	for (auto producer: producers)
+	{
+		mn::thread_join(producer);
+		mn::thread_free(producer);
+	}
+	wg.wait();
+	CHECK(count == PRODUCERS_COUNT * TASKS_COUNT * 2);
+
+	mn::fabric_free(f);
+}
+
+TEST_CASE("fabric task priorities")
+{
+	mn::Fabric_Settings settings{};
+	settings.workers_count = 1;
+	auto f = mn::fabric_new(settings);
+	mn::Auto_Waitgroup wg;
+
+	// tasks submitted from within the single worker are all queued before any of them runs
+	constexpr int TASKS_COUNT = 10;
+	mn::Mutex mtx = mn::mutex_new();
+	auto order = mn::buf_new<mn::FABRIC_TASK_PRIORITY>();
+	wg.add(1);
+	mn::go(f, [&] {
+		mn::FABRIC_TASK_PRIORITY priorities[] = {
+			mn::FABRIC_TASK_PRIORITY_BACKGROUND,
+			mn::FABRIC_TASK_PRIORITY_NORMAL,
+			mn::FABRIC_TASK_PRIORITY_HIGH,
+		};
+		for (auto priority: priorities)
+		{
+			for (int i = 0; i < TASKS_COUNT; ++i)
+			{
+				wg.add(1);
+				mn::go(f, priority, [&, priority] {
+					mn::mutex_lock(mtx);
+					mn::buf_push(order, priority);
+					mn::mutex_unlock(mtx);
+					wg.done();
+				});
+			}
+		}
+		wg.done();
+	});
+	wg.wait();
+
+	REQUIRE(order.count == TASKS_COUNT * 3);
+	CHECK(order[0] == mn::FABRIC_TASK_PRIORITY_HIGH);
+	size_t position_sum[mn::FABRIC_TASK_PRIORITY_COUNT]{};
+	for (size_t i = 0; i < order.count; ++i)
+		position_sum[order[i]] += i;
+	CHECK(position_sum[mn::FABRIC_TASK_PRIORITY_HIGH] < position_sum[mn::FABRIC_TASK_PRIORITY_NORMAL]);
+	CHECK(position_sum[mn::FABRIC_TASK_PRIORITY_NORMAL] < position_sum[mn::FABRIC_TASK_PRIORITY_BACKGROUND]);
+
+	// a stream of high priority tasks doesn't starve the background tasks
+	struct Stream
+	{
+		mn::Fabric f;
+		mn::Waitgroup wg;
+		std::atomic<int> count;
+		std::atomic<int> count_at_background;
+	};
+	Stream stream{f, wg.handle, 0, -1};
+	constexpr int STREAM_LENGTH = 1000;
+
+	struct Stream_Step
+	{
+		static void
+		run(Stream* stream)
+		{
+			if (++stream->count < STREAM_LENGTH)
+				mn::go(stream->f, mn::FABRIC_TASK_PRIORITY_HIGH, [stream] { run(stream); });
+			else
+				mn::waitgroup_done(stream->wg);
+		}
+	};
+
+	wg.add(2);
+	mn::go(f, [&] {
+		mn::go(f, mn::FABRIC_TASK_PRIORITY_BACKGROUND, [&] {
+			stream.count_at_background = stream.count.load();
+			wg.done();
+		});
+		mn::go(f, mn::FABRIC_TASK_PRIORITY_HIGH, [&] { Stream_Step::run(&stream); });
+	});
+	wg.wait();
+	CHECK(stream.count_at_background >= 0);
+	CHECK(stream.count_at_background < STREAM_LENGTH);
+
+	mn::buf_free(order);
+	mn::mutex_free(mtx);
+	mn::fabric_free(f);
+}
+
+TEST_CASE("fabric graph")
+{
+	auto f = mn::fabric_new({});
+	auto g = mn::fabric_graph_new();
+
+	// a layered graph where every node of a layer depends on all the nodes of the previous layer
+	constexpr size_t LAYERS_COUNT = 8;
+	constexpr size_t LAYER_WIDTH = 16;
+	std::atomic<size_t> done_count[LAYERS_COUNT]{};
+	std::atomic<bool> violation = false;
+	size_t prev_layer[LAYER_WIDTH]{};
+	for (size_t layer = 0; layer < LAYERS_COUNT; ++layer)
+	{
+		size_t current_layer[LAYER_WIDTH]{};
+		for (size_t i = 0; i < LAYER_WIDTH; ++i)
+		{
+			current_layer[i] = mn::fabric_graph_add(g, [&, layer] {
+				// all the previous layer should be done by now in the current run
+				auto run = done_count[layer].load() / LAYER_WIDTH;
+				if (layer > 0 && done_count[layer - 1].load() < (run + 1) * LAYER_WIDTH)
+					violation = true;
+				done_count[layer]++;
+			});
+
+			if (layer > 0)
+				for (size_t j = 0; j < LAYER_WIDTH; ++j)
+					mn::fabric_graph_edge_add(g, prev_layer[j], current_layer[i]);
+		}
+		for (size_t i = 0; i < LAYER_WIDTH; ++i)
+			prev_layer[i] = current_layer[i];
+	}
+
+	// the same graph can be submitted again once it finishes
+	constexpr size_t RUNS_COUNT = 10;
+	for (size_t run = 0; run < RUNS_COUNT; ++run)
+	{
+		CHECK(mn::fabric_graph_submit(g, f));
+		mn::fabric_graph_wait(g);
+	}
+
+	CHECK(violation == false);
+	for (size_t layer = 0; layer < LAYERS_COUNT; ++layer)
+		CHECK(done_count[layer] == LAYER_WIDTH * RUNS_COUNT);
+
+	mn::fabric_graph_free(g);
+
+	// a graph with a cycle is rejected without running any of its nodes, even the ones which are ready
+	std::atomic<int> cycle_runs = 0;
+	auto cycle = mn::fabric_graph_new();
+	auto root = mn::fabric_graph_add(cycle, [&] { cycle_runs++; });
+	auto a = mn::fabric_graph_add(cycle, [&] { cycle_runs++; });
+	auto b = mn::fabric_graph_add(cycle, [&] { cycle_runs++; });
+	mn::fabric_graph_edge_add(cycle, root, a);
+	mn::fabric_graph_edge_add(cycle, a, b);
+	mn::fabric_graph_edge_add(cycle, b, a);
+	CHECK(mn::fabric_graph_submit(cycle, f) == false);
+	mn::fabric_graph_wait(cycle);
+	CHECK(cycle_runs == 0);
+	mn::fabric_graph_free(cycle);
+
+	mn::fabric_free(f);
+}
+
+TEST_CASE("parallel algorithms")
+{
+	auto f = mn::fabric_new({});
+
+	// the same algorithms should work with a fabric and serially without one
+	mn::Fabric fabrics[] = { f, nullptr };
+	for (auto fabric: fabrics)
+	{
+		constexpr size_t COUNT = 100000;
+		auto nums = mn::buf_with_count<uint64_t>(COUNT);
+		mn_defer(mn::buf_free(nums));
+
+		mn::parallel_for(fabric, COUNT, [&](size_t i) { nums[i] = i; });
+		for (size_t i = 0; i < COUNT; ++i)
+			REQUIRE(nums[i] == i);
+
+		mn::parallel_for(fabric, nums, [](uint64_t& v) { v *= 2; }, 1000);
+		CHECK(nums[COUNT - 1] == (COUNT - 1) * 2);
+
+		auto sum = mn::parallel_reduce(fabric, nums, uint64_t(0), [](uint64_t a, uint64_t b) { return a + b; });
+		CHECK(sum == COUNT * (COUNT - 1));
+
+		auto evens = mn::parallel_filter(fabric, nums, [](uint64_t v) { return v % 4 == 0; });
+		CHECK(evens.count == COUNT / 2);
+		for (size_t i = 0; i < evens.count; ++i)
+			REQUIRE(evens[i] == i * 4);
+		mn::buf_free(evens);
+
+		mn::parallel_for(fabric, COUNT, [&](size_t i) { nums[i] = 1; });
+		mn::parallel_scan(fabric, nums, [](uint64_t a, uint64_t b) { return a + b; });
+		for (size_t i = 0; i < COUNT; ++i)
+			REQUIRE(nums[i] == i + 1);
+
+		// a simple lcg to get a shuffled input
+		uint64_t state = 42;
+		for (auto& v: nums)
+		{
+			state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+			v = state >> 33;
+		}
+		mn::parallel_sort(fabric, nums);
+		for (size_t i = 1; i < COUNT; ++i)
+			REQUIRE(nums[i - 1] <= nums[i]);
+
+		mn::parallel_sort(fabric, nums, [](uint64_t a, uint64_t b) { return a > b; });
+		for (size_t i = 1; i < COUNT; ++i)
+			REQUIRE(nums[i - 1] >= nums[i]);
+	}
+
+	// empty inputs are fine
+	auto empty = mn::buf_new<int>();
+	CHECK(mn::parallel_reduce(f, empty, 7, [](int a, int b) { return a + b; }) == 7);
+	mn::parallel_scan(f, empty, [](int a, int b) { return a + b; });
+	mn::parallel_sort(f, empty);
+	auto filtered = mn::parallel_filter(f, empty, [](int) { return true; });
+	CHECK(filtered.count == 0);
+	mn::buf_free(filtered);
+	mn::buf_free(empty);
+
+	mn::fabric_free(f);
+}
+
+TEST_CASE("fabric compute chunked")
+{
+	auto f = mn::fabric_new({});
+
+	mn::Fabric fabrics[] = { f, nullptr };
+	for (auto fabric: fabrics)
+	{
+		// each invocation is visited exactly once with the same ids the regular compute gives it
+		mn::Compute_Dims global{ 5, 3, 2 };
+		mn::Compute_Dims local{ 4, 3, 2 };
+		constexpr size_t COUNT = 5 * 4 * 3 * 3 * 2 * 2;
+		std::atomic<int> visits[COUNT]{};
+		std::atomic<bool> mismatch = false;
+		mn::compute_chunked(fabric, global, local, [&](mn::Compute_Args args) {
+			auto id = args.global_invocation_id;
+			if (id.x != args.workgroup_id.x * local.x + args.local_invocation_id.x ||
+				id.y != args.workgroup_id.y * local.y + args.local_invocation_id.y ||
+				id.z != args.workgroup_id.z * local.z + args.local_invocation_id.z)
+				mismatch = true;
+			// tmp memory is usable within the function
+			auto tmp = mn::str_tmpf("{}", id.x);
+			if (tmp.count == 0)
+				mismatch = true;
+			visits[(id.z * global.y * local.y + id.y) * global.x * local.x + id.x]++;
+		});
+		CHECK(mismatch == false);
+		for (auto& v: visits)
+			REQUIRE(v == 1);
+
+		// sized compute skips the invocations which are out of bounds
+		std::atomic<size_t> count = 0;
+		mn::compute_sized_chunked(fabric, mn::Compute_Dims{ 1000, 3, 1 }, mn::Compute_Dims{ 64, 1, 1 }, [&](mn::Compute_Args args) {
+			if (args.global_invocation_id.x < 1000 && args.global_invocation_id.y < 3)
+				count++;
+		});
+		CHECK(count == 3000);
+	}
+
+	mn::fabric_free(f);
+}
+
+TEST_CASE("topology")
+{
+	auto topology = mn::topology_new();
+	mn_defer(mn::topology_free(topology));
+
+	REQUIRE(topology.cpus.count > 0);
+	CHECK(topology.cores_count > 0);
+	CHECK(topology.cores_count <= topology.cpus.count);
+	CHECK(topology.packages_count > 0);
+	CHECK(topology.nodes_count > 0);
+	for (size_t i = 1; i < topology.cpus.count; ++i)
+		CHECK(topology.cpus[i - 1].id < topology.cpus[i].id);
+}
+
+TEST_CASE("fabric pinned workers")
+{
+	mn::Fabric_Settings settings{};
+	settings.workers_count = 4;
+	settings.pin_workers = true;
+	settings.topology_aware_stealing = true;
+	settings.numa_local_memory = true;
+	auto f = mn::fabric_new(settings);
+	mn_defer(mn::fabric_free(f));
+
+	// the tasks spawn more tasks from within the workers so that they're stolen from each other
+	constexpr int TASKS_COUNT = 100;
+	std::atomic<int> sum = 0;
+	mn::Auto_Waitgroup wg;
+	for (int i = 0; i < TASKS_COUNT; ++i)
+	{
+		wg.add(1);
+		mn::go(f, [&, i] {
+			for (int j = 0; j < 10; ++j)
+			{
+				wg.add(1);
+				mn::go(f, [&, i] {
+					sum += i;
+					wg.done();
+				});
+			}
+			wg.done();
+		});
+	}
+	wg.wait();
+	CHECK(sum == 10 * TASKS_COUNT * (TASKS_COUNT - 1) / 2);
+}
+
+TEST_CASE("fabric do when")
+{
+	auto f = mn::fabric_new({});
+	mn::Auto_Waitgroup wg;
+
+	std::atomic<bool> ready = false;
+	std::atomic<int> count = 0;
+	constexpr int TASKS_COUNT = 100;
+
+	// ready tasks run right away
+	wg.add(1);
+	mn::fabric_do_when(f, [] { return true; }, [&] { count++; wg.done(); });
+	wg.wait();
+	CHECK(count == 1);
+
+	// waiting tasks don't run until they're ready
+	for (int i = 0; i < TASKS_COUNT; ++i)
+	{
+		wg.add(1);
+		mn::fabric_do_when(f, [&] { return ready.load(); }, [&] { count++; wg.done(); });
+	}
+	mn::thread_sleep(10);
+	CHECK(count == 1);
+
+	// and they're released once the condition is true even if it was set from within the fabric
+	mn::go(f, [&] { ready = true; });
+	wg.wait();
+	CHECK(count == TASKS_COUNT + 1);
+
+	// waiting tasks which never become ready are freed with the fabric
+	mn::fabric_do_when(f, [] { return false; }, [] {});
+	mn::fabric_free(f);
+}
+
+TEST_CASE("fabric timers")
+{
+	auto f = mn::fabric_new({});
+	mn::Auto_Waitgroup wg;
+
+	// delayed tasks don't run before their delay
+	auto start = mn::time_in_millis();
+	std::atomic<uint64_t> elapsed = 0;
+	wg.add(1);
+	mn::fabric_do_after(f, 20, [&] { elapsed = mn::time_in_millis() - start; wg.done(); });
+	wg.wait();
+	CHECK(elapsed >= 20);
+
+	// canceled tasks never run and their handles go stale after they fire
+	std::atomic<int> count = 0;
+	auto canceled = mn::fabric_do_after(f, 10, [&] { count++; });
+	CHECK(mn::fabric_timer_cancel(f, canceled) == true);
+	CHECK(mn::fabric_timer_cancel(f, canceled) == false);
+	wg.add(1);
+	auto fired = mn::fabric_do_after(f, 0, [&] { wg.done(); });
+	wg.wait();
+	mn::thread_sleep(20);
+	CHECK(count == 0);
+	CHECK(mn::fabric_timer_cancel(f, fired) == false);
+
+	// many timers with spread out delays all fire, including the ones which cascade from the higher levels
+	constexpr int TIMERS_COUNT = 10000;
+	wg.add(TIMERS_COUNT);
+	for (int i = 0; i < TIMERS_COUNT; ++i)
+		mn::fabric_do_after(f, (i * 7919) % 600, [&] { count++; wg.done(); });
+	wg.wait();
+	CHECK(count == TIMERS_COUNT);
+
+	// periodic tasks run until they're canceled
+	std::atomic<int> ticks = 0;
+	auto periodic = mn::fabric_do_every(f, 1, [&] { ticks++; });
+	while (ticks < 5)
+		mn::thread_sleep(1);
+	CHECK(mn::fabric_timer_cancel(f, periodic) == true);
+	mn::thread_sleep(10);
+	auto ticks_after_cancel = ticks.load();
+	mn::thread_sleep(10);
+	CHECK(ticks == ticks_after_cancel);
+
+	// pending timers are freed with the fabric
+	mn::fabric_do_after(f, 100000, [] {});
+	mn::fabric_do_every(f, 100000, [] {});
+	mn::fabric_free(f);
+}
+
+TEST_CASE("fabric stats")
+{
+	mn::Fabric_Settings settings{};
+	settings.workers_count = 4;
+	settings.enable_timing_stats = true;
+	auto f = mn::fabric_new(settings);
+	mn_defer(mn::fabric_free(f));
+
+	constexpr uint64_t TASKS_COUNT = 1000;
+	mn::Auto_Waitgroup wg;
+	wg.add(TASKS_COUNT);
+	for (uint64_t i = 0; i < TASKS_COUNT; ++i)
+		mn::fabric_do(f, [&] { wg.done(); });
+	wg.wait();
+
+	// the workers count the task after it finishes so we wait for the counters to catch up
+	auto stats = mn::fabric_stats(f);
+	for (int i = 0; i < 1000 && stats.total.tasks_executed < TASKS_COUNT; ++i)
+	{
+		mn::fabric_stats_free(stats);
+		mn::thread_sleep(1);
+		stats = mn::fabric_stats(f);
+	}
+	mn_defer(mn::fabric_stats_free(stats));
+
+	CHECK(stats.workers.count == 4);
+	CHECK(stats.total.tasks_executed == TASKS_COUNT);
+
+	uint64_t workers_tasks = 0;
+	for (const auto& worker: stats.workers)
+		workers_tasks += worker.tasks_executed;
+	CHECK(workers_tasks == TASKS_COUNT);
+
+	uint64_t queue_waits = 0, run_times = 0;
+	for (size_t i = 0; i < mn::FABRIC_STATS_HISTOGRAM_BUCKETS_COUNT; ++i)
+	{
+		queue_waits += stats.total.queue_wait_histogram[i];
+		run_times += stats.total.run_time_histogram[i];
+	}
+	CHECK(queue_waits == TASKS_COUNT);
+	CHECK(run_times == TASKS_COUNT);
+	CHECK(stats.blocking_evictions == 0);
+}
+
+TEST_CASE("fabric futures")
+{
+	mn::Fabric_Settings settings{};
+	settings.workers_count = 2;
+	auto f = mn::fabric_new(settings);
+	mn_defer(mn::fabric_free(f));
+
+	auto answer = mn::go_future(f, [] { return 21; });
+	auto doubled = mn::future_then(answer, [](int v) { return v * 2; });
+	CHECK(mn::future_wait(doubled) == 42);
+	CHECK(mn::future_ready(answer));
+
+	// continuations of completed futures run right away
+	int then_value = 0;
+	mn::future_then(answer, [&](int v) { then_value = v; });
+	CHECK(then_value == 21);
+	mn::future_free(doubled);
+	mn::future_free(answer);
+
+	// the future owns its value and frees it with itself
+	auto promise = mn::promise_new<mn::Str>();
+	auto name = mn::promise_future(promise);
+	mn::go(f, [promise] { mn::promise_set(promise, mn::str_from_c("fabric")); });
+	CHECK(mn::future_wait(name) == "fabric");
+	mn::promise_free(promise);
+	mn::future_free(name);
+
+	// tasks which wait on futures run the other tasks in the meantime, even the ones they wait on
+	constexpr int TASKS_COUNT = 100;
+	auto sum = mn::go_future(f, [f] {
+		auto parts = mn::buf_new<mn::Future<int>>();
+		for (int i = 0; i < TASKS_COUNT; ++i)
+			mn::buf_push(parts, mn::go_future(f, [i] { return i; }));
+
+		int res = 0;
+		for (auto part: parts)
+			res += mn::future_wait(part);
+		mn::destruct(parts);
+		return res;
+	});
+	CHECK(mn::future_wait(sum) == TASKS_COUNT * (TASKS_COUNT - 1) / 2);
+	mn::future_free(sum);
+}
+
+TEST_CASE("fabric futures rejected")
+{
+	mn::Fabric_Settings settings{};
+	settings.workers_count = 1;
+	settings.max_pending_tasks = 1;
+	settings.overload_policy = mn::FABRIC_OVERLOAD_POLICY_REJECT;
+	auto f = mn::fabric_new(settings);
+	mn_defer(mn::fabric_free(f));
+
+	// the gated task fills the fabric so the next submissions are rejected
+	std::atomic<bool> gate = false;
+	auto gated = mn::go_future(f, [&] {
+		while (gate.load() == false)
+			mn::thread_sleep(1);
+		return 1;
+	});
+	REQUIRE(gated != nullptr);
+
+	bool ran = false;
+	auto rejected = mn::go_future(f, [&] { ran = true; return 2; });
+	CHECK(rejected == nullptr);
+	CHECK(mn::go(f, [&] { ran = true; }) == false);
+
+	gate = true;
+	CHECK(mn::future_wait(gated) == 1);
+	mn::future_free(gated);
+	CHECK(ran == false);
+}
+
 TEST_CASE("buddy")
 {
 	auto buddy = mn::allocator_buddy_new();
@@ -1366,3 +2991,40 @@ TEST_CASE("arena scopes")
 	mn::allocator_arena_restore(mn::memory::tmp(), checkpoint);
 	CHECK(name == "my name is mostafa");
 }
+
+TEST_CASE("arena retained blocks")
+{
+	mn::memory::Arena arena{1024};
+
+	// the blocks allocated after the checkpoint are reused instead of being freed
+	auto checkpoint = arena.checkpoint();
+	auto big = arena.alloc(64 * 1024, alignof(char));
+	arena.restore(checkpoint);
+	CHECK(arena.total_mem == 0);
+	CHECK(arena.retained_mem >= 64 * 1024);
+	CHECK(arena.alloc(64 * 1024, alignof(char)).ptr == big.ptr);
+	arena.restore(checkpoint);
+
+	// the retained blocks survive trims while the arena is busy
+	for (size_t i = 0; i < 100; ++i)
+	{
+		auto checkpoint = arena.checkpoint();
+		arena.alloc(64 * 1024, alignof(char));
+		arena.restore(checkpoint);
+		arena.trim();
+	}
+	CHECK(arena.retained_mem >= 64 * 1024);
+
+	// and they're freed gradually when it's not
+	for (size_t i = 0; i < 1000; ++i)
+		arena.trim();
+	CHECK(arena.retained_mem == 0);
+
+	// checkpoints taken before clearing the arena are ignored
+	checkpoint = arena.checkpoint();
+	arena.alloc(64, alignof(char));
+	arena.free_all();
+	auto ptr = arena.alloc(64, alignof(char)).ptr;
+	arena.restore(checkpoint);
+	CHECK(arena.owns(ptr));
+}